@@ -0,0 +1,52 @@
+/*****************************************************************************
+ *
+ * QCMaquis DMRG Project
+ *
+ * Copyright (C) 2021 Laboratory for Physical Chemistry, ETH Zurich
+ *
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+// Converts an FCIDUMP file to the binary integral format, which can be passed
+// as integral_file and is memory-mapped instead of being parsed. Since the binary
+// file has no FCIDUMP header, site_types must be set in the input parameters.
+
+#include <complex>
+#include <iostream>
+#include <string>
+
+#include "dmrg/models/chem/util.h"
+#include "dmrg/models/chem/parse_integrals.h"
+
+int main(int argc, char ** argv)
+{
+    try {
+        if (argc != 3 && !(argc == 4 && std::string(argv[3]) == "--complex")) {
+            std::cout << "Usage: " << argv[0] << " <FCIDUMP> <binary integral file> [--complex]" << std::endl;
+            return 1;
+        }
+        std::size_t n = (argc == 4) ? chem::detail::convert_fcidump<std::complex<double> >(argv[1], argv[2])
+                                    : chem::detail::convert_fcidump<double>(argv[1], argv[2]);
+        std::cout << "Converted " << n << " integrals from " << argv[1] << " to " << argv[2] << std::endl;
+    } catch (std::exception& e) {
+        std::cerr << "Error:" << std::endl << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -37,12 +37,23 @@
 #include "dmrg/block_matrix/block_matrix.h"
 #include "dmrg/block_matrix/indexing.h"
 #include "dmrg/block_matrix/multi_index.h"
+#include "dmrg/block_matrix/randomized_svd.h"
 
 #include <boost/lambda/lambda.hpp>
 #include <boost/function.hpp>
 #include <boost/utility.hpp>
 #include <boost/type_traits.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numeric>
+
+#ifdef MAQUIS_OPENMP
+#include <omp.h>
+#endif
+
 #include "dmrg/utils/parallel.hpp"
 
 /** @brief Struct storing the results of an MPS truncation */
@@ -178,27 +189,88 @@ void gemm_trim_right(block_matrix<Matrix1, SymmGroup> const & A,
     }
 }
 
+namespace detail {
+
+    /**
+     * @brief Size-aware ordering of the blocks of a decomposition.
+     *
+     * The blocks which alone cost more than an even share of the threads are returned in
+     * [large], to be processed outside of the parallel region with threaded LAPACK/BLAS.
+     * The other ones are returned in [small] with the most expensive first, so that the
+     * dynamic schedule of [omp_for] does not end with a large block on a single thread.
+     */
+    inline void schedule_blocks(std::vector<double> const & cost, std::vector<std::size_t> & small,
+                                std::vector<std::size_t> & large)
+    {
+#ifdef MAQUIS_OPENMP
+        double share = std::accumulate(cost.begin(), cost.end(), 0.) / omp_get_max_threads();
+#else
+        double share = std::accumulate(cost.begin(), cost.end(), 0.);
+#endif
+        small.clear();
+        large.clear();
+        for (std::size_t k = 0; k < cost.size(); ++k)
+            (cost[k] > share && cost.size() > 1 ? large : small).push_back(k);
+        std::stable_sort(small.begin(), small.end(), [&](std::size_t a, std::size_t b) { return cost[a] > cost[b]; });
+    }
+
+} // namespace detail
+
+/**
+ * @brief SVD of a block matrix where at most [rank] singular values per block are needed.
+ *
+ * Blocks selected by [SVDSettings::block_rank] are decomposed with a randomized SVD,
+ * the others with a full one. The blocks are ordered with [detail::schedule_blocks].
+ */
 template<class Matrix, class DiagMatrix, class SymmGroup>
 void svd(block_matrix<Matrix, SymmGroup> const & M,
          block_matrix<Matrix, SymmGroup> & U,
          block_matrix<Matrix, SymmGroup> & V,
-         block_matrix<DiagMatrix, SymmGroup> & S)
+         block_matrix<DiagMatrix, SymmGroup> & S,
+         std::size_t rank)
 {
     parallel::scheduler_balanced scheduler(M);
 
     Index<SymmGroup> r = M.left_basis(), c = M.right_basis(), m = M.left_basis();
     for (std::size_t i = 0; i < M.n_blocks(); ++i)
-        m[i].second = std::min(r[i].second, c[i].second);
+        m[i].second = SVDSettings::block_rank(r[i].second, c[i].second, rank);
 
     U = block_matrix<Matrix, SymmGroup>(r, m);
     V = block_matrix<Matrix, SymmGroup>(m, c);
     S = block_matrix<DiagMatrix, SymmGroup>(m, m);
     std::size_t loop_max = M.n_blocks();
 
-    omp_for(size_t k, parallel::range<size_t>(0,loop_max), {
-        parallel::guard proc(scheduler(k));
-        svd(M[k], U[k], V[k], S[k]);
+    auto decompose = [&](std::size_t k) {
+        if (m[k].second < std::min(r[k].second, c[k].second))
+            randomized_svd(M[k], U[k], V[k], S[k], SVDSettings::power_iterations(), static_cast<unsigned>(k));
+        else
+            svd(M[k], U[k], V[k], S[k]);
+    };
+
+    std::vector<double> cost(loop_max);
+    for (std::size_t k = 0; k < loop_max; ++k)
+        cost[k] = double(r[k].second) * c[k].second * m[k].second;
+    std::vector<std::size_t> small_blocks, large_blocks;
+    detail::schedule_blocks(cost, small_blocks, large_blocks);
+
+    omp_for(size_t i, parallel::range<size_t>(0,small_blocks.size()), {
+        parallel::guard proc(scheduler(small_blocks[i]));
+        decompose(small_blocks[i]);
     });
+    for (std::size_t k : large_blocks) {
+        parallel::guard proc(scheduler(k));
+        decompose(k);
+    }
+}
+
+/** @brief Full SVD of a block matrix */
+template<class Matrix, class DiagMatrix, class SymmGroup>
+void svd(block_matrix<Matrix, SymmGroup> const & M,
+         block_matrix<Matrix, SymmGroup> & U,
+         block_matrix<Matrix, SymmGroup> & V,
+         block_matrix<DiagMatrix, SymmGroup> & S)
+{
+    svd(M, U, V, S, std::numeric_limits<std::size_t>::max());
 }
 
 template<class Matrix, class DiagMatrix, class SymmGroup>
@@ -212,10 +284,20 @@ void heev(block_matrix<Matrix, SymmGroup> const & M,
     evals = block_matrix<DiagMatrix, SymmGroup>(M.basis());
     std::size_t loop_max = M.n_blocks();
 
-    omp_for(size_t k, parallel::range<size_t>(0,loop_max), {
+    std::vector<double> cost(loop_max);
+    for (std::size_t k = 0; k < loop_max; ++k)
+        cost[k] = std::pow(double(num_rows(M[k])), 3);
+    std::vector<std::size_t> small_blocks, large_blocks;
+    detail::schedule_blocks(cost, small_blocks, large_blocks);
+
+    omp_for(size_t i, parallel::range<size_t>(0,small_blocks.size()), {
+        parallel::guard proc(scheduler(small_blocks[i]));
+        heev(M[small_blocks[i]], evecs[small_blocks[i]], evals[small_blocks[i]]);
+    });
+    for (std::size_t k : large_blocks) {
         parallel::guard proc(scheduler(k));
         heev(M[k], evecs[k], evals[k]);
-    });
+    }
 }
 
 #ifdef USE_AMBIENT
@@ -287,52 +369,58 @@ template<class DiagMatrix, class SymmGroup>
 void estimate_truncation(block_matrix<DiagMatrix, SymmGroup> const & evals,
                          size_t Mmax, double cutoff, size_t* keeps,
                          double & truncated_fraction, double & truncated_weight, double & smallest_ev)
-{ // to be parallelized later (30.04.2012)
+{
     typedef typename DiagMatrix::value_type value_type;
     typedef typename maquis::traits::real_type<value_type>::type real_type;
 
-    size_t length = 0;
-    for(std::size_t k = 0; k < evals.n_blocks(); ++k){
-        length += num_rows(evals[k]);
-    }
+    std::size_t loop_max = evals.n_blocks();
+    std::vector<size_t> offsets(loop_max+1, 0);
+    for(std::size_t k = 0; k < loop_max; ++k)
+        offsets[k+1] = offsets[k] + num_rows(evals[k]);
 
     typedef std::vector<real_type> real_vector_t;
-    real_vector_t allevals(length);
+    real_vector_t allevals(offsets[loop_max]);
     {
         parallel::guard::serial guard;
         storage::migrate(evals);
     }
 
-    std::size_t position = 0;
-    for(std::size_t k = 0; k < evals.n_blocks(); ++k){
-        std::transform(evals[k].diagonal().first, evals[k].diagonal().second, allevals.begin()+position, gather_real_pred<value_type>);
-        position += num_rows(evals[k]);
-    }
+    omp_for(size_t k, parallel::range<size_t>(0,loop_max), {
+        std::transform(evals[k].diagonal().first, evals[k].diagonal().second, allevals.begin()+offsets[k], gather_real_pred<value_type>);
+    });
 
     assert( allevals.size() > 0 );
-    std::sort(allevals.begin(), allevals.end());
-    std::reverse(allevals.begin(), allevals.end());
-
-    real_type evalscut = cutoff * allevals[0];
+    // Only the largest and the (Mmax+1)-th largest eigenvalue are needed, no full sort
+    real_type largest = *std::max_element(allevals.begin(), allevals.end());
+    real_type evalscut = cutoff * largest;
 
-    if (allevals.size() > Mmax)
+    if (allevals.size() > Mmax) {
+        std::nth_element(allevals.begin(), allevals.begin()+Mmax, allevals.end(), std::greater<real_type>());
         evalscut = std::max(evalscut, allevals[Mmax]);
-    smallest_ev = evalscut / allevals[0];
-
-    truncated_fraction = 0.0; truncated_weight = 0.0;
-    for (typename real_vector_t::const_iterator it = std::find_if(allevals.begin(), allevals.end(), boost::lambda::_1 < evalscut);
-         it != allevals.end(); ++it) {
-        truncated_fraction += *it;
-        truncated_weight += (*it)*(*it);
     }
-    truncated_fraction /= std::accumulate(allevals.begin(), allevals.end(), 0.0);
-    truncated_weight /= std::accumulate(allevals.begin(), allevals.end(), 0.0,  boost::lambda::_1 + boost::lambda::_2 *boost::lambda::_2);
+    smallest_ev = evalscut / largest;
 
-    for(std::size_t k = 0; k < evals.n_blocks(); ++k){
+    // Partial sums per block, added up in a fixed order afterwards
+    std::vector<double> sum(loop_max), sum_sq(loop_max), truncated(loop_max), truncated_sq(loop_max);
+    omp_for(size_t k, parallel::range<size_t>(0,loop_max), {
         real_vector_t evals_k(num_rows(evals[k]));
         std::transform(evals[k].diagonal().first, evals[k].diagonal().second, evals_k.begin(), gather_real_pred<value_type>);
         keeps[k] = std::find_if(evals_k.begin(), evals_k.end(), boost::lambda::_1 < evalscut)-evals_k.begin();
-    }
+        sum[k] = sum_sq[k] = truncated[k] = truncated_sq[k] = 0.;
+        for (real_type ev : evals_k) {
+            sum[k] += ev;
+            sum_sq[k] += ev*ev;
+            if (ev < evalscut) {
+                truncated[k] += ev;
+                truncated_sq[k] += ev*ev;
+            }
+        }
+    });
+
+    truncated_fraction = std::accumulate(truncated.begin(), truncated.end(), 0.0)
+                       / std::accumulate(sum.begin(), sum.end(), 0.0);
+    truncated_weight = std::accumulate(truncated_sq.begin(), truncated_sq.end(), 0.0)
+                     / std::accumulate(sum_sq.begin(), sum_sq.end(), 0.0);
 }
 
 
@@ -345,13 +433,19 @@ truncation_results svd_truncate(block_matrix<Matrix, SymmGroup> const & M,
                                 bool verbose = true)
 {
     assert( M.left_basis().sum_of_sizes() > 0 && M.right_basis().sum_of_sizes() > 0 );
+    // Mmax+1 singular values are enough to locate the truncation threshold
+    std::size_t rank = (Mmax < std::numeric_limits<std::size_t>::max()) ? Mmax+1 : Mmax;
     #ifdef USE_AMBIENT
     svd_merged(M, U, V, S);
     #else
-    svd(M, U, V, S);
+    svd(M, U, V, S, rank);
     #endif
 
     Index<SymmGroup> old_basis = S.left_basis();
+    std::size_t full_size = 0;
+    for (std::size_t k = 0; k < M.n_blocks(); ++k)
+        full_size += std::min(M.basis().left_size(k), M.basis().right_size(k));
+    bool partial = old_basis.sum_of_sizes() < full_size;
     size_t* keeps = new size_t[S.n_blocks()];
     double truncated_fraction, truncated_weight, smallest_ev;
     //  Given the full SVD in each block (above), remove all singular values and corresponding rows/cols
@@ -397,6 +491,16 @@ truncation_results svd_truncate(block_matrix<Matrix, SymmGroup> const & M,
 
     delete[] keeps;
 
+    // With a partial SVD, the weight of the singular values which have not been computed
+    // is recovered from the norm of M. The truncated fraction only covers the computed ones.
+    if (partial) {
+        double kept_weight = 0., norm_sq = M.norm() * M.norm();
+        for (std::size_t k = 0; k < S.n_blocks(); ++k)
+            for (std::size_t i = 0; i < num_rows(S[k]); ++i)
+                kept_weight += maquis::real(S[k](i,i)) * maquis::real(S[k](i,i));
+        truncated_weight = std::max(0., 1. - kept_weight / norm_sq);
+    }
+
     std::size_t bond_dimension = S.basis().sum_of_left_sizes();
     if(verbose){
         maquis::cout << "Sum: " << old_basis.sum_of_sizes() << " -> " << bond_dimension << std::endl;
@@ -0,0 +1,164 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef BLOCK_MATRIX_DENSITY_MATRIX_H
+#define BLOCK_MATRIX_DENSITY_MATRIX_H
+
+#include <algorithm>
+#include <complex>
+#include <set>
+#include <stdexcept>
+#include <string>
+
+#include <boost/numeric/bindings/blas/level3/herk.hpp>
+
+#include "dmrg/block_matrix/block_matrix.h"
+#include "dmrg/block_matrix/block_matrix_algorithms.h"
+
+/**
+ * @brief Global selector of the product used to build reduced density matrices.
+ *
+ * With [Gemm] the density matrix M*M^H is obtained from a general matrix-matrix
+ * product. With [Herk] only the upper triangle of each block is computed with a
+ * rank-k update (SYRK/HERK), which halves the number of flops, and is then mirrored.
+ */
+class DensityMatrixSettings
+{
+public:
+    enum Product { Gemm, Herk };
+
+    /** @brief Getter/setter for the product, the default is [Gemm] */
+    static Product & product()
+    {
+        static Product current = Gemm;
+        return current;
+    }
+
+    /** @brief Sets the product from the value of the [density_matrix_product] parameter */
+    static void set_product(std::string const & name)
+    {
+        if (name == "gemm")
+            product() = Gemm;
+        else if (name == "herk")
+            product() = Herk;
+        else
+            throw std::runtime_error("density_matrix_product = " + name + " not recognized, use gemm or herk");
+    }
+};
+
+namespace density_matrix_detail {
+
+    inline double conj_value(double x) { return x; }
+
+    template<class T>
+    std::complex<T> conj_value(std::complex<T> const & x) { return std::conj(x); }
+
+    /**
+     * @brief Dense Gram product with a rank-k update.
+     *
+     * Computes C = A*A^H if [left] is true, C = A^H*A otherwise. C must have the
+     * right size. With [accumulate] the product is added to the content of C.
+     */
+    template<class T, class MemoryBlock>
+    void gram(alps::numeric::matrix<T, MemoryBlock> const & A, alps::numeric::matrix<T, MemoryBlock> & C,
+              bool left, bool accumulate)
+    {
+        namespace blas = boost::numeric::bindings::blas;
+        namespace tag = boost::numeric::bindings::tag;
+        typedef typename maquis::traits::real_type<T>::type real_type;
+
+        int n = left ? num_rows(A) : num_cols(A);
+        int k = left ? num_cols(A) : num_rows(A);
+        if (!accumulate)
+            std::fill(elements(C).first, elements(C).second, T(0));
+        if (n == 0 || k == 0)
+            return;
+
+        int lda = std::max<int>(1, A.stride2()), ldc = std::max<int>(1, C.stride2());
+        real_type beta = accumulate ? 1. : 0.;
+        if (left)
+            blas::detail::herk(tag::column_major(), tag::upper(), tag::no_transpose(), n, k,
+                               real_type(1), &A(0,0), lda, beta, &C(0,0), ldc);
+        else
+            blas::detail::herk(tag::column_major(), tag::upper(), tag::conjugate(), n, k,
+                               real_type(1), &A(0,0), lda, beta, &C(0,0), ldc);
+
+        for (int j = 0; j < n; ++j)
+            for (int i = j+1; i < n; ++i)
+                C(i,j) = conj_value(C(j,i));
+    }
+
+    /** @brief Block-wise Gram product, see [gram_left] and [gram_right] */
+    template<class Matrix, class SymmGroup>
+    void block_gram(block_matrix<Matrix, SymmGroup> const & M, block_matrix<Matrix, SymmGroup> & dm, bool left)
+    {
+        typedef typename SymmGroup::charge charge;
+
+        // Blocks of M sharing their contracted charge give off-diagonal blocks of dm,
+        // which are left to the general product
+        std::set<charge> contracted;
+        bool unique = true;
+        for (std::size_t k = 0; k < M.n_blocks() && unique; ++k)
+            unique = contracted.insert(left ? M.basis().right_charge(k) : M.basis().left_charge(k)).second;
+
+        if (DensityMatrixSettings::product() == DensityMatrixSettings::Gemm || !unique) {
+            if (left)
+                gemm(M, transpose(conjugate(M)), dm);
+            else
+                gemm(transpose(conjugate(M)), M, dm);
+            return;
+        }
+
+        dm = block_matrix<Matrix, SymmGroup>();
+        for (std::size_t k = 0; k < M.n_blocks(); ++k) {
+            charge c = left ? M.basis().left_charge(k) : M.basis().right_charge(k);
+            std::size_t size = left ? M.basis().left_size(k) : M.basis().right_size(k);
+            dm.insert_block(Matrix(size, size), c, c);
+        }
+
+        omp_for(std::size_t k, parallel::range<std::size_t>(0,M.n_blocks()), {
+            charge c = left ? M.basis().left_charge(k) : M.basis().right_charge(k);
+            gram(M[k], dm[dm.find_block(c, c)], left, false);
+        });
+    }
+
+} // namespace density_matrix_detail
+
+/** @brief Reduced density matrix M*M^H, with the left index of M open */
+template<class Matrix, class SymmGroup>
+void gram_left(block_matrix<Matrix, SymmGroup> const & M, block_matrix<Matrix, SymmGroup> & dm)
+{
+    density_matrix_detail::block_gram(M, dm, true);
+}
+
+/** @brief Reduced density matrix M^H*M, with the right index of M open */
+template<class Matrix, class SymmGroup>
+void gram_right(block_matrix<Matrix, SymmGroup> const & M, block_matrix<Matrix, SymmGroup> & dm)
+{
+    density_matrix_detail::block_gram(M, dm, false);
+}
+
+#endif
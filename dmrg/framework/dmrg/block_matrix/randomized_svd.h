@@ -0,0 +1,135 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef BLOCK_MATRIX_RANDOMIZED_SVD_H
+#define BLOCK_MATRIX_RANDOMIZED_SVD_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include <boost/random.hpp>
+
+/**
+ * @brief Global settings of the SVD used in [svd_truncate].
+ *
+ * With [Full] every symmetry block is decomposed with a complete SVD. With [Randomized],
+ * the blocks whose smaller dimension is much larger than the number of singular values
+ * that can survive the truncation are decomposed with a randomized SVD, which only
+ * computes the (Mmax + 1 + [oversampling]) largest singular triplets. The accuracy of
+ * the randomized range finder is improved by [power_iterations] subspace iterations.
+ */
+class SVDSettings
+{
+public:
+    enum Algorithm { Full, Randomized };
+
+    /** @brief Getter/setter for the algorithm, the default is [Full] */
+    static Algorithm & algorithm()
+    {
+        static Algorithm current = Full;
+        return current;
+    }
+
+    /** @brief Getter/setter for the number of additional random vectors of the range finder */
+    static std::size_t & oversampling()
+    {
+        static std::size_t current = 10;
+        return current;
+    }
+
+    /** @brief Getter/setter for the number of subspace iterations of the range finder */
+    static std::size_t & power_iterations()
+    {
+        static std::size_t current = 2;
+        return current;
+    }
+
+    /** @brief Sets the settings from the values of the [svd_algorithm] parameters */
+    static void set(std::string const & name, std::size_t n_oversampling, std::size_t n_power_iterations)
+    {
+        if (name == "full")
+            algorithm() = Full;
+        else if (name == "randomized")
+            algorithm() = Randomized;
+        else
+            throw std::runtime_error("svd_algorithm = " + name + " not recognized, use full or randomized");
+        oversampling() = n_oversampling;
+        power_iterations() = n_power_iterations;
+    }
+
+    /**
+     * @brief Number of singular values computed for a (rows x cols) block.
+     * @param rank number of singular values which are needed at most.
+     * The randomized SVD is used only if it computes less than a quarter of the
+     * spectrum, below that ratio its multiple passes over the block are not worth it.
+     */
+    static std::size_t block_rank(std::size_t rows, std::size_t cols, std::size_t rank)
+    {
+        std::size_t full = std::min(rows, cols);
+        if (algorithm() == Full || rank >= full)
+            return full;
+        std::size_t reduced = rank + oversampling();
+        return (4*reduced <= full) ? reduced : full;
+    }
+};
+
+/**
+ * @brief Randomized SVD of a dense matrix, after Halko, Martinsson and Tropp.
+ *
+ * The range of [M] is sampled with [num_cols(S)] Gaussian random vectors generated
+ * from [seed], refined with [n_power] orthonormalized subspace iterations, and the
+ * SVD of the projection of [M] onto this range gives the [num_cols(S)] largest
+ * singular triplets. U must be passed with its final size, V and S are resized.
+ */
+template<class Matrix, class DiagMatrix>
+void randomized_svd(Matrix const & M, Matrix & U, Matrix & V, DiagMatrix & S,
+                    std::size_t n_power, unsigned seed)
+{
+    std::size_t rank = num_rows(S);
+    boost::mt19937 engine(seed);
+    boost::normal_distribution<double> dist;
+    boost::variate_generator<boost::mt19937&, boost::normal_distribution<double> > normal(engine, dist);
+
+    Matrix omega(num_cols(M), rank), Y(num_rows(M), rank), Z(num_cols(M), rank), Q, R;
+    std::generate(elements(omega).first, elements(omega).second, normal);
+    gemm(M, omega, Y);
+    Matrix Madj = adjoint(M);
+    for (std::size_t i = 0; i < n_power; ++i) {
+        qr(Y, Q, R);
+        gemm(Madj, Q, Z);
+        qr(Z, Q, R);
+        gemm(M, Q, Y);
+    }
+    qr(Y, Q, R);
+
+    Matrix B(rank, num_cols(M)), Ub;
+    gemm(adjoint(Q), M, B);
+    svd(B, Ub, V, S);
+    gemm(Q, Ub, U);
+}
+
+#endif
@@ -31,80 +31,88 @@ template<class SiteProblem, class MatrixType>
 void LanczosEvolver<Matrix, SymmGroup, TimeStepDistributorClass>::evolve_kernel(const SiteProblem& site_problem, MatrixType& matrix,
                                                                                 bool is_forward, time_type time_current, time_type time_step) const
 {
-  // Types definition
-  //using matrix_type = Eigen::Matrix< typename MatrixType::scalar_type, Eigen::Dynamic, Eigen::Dynamic >;
-  //using vector_type = Eigen::Matrix< typename MatrixType::scalar_type, Eigen::Dynamic, 1 >;
-  using matrix_type = alps::numeric::matrix< typename MatrixType::scalar_type >;
-  using vector_type = std::vector< typename MatrixType::scalar_type >;
   // Initialization.
-  MatrixType buffer_vector;
-  double error;
+  MatrixType buffer_vector, previous_vector, current_vector;
+  double error, sign = is_forward ? -1. : 1.;
   typename MatrixType::real_type norm_local;
-  typename MatrixType::scalar_type alpha, beta;
-  typename std::vector<MatrixType> lanczos_space;
+  std::vector<MatrixType> lanczos_space;
   // -- Outer loop --
-  // This is the loop over the exponential factors. 
+  // This is the loop over the exponential factors.
   for (int iExp = 0; iExp < numberOfExponentials; iExp++) {
-    std::size_t local_dim = 1;
-    matrix_type matrix_representation(max_iter_, max_iter_);
-    vector_type result_vector(1);
+    // The Lanczos coefficients are stored without sign, the tridiagonal matrix with sign
+    std::vector<double> alphas, betas, diagonal, off_diagonal;
+    vector_complex result_vector;
     lanczos_space.resize(0);
-    lanczos_space.reserve(max_iter_);
+    if (!two_pass_)
+      lanczos_space.reserve(max_iter_);
     // First step of the Lanczos iteration
     print_header();
-    lanczos_space.push_back(matrix);
-    buffer_vector = applyOperator(lanczos_space[0], site_problem, iExp, time_current, is_forward);
-    alpha = ietl::dot(matrix, buffer_vector);
-    if (is_forward)
-      matrix_representation(0,0) = -alpha;
-    else
-      matrix_representation(0,0) =  alpha;
-    buffer_vector -= alpha*lanczos_space[0];
+    current_vector = matrix;
+    if (!two_pass_)
+      lanczos_space.push_back(current_vector);
+    buffer_vector = applyOperator(current_vector, site_problem, iExp, time_current, is_forward);
+    alphas.push_back(maquis::real(ietl::dot(current_vector, buffer_vector)));
+    diagonal.push_back(sign*alphas.back());
+    buffer_vector -= scalar_type(alphas.back())*current_vector;
     // +-----------+
     //   MAIN LOOP
     // +-----------+
     for (std::size_t idx = 1; idx < max_iter_; idx++) {
-      // -- ACTUAL CALCULATION OF THE EXPONENTIAL --
-      apply_exponential(matrix_representation, result_vector, local_dim);
-      matrix = result_vector[0]*lanczos_space[0];
-      for (std::size_t i = 1; i < local_dim; i++)
-        matrix += result_vector[i]*lanczos_space[i];
-      if (is_imag_)
-        matrix /= ietl::two_norm(matrix);
-      // Check if the norm of the new Lanczos vector is non-zero
+      // Only the coefficients of the exponential are computed here, the propagated
+      // vector is assembled once at convergence.
+      result_vector = exponential_coefficients(diagonal, off_diagonal);
       norm_local = ietl::two_norm(buffer_vector);
-      if (local_dim == 1)
+      if (idx == 1)
         error = norm_local;
       else
-        error = std::norm(result_vector[local_dim-1])*norm_local;
-      // Temporary representation of the matrix
-      local_dim++;
-      print_data(local_dim-1, error);
+        error = std::norm(result_vector.back())*norm_local;
+      print_data(idx, error);
       if (norm_local < 1.0E-20 || error < threshold_) {
         print_line();
         break;
-      } else {
-        // Update of the vector space
-        buffer_vector /= norm_local;
-        lanczos_space.push_back(buffer_vector);
-        // Generation of the new vector
-        buffer_vector = applyOperator(lanczos_space[idx], site_problem, iExp, time_current, is_forward);
-        alpha = ietl::dot(buffer_vector, lanczos_space[idx]);
-        buffer_vector -= alpha*lanczos_space[idx] + norm_local*lanczos_space[idx-1];
-        //matrix_representation.conservativeResize(idx+1, idx+1);
-        if (is_forward) {
-          matrix_representation(idx, idx) = -alpha;
-          matrix_representation(idx-1, idx) = -norm_local;
-          matrix_representation(idx, idx-1) = -norm_local;
-        } else {
-          matrix_representation(idx, idx) = alpha;
-          matrix_representation(idx-1, idx) = norm_local;
-          matrix_representation(idx, idx-1) = norm_local;
-        }
       }
+      // Update of the vector space
+      buffer_vector /= norm_local;
+      swap(previous_vector, current_vector);
+      swap(current_vector, buffer_vector);
+      if (!two_pass_)
+        lanczos_space.push_back(current_vector);
+      // Generation of the new vector
+      buffer_vector = applyOperator(current_vector, site_problem, iExp, time_current, is_forward);
+      alphas.push_back(maquis::real(ietl::dot(buffer_vector, current_vector)));
+      betas.push_back(norm_local);
+      buffer_vector -= scalar_type(alphas.back())*current_vector + scalar_type(norm_local)*previous_vector;
+      diagonal.push_back(sign*alphas.back());
+      off_diagonal.push_back(sign*norm_local);
       if (idx == max_iter_-1)
         print_line();
     }
+    // The last Krylov vector may have been added after the last calculation of the coefficients
+    if (result_vector.size() != diagonal.size())
+      result_vector = exponential_coefficients(diagonal, off_diagonal);
+    // -- Assembly of the propagated vector --
+    if (!two_pass_) {
+      matrix = final_convert<scalar_type>(result_vector[0])*lanczos_space[0];
+      for (std::size_t i = 1; i < result_vector.size(); i++)
+        matrix += final_convert<scalar_type>(result_vector[i])*lanczos_space[i];
+    }
+    else {
+      // Second pass: the Krylov vectors are regenerated with the stored coefficients
+      current_vector = matrix;
+      matrix = final_convert<scalar_type>(result_vector[0])*current_vector;
+      for (std::size_t i = 1; i < result_vector.size(); i++) {
+        buffer_vector = applyOperator(current_vector, site_problem, iExp, time_current, is_forward);
+        buffer_vector -= scalar_type(alphas[i-1])*current_vector;
+        if (i > 1)
+          buffer_vector -= scalar_type(betas[i-2])*previous_vector;
+        buffer_vector /= betas[i-1];
+        swap(previous_vector, current_vector);
+        swap(current_vector, buffer_vector);
+        matrix += final_convert<scalar_type>(result_vector[i])*current_vector;
+      }
+    }
+    if (is_imag_)
+      matrix /= ietl::two_norm(matrix);
   }
 };
 
@@ -132,46 +140,29 @@ MatrixType LanczosEvolver<Matrix, SymmGroup, TimeStepDistributorClass>::applyOpe
 }
 
 template<class Matrix, class SymmGroup, TimeStepDistributor TimeStepDistributorClass>
-template<class MatrixType, class VectorType>
-void LanczosEvolver<Matrix, SymmGroup, TimeStepDistributorClass>::apply_exponential(MatrixType& hamiltonian_matrix, VectorType& ret, std::size_t local_dim_) const
+typename LanczosEvolver<Matrix, SymmGroup, TimeStepDistributorClass>::vector_complex
+LanczosEvolver<Matrix, SymmGroup, TimeStepDistributorClass>::exponential_coefficients(std::vector<double> const& diagonal,
+                                                                                      std::vector<double> const& off_diagonal) const
 {
-  // Types definition
-  //using ArgType = typename MatrixType::Scalar;
-  using ArgType = typename MatrixType::value_type;
-  matrix_complex H_hess(local_dim_, local_dim_);
-  //
-  for (std::size_t i = 0; i < local_dim_; i++) {
-    for (std::size_t j = 0; j < local_dim_; j++) {
-      if (i==j || i==j+1 || i==j-1) {
-        //if (!is_imag_) {
-        H_hess(i, j) = initial_convert<ArgType>(hamiltonian_matrix(i,j));
-        //}
-        //else {
-        //  H_hess(i, j) = -initial_convert<ArgType>(hamiltonian_matrix(i,j))*std::complex<double>(time_step_, 0.);
-        //}
-      }
-      else {
-        H_hess(i, j) = std::complex<double>(0., 0.);
-      }
-    }
-  }
-  matrix_complex expM;
+  // Eigendecomposition of the real symmetric tridiagonal matrix, O(k^2)
+  fortran_int_t local_dim = diagonal.size();
+  std::vector<double> eigenvalues(diagonal), sub_diagonal(off_diagonal), eigenvectors(local_dim*local_dim),
+                      work(std::max<fortran_int_t>(1, 2*local_dim-2));
+  sub_diagonal.resize(std::max<fortran_int_t>(1, local_dim-1));
+  fortran_int_t info = boost::numeric::bindings::lapack::detail::stev('V', local_dim, eigenvalues.data(), sub_diagonal.data(),
+                                                                      eigenvectors.data(), local_dim, work.data());
+  if (info != 0)
+    throw std::runtime_error("Error in the diagonalization of the Lanczos tridiagonal matrix");
+  // For imaginary-time propagations, we might encounter large numbers, shifts the spectrum
+  // by its smallest eigenvalue.
+  double shift = is_imag_ ? *std::min_element(eigenvalues.begin(), eigenvalues.end()) : 0.;
   auto coeff = (is_imag_) ? -std::complex<double>(time_step_, 0.) : std::complex<double>(0., time_step_);
-  expM = alps::numeric::exp_hermitian(H_hess, coeff, is_imag_);
-  /*
-  if (is_imag_) {
-    // For imaginary-time propagations, we might encounter large numbers, shifts the diagonal.
-    Eigen::ComplexEigenSolver<matrix_complex> es;
-    es.compute(H_hess);
-    matrix_complex exponentialOfEigenValues = matrix_complex(es.eigenvalues().asDiagonal())
-      - matrix_complex::Identity(local_dim_, local_dim_)*es.eigenvalues().real().maxCoeff();
-    expM = es.eigenvectors()*exponentialOfEigenValues.exp()*es.eigenvectors().transpose();
+  // First row of exp(coeff*T) = Z exp(coeff*Lambda) Z^T
+  vector_complex ret(local_dim, complex_type(0., 0.));
+  for (fortran_int_t j = 0; j < local_dim; j++) {
+    complex_type factor = eigenvectors[j*local_dim]*std::exp(coeff*(eigenvalues[j]-shift));
+    for (fortran_int_t idx = 0; idx < local_dim; idx++)
+      ret[idx] += factor*eigenvectors[j*local_dim+idx];
   }
-  else {
-    expM = H_hess.exp();
-  }
-  */
-  ret.resize(local_dim_);
-  for (std::size_t idx = 0; idx < local_dim_; idx++)
-    ret[idx] = final_convert<ArgType>(expM(0, idx));
-}
\ No newline at end of file
+  return ret;
+}
@@ -32,6 +32,7 @@
 #ifdef DMRG_TD
 
 #include <vector>
+#include <boost/numeric/bindings/lapack/driver/stev.hpp>
 //#include <Eigen/Core>
 //#include <unsupported/Eigen/MatrixFunctions>
 #include "TimeEvolutionAlgorithm.h"
@@ -83,9 +84,6 @@ class LanczosEvolver : public TimeEvolutionAlgorithm<Matrix, SymmGroup> {
   using base = typename TimeEvolutionAlgorithm<Matrix, SymmGroup>::TimeEvolutionAlgorithm;
   using scalar_type = typename MPSTensor<Matrix, SymmGroup>::scalar_type;
   using time_type = typename base::time_type;
-  //using matrix_complex = Eigen::Matrix< complex_type, Eigen::Dynamic, Eigen::Dynamic >;
-  //using vector_complex = Eigen::Matrix< complex_type, Eigen::Dynamic, 1 >;
-  using matrix_complex = alps::numeric::matrix< complex_type >;
   using vector_complex = std::vector< complex_type >;
   using FactorsType = typename TimeStepTraits<TimeStepDistributorClass>::FactorsType;
 
@@ -97,9 +95,16 @@ class LanczosEvolver : public TimeEvolutionAlgorithm<Matrix, SymmGroup> {
 
  public:
 
-  /* Class constructor */
-  LanczosEvolver(time_type time_step, bool has_td, bool is_imag, double threshold, std::size_t max_iter) 
-    : base(time_step, has_td, is_imag), threshold_(threshold), max_iter_(max_iter) {}
+  /**
+   * @brief Class constructor
+   * @param threshold convergence threshold on the error estimate of the propagated vector.
+   * @param max_iter maximum dimension of the Krylov space.
+   * @param two_pass if true, the Krylov vectors are not stored but regenerated in a second
+   * pass once the coefficients of the exponential have converged. This halves the memory
+   * of long real-time propagations at the price of twice as many applications of H.
+   */
+  LanczosEvolver(time_type time_step, bool has_td, bool is_imag, double threshold, std::size_t max_iter, bool two_pass=false)
+    : base(time_step, has_td, is_imag), threshold_(threshold), max_iter_(max_iter), two_pass_(two_pass) {}
 
   /* Time evolution method */
   void evolve(SiteProblem<Matrix, SymmGroup> const& site_problem, MPSTensor<Matrix, SymmGroup>& matrix,
@@ -119,17 +124,19 @@ class LanczosEvolver : public TimeEvolutionAlgorithm<Matrix, SymmGroup> {
   void evolve_kernel(SiteProblem const& site_problem, MatrixType& matrix, bool is_forward, time_type time_current,
                      time_type time_step) const;
 
-  /* Private method interfacing to Eigen matrix exponential calculator */
-  template<class MatrixType, class VectorType>
-  void apply_exponential(MatrixType& hamiltonian_matrix, VectorType& ret, size_t local_dim_) const;
+  /**
+   * @brief First row of the exponential of the Lanczos tridiagonal matrix.
+   * The real symmetric tridiagonal matrix is diagonalized directly with LAPACK (stev),
+   * so that each Krylov step costs O(k^2) instead of the O(k^3) of a dense complex
+   * matrix exponential.
+   * @param diagonal diagonal of the tridiagonal matrix (dimension k).
+   * @param off_diagonal off-diagonal of the tridiagonal matrix (dimension k-1).
+   */
+  vector_complex exponential_coefficients(std::vector<double> const& diagonal, std::vector<double> const& off_diagonal) const;
   template<class SiteProblem, class MatrixType>
   MatrixType applyOperator(const MatrixType& inputVec, const SiteProblem& site_problem, int idExp, time_type time_current, bool is_forward) const;
 
-  /* Real --> Complex conversion routines */
-  template< class ArgType, typename std::enable_if< std::is_same<double, ArgType >::value>::type * = nullptr >
-  complex_type initial_convert(const ArgType& input) const { return std::complex<double>(input, 0.) ; };
-  template< class ArgType, typename std::enable_if< std::is_same< typename std::complex<double>, ArgType >::value>::type * = nullptr >
-  complex_type initial_convert(const ArgType& input) const { return input ; };
+  /* Complex --> scalar conversion routines */
   template< class ArgType, typename std::enable_if< std::is_same<double, ArgType >::value>::type * = nullptr >
   ArgType final_convert(const complex_type& input) const { return std::real(input) ; };
   template< class ArgType, typename std::enable_if< std::is_same< typename std::complex<double>, ArgType >::value>::type * = nullptr >
@@ -153,6 +160,7 @@ class LanczosEvolver : public TimeEvolutionAlgorithm<Matrix, SymmGroup> {
   /* Class members */
   std::size_t max_iter_;
   double threshold_;
+  bool two_pass_;
   static const FactorsType factorsAndSteps;
   static const int numberOfExponentials;
   static const int numberOfFactorsPerExponential;
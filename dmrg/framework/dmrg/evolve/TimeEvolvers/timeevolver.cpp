@@ -49,6 +49,7 @@ TimeEvolver<Matrix, SymmGroup, ParameterType>::TimeEvolver(ParameterType& parms)
 {
   if (parms["imaginary_time"] == "yes")
     is_imag_ = true;
+  bool two_pass = (parms["propagator_two_pass"] == "yes");
   time_step_ /= 2.;
   // Set the time step. Check also all relevant units conversion.
   if (parms["hamiltonian_units"] == "Hartree") {
@@ -70,18 +71,18 @@ TimeEvolver<Matrix, SymmGroup, ParameterType>::TimeEvolver(ParameterType& parms)
       time_evolution_algorithm_ = std::make_unique< RKEvolver<Matrix, SymmGroup> >(time_step_, has_td_part_, is_imag_);
     }
     else if (intAlgo == "EMR2") {
-      time_evolution_algorithm_ = std::make_unique< LanczosEMR >(time_step_, has_td_part_, is_imag_, accuracy_, max_iterations_);
+      time_evolution_algorithm_ = std::make_unique< LanczosEMR >(time_step_, has_td_part_, is_imag_, accuracy_, max_iterations_, two_pass);
       // This must be decommented once it works.
       //useExtrapolated_ = true;
     }
     else if (intAlgo == "CF4") {
-      time_evolution_algorithm_ = std::make_unique< LanczosFourthOrder>(time_step_, has_td_part_, is_imag_, accuracy_, max_iterations_);
+      time_evolution_algorithm_ = std::make_unique< LanczosFourthOrder>(time_step_, has_td_part_, is_imag_, accuracy_, max_iterations_, two_pass);
     }
     else {
       throw std::runtime_error("TD integration algorithm not recognized");
     }
   } else {
-    time_evolution_algorithm_ = std::make_unique< LanczosTI >(time_step_, has_td_part_, is_imag_, accuracy_, max_iterations_);
+    time_evolution_algorithm_ = std::make_unique< LanczosTI >(time_step_, has_td_part_, is_imag_, accuracy_, max_iterations_, two_pass);
   }
 };
 
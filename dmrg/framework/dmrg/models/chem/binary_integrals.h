@@ -0,0 +1,256 @@
+/*****************************************************************************
+ *
+ * QCMaquis DMRG Project
+ *
+ * Copyright (C) 2021 Laboratory for Physical Chemistry, ETH Zurich
+ *
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef QC_CHEM_BINARY_INTEGRALS_H
+#define QC_CHEM_BINARY_INTEGRALS_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef MAQUIS_OPENMP
+#include <omp.h>
+#endif
+
+#include "integral_interface.h"
+#include "dmrg/utils/archive.h"
+
+namespace chem {
+namespace detail {
+
+    /**
+     * @brief Header of the binary integral files.
+     *
+     * The header is followed by the packed array of the 4*[n_integrals] indices (32-bit
+     * integers, FCIDUMP convention) and by the packed array of the [n_integrals] values,
+     * in the same order as the lines of the FCIDUMP file they have been converted from.
+     */
+    struct binary_integral_header
+    {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t is_complex;
+        std::uint64_t n_integrals;
+        std::uint64_t reserved;
+    };
+
+    inline const char* binary_integral_magic() { return "QCMINTB"; }
+
+    /** @brief Checks whether [file] is a binary integral file (and not an FCIDUMP file) */
+    inline bool is_binary_integral_file(std::string const & file)
+    {
+        std::ifstream ifs(file.c_str(), std::ios::binary);
+        char magic[8] = {0};
+        ifs.read(magic, sizeof(magic));
+        return ifs && std::memcmp(magic, binary_integral_magic(), sizeof(magic)) == 0;
+    }
+
+    /** @brief Writes the integrals, given as flat index array and value array, to a binary integral file */
+    template <class T>
+    void write_binary_integrals(std::string const & file, std::vector<std::int32_t> const & indices, std::vector<T> const & values)
+    {
+        if (indices.size() != 4*values.size())
+            throw std::runtime_error("Inconsistent number of integral indices and values");
+        binary_integral_header header;
+        std::memcpy(header.magic, binary_integral_magic(), sizeof(header.magic));
+        header.version = 1;
+        header.is_complex = is_complex_t<T>::value;
+        header.n_integrals = values.size();
+        header.reserved = 0;
+        std::ofstream ofs(file.c_str(), std::ios::binary | std::ios::trunc);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(indices.data()), indices.size()*sizeof(std::int32_t));
+        ofs.write(reinterpret_cast<const char*>(values.data()), values.size()*sizeof(T));
+        if (!ofs)
+            throw std::runtime_error("Error writing the binary integral file " + file);
+    }
+
+    /**
+     * @brief Read-only memory mapping of a binary integral file.
+     *
+     * The integrals are paged in by the kernel as they are accessed, and can be
+     * read concurrently by several threads.
+     */
+    template <class T>
+    class mapped_integrals
+    {
+    public:
+        explicit mapped_integrals(std::string const & file) : size_(0), data_(NULL)
+        {
+            int fd = ::open(file.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("Error opening the binary integral file " + file);
+            struct stat st;
+            if (::fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(binary_integral_header)) {
+                ::close(fd);
+                throw std::runtime_error("Invalid binary integral file " + file);
+            }
+            size_ = st.st_size;
+            void* ptr = ::mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            // The mapping stays valid after closing the descriptor
+            ::close(fd);
+            if (ptr == MAP_FAILED)
+                throw std::runtime_error("Error mapping the binary integral file " + file);
+            data_ = static_cast<const char*>(ptr);
+            ::posix_madvise(ptr, size_, POSIX_MADV_SEQUENTIAL);
+
+            binary_integral_header const & header = *reinterpret_cast<const binary_integral_header*>(data_);
+            std::string error;
+            if (std::memcmp(header.magic, binary_integral_magic(), sizeof(header.magic)) != 0 || header.version != 1)
+                error = "Invalid binary integral file " + file;
+            else if (header.is_complex != static_cast<std::uint32_t>(is_complex_t<T>::value))
+                error = "The binary integral file " + file + " does not match the real/complex integral type";
+            else if (size_ != sizeof(binary_integral_header) + header.n_integrals*(4*sizeof(std::int32_t) + sizeof(T)))
+                error = "The binary integral file " + file + " is truncated";
+            if (!error.empty()) {
+                ::munmap(const_cast<char*>(data_), size_);
+                throw std::runtime_error(error);
+            }
+            n_integrals_ = header.n_integrals;
+        }
+
+        ~mapped_integrals() { ::munmap(const_cast<char*>(data_), size_); }
+
+        mapped_integrals(mapped_integrals const&) = delete;
+        mapped_integrals& operator=(mapped_integrals const&) = delete;
+
+        /** @brief Number of integrals in the file */
+        std::size_t size() const { return n_integrals_; }
+
+        /** @brief Pointer to the four indices of the i-th integral */
+        const std::int32_t* index(std::size_t i) const
+        {
+            return reinterpret_cast<const std::int32_t*>(data_ + sizeof(binary_integral_header)) + 4*i;
+        }
+
+        /** @brief Value of the i-th integral */
+        T value(std::size_t i) const
+        {
+            T ret;
+            std::memcpy(&ret, data_ + sizeof(binary_integral_header) + n_integrals_*4*sizeof(std::int32_t) + i*sizeof(T), sizeof(T));
+            return ret;
+        }
+
+    private:
+        std::size_t size_, n_integrals_;
+        const char* data_;
+    };
+
+    /**
+     * @brief Selects the integrals above the cutoff and transforms their indices, in parallel.
+     *
+     * The integrals are split in contiguous chunks, one per thread: a first pass counts
+     * the integrals of each chunk above the cutoff, a second one writes them at the
+     * offset of the chunk, so that the order of the file is preserved.
+     *
+     * @param ints mapped integral file.
+     * @param cutoff integrals whose absolute value is not larger than [cutoff] are skipped.
+     * @param transform functor mapping the four FCIDUMP indices of an integral to the stored indices.
+     */
+    template <class T, class IndexType, class Transform>
+    void filter_integrals(mapped_integrals<T> const & ints, double cutoff, Transform transform,
+                          std::vector<IndexType> & indices, std::vector<T> & values)
+    {
+#ifdef MAQUIS_OPENMP
+        std::size_t n_chunks = omp_get_max_threads();
+#else
+        std::size_t n_chunks = 1;
+#endif
+        std::size_t n = ints.size(), chunk = (n + n_chunks - 1) / n_chunks;
+        std::vector<std::size_t> offsets(n_chunks+1, 0);
+#ifdef MAQUIS_OPENMP
+        #pragma omp parallel for schedule(static, 1)
+#endif
+        for (std::size_t c = 0; c < n_chunks; ++c)
+            for (std::size_t i = c*chunk; i < std::min(n, (c+1)*chunk); ++i)
+                if (std::abs(ints.value(i)) > cutoff)
+                    ++offsets[c+1];
+        for (std::size_t c = 0; c < n_chunks; ++c)
+            offsets[c+1] += offsets[c];
+
+        std::size_t first = values.size();
+        indices.resize(first + offsets[n_chunks]);
+        values.resize(first + offsets[n_chunks]);
+#ifdef MAQUIS_OPENMP
+        #pragma omp parallel for schedule(static, 1)
+#endif
+        for (std::size_t c = 0; c < n_chunks; ++c) {
+            std::size_t pos = first + offsets[c];
+            for (std::size_t i = c*chunk; i < std::min(n, (c+1)*chunk); ++i) {
+                T val = ints.value(i);
+                if (std::abs(val) > cutoff) {
+                    const std::int32_t* idx = ints.index(i);
+                    indices[pos] = transform(idx[0], idx[1], idx[2], idx[3]);
+                    values[pos++] = val;
+                }
+            }
+        }
+    }
+
+    /** @brief Stores an integral map in [ar] as the datasets [path]/indices and [path]/values */
+    template <class T>
+    void save_integral_datasets(storage::archive & ar, std::string const & path, integral_map<T> const & ints)
+    {
+        std::vector<int> indices;
+        std::vector<T> values;
+        indices.reserve(4*ints.size());
+        values.reserve(ints.size());
+        for (auto&& t: ints) {
+            indices.insert(indices.end(), t.first.begin(), t.first.end());
+            values.push_back(t.second);
+        }
+        ar[path + "/indices"] << indices;
+        ar[path + "/values"] << values;
+    }
+
+    /** @brief Loads an integral map stored with [save_integral_datasets] */
+    template <class T>
+    integral_map<T> load_integral_datasets(storage::archive & ar, std::string const & path)
+    {
+        std::vector<int> indices;
+        std::vector<T> values;
+        ar[path + "/indices"] >> indices;
+        ar[path + "/values"] >> values;
+        if (indices.size() != 4*values.size())
+            throw std::runtime_error("Inconsistent integral datasets in " + path);
+        integral_map<T> ret;
+        for (std::size_t i = 0; i < values.size(); ++i)
+            ret[{indices[4*i], indices[4*i+1], indices[4*i+2], indices[4*i+3]}] = values[i];
+        return ret;
+    }
+
+} // namespace detail
+} // namespace chem
+
+#endif
@@ -30,6 +30,7 @@
 #define QC_CHEM_PARSE_INTEGRALS_H
 
 #include "integral_interface.h"
+#include "dmrg/models/chem/binary_integrals.h"
 
 namespace chem {
 namespace detail {
@@ -57,6 +58,36 @@ namespace detail {
         }
     }
 
+    /**
+     * @brief Converts an FCIDUMP file to the binary integral format read by [parse_integrals].
+     * @param fcidump FCIDUMP file, including the four header lines.
+     * @param binary_file output file.
+     * @return the number of integrals.
+     */
+    template <class T>
+    std::size_t convert_fcidump(std::string const & fcidump, std::string const & binary_file)
+    {
+        std::ifstream orb_file(fcidump.c_str());
+        if (!orb_file)
+            throw std::runtime_error("integral_file " + fcidump + " does not exist\n");
+        for (int i = 0; i < 4; ++i)
+            orb_file.ignore(std::numeric_limits<std::streamsize>::max(),'\n');
+
+        std::vector<std::int32_t> indices;
+        std::vector<T> values;
+        T val;
+        while (parser_detail::read_value<T>(orb_file, val))
+        {
+            std::int32_t i, j, k, l;
+            if (!(orb_file >> i >> j >> k >> l))
+                throw std::runtime_error("error parsing integrals");
+            indices.insert(indices.end(), {i, j, k, l});
+            values.push_back(val);
+        }
+        write_binary_integrals(binary_file, indices, values);
+        return values.size();
+    }
+
     // now the integral parser can both real and complex integrals without specialization
     template <class T, class SymmGroup>
     inline
@@ -104,6 +135,20 @@ namespace detail {
 
         std::vector<index_type<Hamiltonian::Electronic>> indices;
 
+        // Indices of an integral as stored in the model: reordered and aligned, starting from 0
+        auto transform = [&](int i, int j, int k, int l) -> index_type<Hamiltonian::Electronic>
+        {
+            if (do_align)
+            {
+                IndexTuple aligned = align<SymmGroup>(reorderer()(i-1, inv_order), reorderer()(j-1, inv_order),
+                                                      reorderer()(k-1, inv_order), reorderer()(l-1, inv_order));
+                return { aligned[0], aligned[1], aligned[2], aligned[3] };
+            }
+            else
+                return { i-1, j-1, k-1, l-1 };
+        };
+        double cutoff = parms["integral_cutoff"];
+
         // Stream used to load FCIDUMP file/FCIDUMP string
         std::unique_ptr<std::istream> orb_string;
 
@@ -113,6 +158,11 @@ namespace detail {
             std::string integrals = parms["integrals"];
             orb_string = std::unique_ptr<std::istringstream>(new std::istringstream(integrals));
         }
+        else if (parms.is_set("integral_file") && is_binary_integral_file(parms["integral_file"].str())) // Binary integral file
+        {
+            mapped_integrals<T> ints(parms["integral_file"].str());
+            filter_integrals(ints, cutoff, transform, indices, matrix_elements);
+        }
         else if (parms.is_set("integral_file")) // FCIDUMP file
         {
             std::string integral_file = parms["integral_file"];
@@ -130,25 +180,14 @@ namespace detail {
         {
             // parse serialized integrals
 
-            integral_map<T> ints;
-            std::stringstream ss(parms["integrals_binary"].as<std::string>());
-
-            boost::archive::text_iarchive ia{ss};
-            ia >> ints;
+            integral_map<T> ints = deserialize<T>(parms["integrals_binary"].as<std::string>());
 
             for (auto&& t: ints)
             {
-                if (std::abs(t.second) > parms["integral_cutoff"])
+                if (std::abs(t.second) > cutoff)
                 {
                     matrix_elements.push_back(t.second);
-                    if (do_align)
-                    {
-                        IndexTuple aligned = align<SymmGroup>(reorderer()(t.first[0]-1, inv_order), reorderer()(t.first[1]-1, inv_order),
-                                                reorderer()(t.first[2]-1, inv_order), reorderer()(t.first[3]-1, inv_order));
-                        indices.push_back({ aligned[0], aligned[1], aligned[2], aligned[3] });
-                    }
-                    else
-                        indices.push_back({ t.first[0]-1, t.first[1]-1, t.first[2]-1, t.first[3]-1 });
+                    indices.push_back(transform(t.first[0], t.first[1], t.first[2], t.first[3]));
                 }
             }
         }
@@ -160,7 +199,8 @@ namespace detail {
         // which is the case exactly when we want to parse the FCIDUMP file (see above, i.e. when
         // parms["integrals"] or parms["integral_file"] is set.
         // Otherwise, the pointer is empty,
-        // but parms["integrals_binary"] is set and parsing is already completed, so the below can be skipped.
+        // but a binary integral file or parms["integrals_binary"] is set and parsing is already completed,
+        // so the below can be skipped.
         {
             T val;
             // use our specialization to read either real or complex value from the file
@@ -178,18 +218,10 @@ namespace detail {
                     throw std::runtime_error("error parsing integrals");
                 }
                 // ignore integrals that are below the cutoff threshold
-                if (std::abs(t.second) > parms["integral_cutoff"])
+                if (std::abs(t.second) > cutoff)
                 {
                     matrix_elements.push_back(t.second);
-                    if (do_align)
-                    {
-                        IndexTuple aligned = align<SymmGroup>(reorderer()(t.first[0]-1, inv_order), reorderer()(t.first[1]-1, inv_order),
-                                                reorderer()(t.first[2]-1, inv_order), reorderer()(t.first[3]-1, inv_order));
-                        indices.push_back({ aligned[0], aligned[1], aligned[2], aligned[3] });
-                    }
-                    else
-                        indices.push_back({ t.first[0]-1, t.first[1]-1, t.first[2]-1, t.first[3]-1 });
-
+                    indices.push_back(transform(t.first[0], t.first[1], t.first[2], t.first[3]));
                 }
             }
         }
@@ -39,6 +39,7 @@
 #include<numeric>
 
 #include "dmrg/utils/BaseParameters.h"
+#include "dmrg/models/chem/binary_integrals.h"
 
 class ChainLattice : public lattice_impl
 {
@@ -166,7 +167,9 @@ public:
             for (auto&& o: order) o--;
         }
 
-        if (parms.is_set("integral_file")) {
+        // The site types are read from the header of FCIDUMP files, binary integral files have no header
+        bool fcidump = parms.is_set("integral_file") && !chem::detail::is_binary_integral_file(parms["integral_file"].str());
+        if (fcidump) {
             std::string integral_file = parms["integral_file"];
             if (!boost::filesystem::exists(integral_file))
                 throw std::runtime_error("integral_file " + integral_file + " does not exist\n");
@@ -196,7 +199,7 @@ public:
                 irreps[p] = symm_vec[order[p]];
         }
         else
-            throw std::runtime_error("\"integral_file\" in parms input file or site_types is not set\n");
+            throw std::runtime_error("\"integral_file\" (FCIDUMP) in parms input file or site_types is not set\n");
 
         maximum_vertex = *std::max_element(irreps.begin(), irreps.end());
     }
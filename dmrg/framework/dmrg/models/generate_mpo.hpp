@@ -43,4 +43,17 @@ MPO<Matrix, SymmGroup> make_mpo(Lattice const& lat, Model<Matrix, SymmGroup> & m
     return mpo;
 }
 
+/**
+ * @brief Same as above, and stores in [coefficients] where the coefficient of each term ends up,
+ * so that the MPO can be updated with [generate_mpo::update_coefficients]
+ */
+template<class Matrix, class SymmGroup>
+MPO<Matrix, SymmGroup> make_mpo(Lattice const& lat, Model<Matrix, SymmGroup> & model,
+                                generate_mpo::CoefficientMap<Matrix, SymmGroup> & coefficients)
+{
+    model.create_terms();
+    generate_mpo::TaggedMPOMaker<Matrix, SymmGroup> mpom(lat, model);
+    return mpom.create_mpo(&coefficients);
+}
+
 #endif
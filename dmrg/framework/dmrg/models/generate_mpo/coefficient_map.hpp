@@ -0,0 +1,156 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef GENERATE_MPO_COEFFICIENT_MAP_H
+#define GENERATE_MPO_COEFFICIENT_MAP_H
+
+#include "dmrg/mp_tensors/mpo.h"
+#include "dmrg/models/lattice.h"
+#include "dmrg/models/model.h"
+
+#include <complex>
+#include <limits>
+#include <map>
+#include <vector>
+
+namespace generate_mpo
+{
+    /**
+     * @brief Location of the coefficients of the Hamiltonian terms in an MPO built by [TaggedMPOMaker]
+     *
+     * The coefficient of a term with more than one operator is the scale of a (tag, scale) pair
+     * of a single MPO element, called here a slot. The terms with one operator are summed into one
+     * operator per site, and the ones with the identity give the core energy.
+     * Where a term ends up in the MPO depends only on its operator string, so that the map built
+     * together with an MPO holds for any set of terms with the same operator strings.
+     */
+    template<class Matrix, class SymmGroup>
+    struct CoefficientMap
+    {
+        typedef typename MPOTensor<Matrix, SymmGroup>::index_type index_type;
+        typedef typename MPOTensor<Matrix, SymmGroup>::tag_type tag_type;
+        typedef Lattice::pos_t pos_t;
+
+        /** @brief The (tag, scale) pairs with the tag [tag] of the element (b1, b2) of the MPOTensor on site p */
+        struct slot {
+            pos_t p;
+            index_type b1, b2;
+            tag_type tag;
+        };
+
+        /** Marks the terms with one operator in [term_slot] */
+        static const std::size_t site_term = std::numeric_limits<std::size_t>::max();
+        static const std::size_t core_term = std::numeric_limits<std::size_t>::max() - 1;
+
+        /** Slot of each term, in the order in which the terms were added to the MPO */
+        std::vector<std::size_t> term_slot;
+        std::vector<slot> slots;
+        /** Slot holding the sum of the one-site terms of each site */
+        std::map<pos_t, slot> site_slots;
+        /** False if the pairs of a slot are not all coefficients of terms, e.g., if a filling has the same tag */
+        bool valid = false;
+    };
+
+    template<class Matrix, class SymmGroup>
+    const std::size_t CoefficientMap<Matrix, SymmGroup>::site_term;
+
+    template<class Matrix, class SymmGroup>
+    const std::size_t CoefficientMap<Matrix, SymmGroup>::core_term;
+
+    /**
+     * @brief Rewrites the coefficients of an MPO with the ones of a new set of terms
+     *
+     * [mpo] must have been built from [old_terms], and [coefficients] together with it. The sparsity
+     * pattern, the tags, the spins and the hermitian pairs of the MPO are kept, and only the scales,
+     * the one-site operators and the core energy are overwritten.
+     * The one-site operators are changed in the operator table, which the MPO shares with its copies.
+     *
+     * @return false, with [mpo] left untouched, if the operator strings of [new_terms] differ from
+     * the ones of [old_terms], e.g. because some integrals fell below the cutoff.
+     */
+    template<class Matrix, class SymmGroup>
+    bool update_coefficients(MPO<Matrix, SymmGroup> & mpo, CoefficientMap<Matrix, SymmGroup> const & coefficients,
+                             typename Model<Matrix, SymmGroup>::terms_type const & old_terms,
+                             typename Model<Matrix, SymmGroup>::terms_type const & new_terms)
+    {
+        typedef CoefficientMap<Matrix, SymmGroup> map_type;
+        typedef typename Model<Matrix, SymmGroup>::term_descriptor term_descriptor;
+        typedef typename term_descriptor::base operator_string;
+        typedef typename OPTable<Matrix, SymmGroup>::op_t op_t;
+
+        if (!coefficients.valid || coefficients.term_slot.size() != old_terms.size() || new_terms.size() != old_terms.size())
+            return false;
+        for (std::size_t t = 0; t < new_terms.size(); ++t)
+            if (static_cast<operator_string const &>(new_terms[t]) != static_cast<operator_string const &>(old_terms[t]))
+                return false;
+
+        // The coefficients of the terms in the same slot are summed, as the operator is the same
+        std::vector<typename Matrix::value_type> scales(coefficients.slots.size(), 0.);
+        std::map<typename map_type::pos_t, op_t> site_ops;
+        double core_energy = 0.;
+        for (std::size_t t = 0; t < new_terms.size(); ++t) {
+            term_descriptor const & term = new_terms[t];
+            std::size_t s = coefficients.term_slot[t];
+            if (s == map_type::core_term) {
+                core_energy += std::real(term.coeff);
+            }
+            else if (s == map_type::site_term) {
+                op_t current_op = (*mpo[term.position(0)].get_operator_table())[term.operator_tag(0)];
+                current_op *= term.coeff;
+                site_ops[term.position(0)] += current_op;
+            }
+            else {
+                scales[s] += term.coeff;
+            }
+        }
+
+        for (std::size_t s = 0; s < coefficients.slots.size(); ++s) {
+            typename map_type::slot const & sl = coefficients.slots[s];
+            MPOTensor_detail::term_descriptor<Matrix, SymmGroup, false> element = mpo[sl.p].at(sl.b1, sl.b2);
+            bool first = true;
+            for (std::size_t i = 0; i < element.size(); ++i)
+                if (mpo[sl.p].tag_number(sl.b1, sl.b2, i) == sl.tag) {
+                    element.scale(i) = first ? scales[s] : 0.;
+                    first = false;
+                }
+        }
+
+        for (typename std::map<typename map_type::pos_t, op_t>::const_iterator it = site_ops.begin(); it != site_ops.end(); ++it) {
+            typename map_type::slot const & sl = coefficients.site_slots.find(it->first)->second;
+            MPOTensor_detail::term_descriptor<Matrix, SymmGroup, false> element = mpo[sl.p].at(sl.b1, sl.b2);
+            for (std::size_t i = 0; i < element.size(); ++i)
+                if (mpo[sl.p].tag_number(sl.b1, sl.b2, i) == sl.tag) {
+                    element.op(i) = it->second;
+                    element.op(i).update_sparse();
+                }
+        }
+
+        mpo.setCoreEnergy(core_energy);
+        return true;
+    }
+}
+
+#endif
@@ -31,6 +31,7 @@
 #define GENERATE_MPO_TAGGED_MPO_MAKER_H
 
 #include "dmrg/models/generate_mpo/utils.hpp"
+#include "dmrg/models/generate_mpo/coefficient_map.hpp"
 
 #include "dmrg/block_matrix/block_matrix.h"
 #include "dmrg/block_matrix/block_matrix_algorithms.h"
@@ -42,9 +43,16 @@
 #include "dmrg/models/lattice.h"
 #include "dmrg/models/model.h"
 
+#include <cstdint>
+#include <limits>
+#include <numeric>
 #include <string>
 #include <sstream>
 #include <tuple>
+#include <algorithm>
+#include <unordered_map>
+
+#include <boost/functional/hash.hpp>
 
 namespace generate_mpo
 {
@@ -88,6 +96,133 @@ namespace generate_mpo
                 return (pos_op == lhs.pos_op) ? offset < lhs.offset : pos_op < lhs.pos_op;
             }
         };
+
+        /** @brief Hash function consistent with the equality operator of [prempo_key] */
+        template <typename pos_t, typename tag_type, typename index_type>
+        struct prempo_key_hash {
+            std::size_t operator()(prempo_key<pos_t, tag_type, index_type> const& key) const
+            {
+                typedef prempo_key<pos_t, tag_type, index_type> key_type;
+                std::size_t seed = static_cast<std::size_t>(key.kind);
+                if (key.kind == key_type::trivial_left || key.kind == key_type::trivial_right)
+                    return seed;
+                boost::hash_combine(seed, key.offset);
+                for (auto const& po : key.pos_op) {
+                    boost::hash_combine(seed, po.first);
+                    boost::hash_combine(seed, po.second);
+                }
+                return seed;
+            }
+        };
+
+        /**
+         * @brief Pool of interned prempo keys
+         *
+         * Each distinct key is stored once and is referenced everywhere else by an
+         * integer id, so that the prempo entries do not carry copies of the vectors
+         * of position/tag pairs and can be compared and hashed as integers.
+         * The lookup of a key ([find]) does not modify the pool and can be done
+         * concurrently by several threads.
+         */
+        template <class Key, class Hash>
+        class prempo_key_pool {
+        public:
+            typedef std::uint32_t id_type;
+            static const id_type npos = std::numeric_limits<id_type>::max();
+
+            /** @brief Returns the id of the key, adding it to the pool if it is not there yet */
+            id_type intern(Key const& key)
+            {
+                std::size_t h = Hash()(key);
+                id_type ret = find(key, h);
+                if (ret == npos) {
+                    ret = static_cast<id_type>(keys_.size());
+                    keys_.push_back(key);
+                    buckets_.insert(std::make_pair(h, ret));
+                }
+                return ret;
+            }
+
+            /** @brief Returns the id of the key, or [npos] if the key is not in the pool */
+            id_type find(Key const& key) const { return find(key, Hash()(key)); }
+
+            Key const& operator[](id_type id) const { return keys_[id]; }
+
+            std::size_t size() const { return keys_.size(); }
+
+            /** @brief Rank of each key in the ordering given by [Key::operator<], equivalent keys share the rank */
+            std::vector<id_type> ranks() const
+            {
+                std::vector<id_type> order(keys_.size()), ret(keys_.size());
+                std::iota(order.begin(), order.end(), 0);
+                std::sort(order.begin(), order.end(), [this](id_type i, id_type j) { return keys_[i] < keys_[j]; });
+                for (std::size_t i = 0; i < order.size(); ++i)
+                    ret[order[i]] = (i > 0 && !(keys_[order[i-1]] < keys_[order[i]])) ? ret[order[i-1]] : static_cast<id_type>(i);
+                return ret;
+            }
+
+        private:
+            id_type find(Key const& key, std::size_t h) const
+            {
+                auto range = buckets_.equal_range(h);
+                for (auto it = range.first; it != range.second; ++it)
+                    if (keys_[it->second] == key)
+                        return it->second;
+                return npos;
+            }
+
+            std::vector<Key> keys_;
+            std::unordered_multimap<std::size_t, id_type> buckets_;
+        };
+
+        template <class Key, class Hash>
+        const typename prempo_key_pool<Key, Hash>::id_type prempo_key_pool<Key, Hash>::npos;
+
+        /**
+         * @brief Pre-MPO entries of a site
+         *
+         * Multimap from pairs of key ids (left and right bond labels) to values. The
+         * entries are stored in insertion order, and a hash map gives the first entry
+         * and the number of entries of each pair of keys.
+         */
+        template <class Id, class Value>
+        class prempo_map {
+        public:
+            struct entry {
+                Id k1, k2;
+                Value value;
+            };
+
+            void insert(Id k1, Id k2, Value const& value)
+            {
+                auto ret = index_.insert(std::make_pair(pack(k1, k2), std::make_pair(entries_.size(), std::size_t(0))));
+                ++ret.first->second.second;
+                entries_.push_back(entry{k1, k2, value});
+            }
+
+            /** @brief Number of entries of the pair of keys */
+            std::size_t count(Id k1, Id k2) const
+            {
+                auto it = index_.find(pack(k1, k2));
+                return (it == index_.end()) ? 0 : it->second.second;
+            }
+
+            /** @brief First entry of the pair of keys, which must be present */
+            Value const& find(Id k1, Id k2) const
+            {
+                return entries_[index_.find(pack(k1, k2))->second.first].value;
+            }
+
+            std::vector<entry> const& entries() const { return entries_; }
+
+            std::size_t size() const { return entries_.size(); }
+
+        private:
+            static std::uint64_t pack(Id k1, Id k2) { return (static_cast<std::uint64_t>(k1) << 32) | k2; }
+
+            std::vector<entry> entries_;
+            std::unordered_map<std::uint64_t, std::pair<std::size_t, std::size_t> > index_;
+        };
     }
 
     template <typename pos_t, typename tag_type, typename index_type>
@@ -112,7 +247,8 @@ namespace generate_mpo
      * fillings: tag associated with the filling operator
      * lenght: lattice size
      * tag_handler: map in which all the operators are stored as tags
-     * prempo: vector of prempo_map_type objects, which are map associating pairs of prempo_key objects to values 
+     * keys: pool storing each prempo_key object once, the other containers refer to the keys by their id
+     * prempo: vector of prempo_map_type objects, which are map associating pairs of prempo_key ids to values 
      *         (i.e., coefficients of the Hamiltonian). The pair of objects, which are the keyword for the dictionary,
      *         are the labels which are associated to the MPO bond, i.e. the operators which have been
      *         applied before and/or after the current site
@@ -135,9 +271,11 @@ namespace generate_mpo
         typedef std::vector<tag_type> tag_vec;
         typedef detail::prempo_key<pos_t, tag_type, index_type> prempo_key_type;
         typedef std::pair<tag_type, scale_type> prempo_value_type;
-        // TODO: consider moving to hashmap
-        typedef std::multimap<std::pair<prempo_key_type, prempo_key_type>, prempo_value_type,
-                              compare_pair_inverse<std::pair<prempo_key_type, prempo_key_type> > > prempo_map_type;
+        typedef detail::prempo_key_pool<prempo_key_type, detail::prempo_key_hash<pos_t, tag_type, index_type> > key_pool_type;
+        typedef typename key_pool_type::id_type key_id;
+        typedef detail::prempo_map<key_id, prempo_value_type> prempo_map_type;
+        typedef CoefficientMap<Matrix, SymmGroup> coefficient_map_type;
+        typedef std::vector<std::vector<std::pair<index_type, index_type> > > bond_table;
         enum merge_kind {attach, detach};
 
     public:
@@ -216,111 +354,162 @@ namespace generate_mpo
             rightmost_left = std::max(rightmost_left, term.begin()->first);
         }
 
-        /** @bref Creates the MPO based on the tagged MPO object */
-        MPO<Matrix, SymmGroup> create_mpo()
+        /**
+         * @bref Creates the MPO based on the tagged MPO object
+         *
+         * The labels of the right bond of a site depend only on the prempo entries of that
+         * site, so that the bonds and the MPOTensors of the different sites are built
+         * concurrently. Only the coupling of the spins is propagated from left to right.
+         * If [coefficients] is given, it is filled with the location of the coefficient of each term.
+         */
+        MPO<Matrix, SymmGroup> create_mpo(coefficient_map_type* coefficients = nullptr)
         {
             if (!finalized) finalize();
-            MPO<Matrix, SymmGroup> mpo; mpo.reserve(length);
-
-            typedef std::map<prempo_key_type, index_type> index_map;
-            typedef typename index_map::iterator index_iterator;
-            index_map left;
-            left[trivial_left] = 0;
 
+            typedef std::unordered_map<key_id, index_type> index_map;
+            typedef typename index_map::const_iterator index_iterator;
             typedef SpinDescriptor<typename symm_traits::SymmType<SymmGroup>::type> spin_desc_t;
-            std::vector<spin_desc_t> left_spins(1);
-            std::vector<index_type> LeftHerm(1);
-            std::vector<int> LeftPhase(1,1);
-
+            key_id trivial_left_id = keys.intern(trivial_left), trivial_right_id = keys.intern(trivial_right);
+            std::vector<key_id> rank = keys.ranks();
+
+            // -- Labels of the right bond of each site --
+            index_map first_bond;
+            first_bond[trivial_left_id] = 0;
+            std::vector<index_map> right(length);
+            std::vector<std::vector<std::size_t> > order(length);
+            std::vector<std::vector<std::pair<key_id, std::pair<key_id, std::pair<int,int> > > > > HermKeyPairs(length);
+#ifdef MAQUIS_OPENMP
+            #pragma omp parallel for schedule(dynamic)
+#endif
             for (pos_t p = 0; p < length; ++p) {
-                std::vector<tag_block> pre_tensor; pre_tensor.reserve(prempo[p].size());
-                std::map<prempo_key_type, prempo_key_type> HermKeyPairs;
-                std::map<prempo_key_type, std::pair<int,int> > HermitianPhases;
-                index_map right;
+                // The entries are visited in the order of the right and then of the left key, which
+                // fixes the numbering of the MPO bond
+                auto const& entries = prempo[p].entries();
+                order[p].resize(entries.size());
+                std::iota(order[p].begin(), order[p].end(), 0);
+                std::stable_sort(order[p].begin(), order[p].end(), [&](std::size_t i, std::size_t j) {
+                    return (rank[entries[i].k2] != rank[entries[j].k2]) ? rank[entries[i].k2] < rank[entries[j].k2]
+                                                                        : rank[entries[i].k1] < rank[entries[j].k1];
+                });
                 index_type r = 2;
-                for (typename prempo_map_type::const_iterator it = prempo[p].begin(); it != prempo[p].end(); ++it) {
-                    // Remember that tag_block identifies a tuple with (size, size, tag_type and scaling factor)
-                    // The first two sizes should identify the operators acting on the left and right, respectively,
-                    // the tag_type is the operator and the scaling factor is the coefficient appearing in the definition
-                    // of the Hamiltonian
-                    prempo_key_type const& k1 = it->first.first;
-                    prempo_key_type const& k2 = it->first.second;
-                    prempo_value_type const& val = it->second;
-                    // Looks for the tag inside the left dictionary. Here an error is raised if the operator is not
-                    // found because, at each cycle, the left is filled with the right at the previous iteration
-                    index_iterator ll = left.find(k1);
-                    if (ll == left.end())
-                        throw std::runtime_error("k1 not found!");
-                    // Looks for the tag in the right dictionary. If it has been not found,
-                    // updates the right dictionary
-                    index_iterator rr = right.find(k2);
-                    if (k2 == trivial_left && rr == right.end())
-                        boost::tie(rr, boost::tuples::ignore) = right.insert( make_pair(k2, 0) );
-                    else if (k2 == trivial_right && rr == right.end())
-                        boost::tie(rr, boost::tuples::ignore) = right.insert( make_pair(k2, 1) );
-                    else if (rr == right.end())
-                        boost::tie(rr, boost::tuples::ignore) = right.insert( make_pair(k2, r++) );
-
-                    index_type rr_dim = (p == length-1) ? 0 : rr->second;
-                    pre_tensor.push_back( tag_block(ll->second, rr_dim, val.first, val.second) );
+                for (std::size_t i : order[p]) {
+                    key_id k2 = entries[i].k2;
+                    if (right[p].count(k2) > 0)
+                        continue;
+                    if (k2 == trivial_left_id)
+                        right[p][k2] = 0;
+                    else if (k2 == trivial_right_id)
+                        right[p][k2] = 1;
+                    else
+                        right[p][k2] = r++;
+                    // A conjugate key which is not in the pool cannot label any bond
                     std::pair<int, int> phase;
                     prempo_key_type ck2;
-                    boost::tie(ck2, phase) = conjugate_key(k2, p);
-                    if (!(k2 == ck2)){
-                        HermKeyPairs[k2] = ck2;
-                        HermitianPhases[k2] = phase;
+                    boost::tie(ck2, phase) = conjugate_key(keys[k2], p);
+                    key_id ck2_id = keys.find(ck2);
+                    if (ck2_id != k2 && ck2_id != key_pool_type::npos)
+                        HermKeyPairs[p].push_back(std::make_pair(k2, std::make_pair(ck2_id, phase)));
+                }
+            }
+
+            // -- Blocks of each MPOTensor and hermitian conjugate pairs of the bonds --
+            std::vector<std::vector<tag_block> > pre_tensor(length);
+            std::vector<std::pair<index_type, index_type> > rcd(length);
+            std::vector<std::vector<index_type> > Herm(length+1, std::vector<index_type>(1, 0));
+            std::vector<std::vector<int> > Phase(length+1, std::vector<int>(1, 1));
+            std::vector<index_type> cnt(length, 0);
+            std::vector<char> missing_key(length, 0);
+            bond_table bonds(coefficients ? length : 0);
+#ifdef MAQUIS_OPENMP
+            #pragma omp parallel for schedule(dynamic)
+#endif
+            for (pos_t p = 0; p < length; ++p) {
+                // Remember that tag_block identifies a tuple with (size, size, tag_type and scaling factor)
+                // The first two sizes should identify the operators acting on the left and right, respectively,
+                // the tag_type is the operator and the scaling factor is the coefficient appearing in the definition
+                // of the Hamiltonian
+                index_map const& left = (p == 0) ? first_bond : right[p-1];
+                auto const& entries = prempo[p].entries();
+                pre_tensor[p].reserve(entries.size());
+                if (coefficients)
+                    bonds[p].resize(entries.size());
+                for (std::size_t i : order[p]) {
+                    // The left labels are the right labels of the previous site, an
+                    // error is raised if the operator is not found
+                    index_iterator ll = left.find(entries[i].k1);
+                    if (ll == left.end()) {
+                        missing_key[p] = 1;
+                        break;
                     }
+                    index_type rr_dim = (p == length-1) ? 0 : right[p].find(entries[i].k2)->second;
+                    pre_tensor[p].push_back( tag_block(ll->second, rr_dim, entries[i].value.first, entries[i].value.second) );
+                    if (coefficients)
+                        bonds[p][i] = std::make_pair(ll->second, rr_dim);
                 }
                 // Loads the dimensions of the left and right tags
-                std::pair<index_type, index_type> rcd = rcdim(pre_tensor);
-                // Spin-related part
-                std::vector<spin_desc_t> right_spins(rcd.second);
-                for (typename std::vector<tag_block>::const_iterator it = pre_tensor.begin(); it != pre_tensor.end(); ++it)
-                {
-                    spin_desc_t out_spin = couple(left_spins[boost::tuples::get<0>(*it)],
-                                                  tag_handler->get_op(boost::tuples::get<2>(*it)).spin());
-                    index_type out_index = boost::tuples::get<1>(*it);
-                    assert(right_spins[out_index].get() == 0 || right_spins[out_index].get() == out_spin.get());
-                    right_spins[out_index] = out_spin;
-                }
+                rcd[p] = rcdim(pre_tensor[p]);
                 // Locates the hermitian conjugate pairs
-                std::vector<index_type> RightHerm(rcd.second);
-                std::vector<int> RightPhase(rcd.second, 1);
-                index_type cnt = 0;
+                std::vector<index_type>& RightHerm = Herm[p+1];
+                std::vector<int>& RightPhase = Phase[p+1];
+                RightHerm.resize(rcd[p].second);
+                RightPhase.assign(rcd[p].second, 1);
                 std::iota(RightHerm.begin(), RightHerm.end(), 0);
-                for (typename std::map<prempo_key_type, prempo_key_type>::const_iterator
-                                h_it = HermKeyPairs.begin(); h_it != HermKeyPairs.end(); ++h_it)
+                for (auto const& h_it : HermKeyPairs[p])
                 {
-                    index_type romeo = right[h_it->first];
-                    index_type julia = right[h_it->second];
-                    if (romeo < julia)
+                    index_iterator jj = right[p].find(h_it.second.first);
+                    if (jj == right[p].end())
+                        continue;
+                    index_type romeo = right[p].find(h_it.first)->second;
+                    index_type julia = jj->second;
+                    if (romeo < julia && julia < RightHerm.size())
                     {
-                        cnt++;
+                        cnt[p]++;
                         std::swap(RightHerm[romeo], RightHerm[julia]);
-                        RightPhase[romeo] = HermitianPhases[h_it->first].first;
-                        RightPhase[julia] = HermitianPhases[h_it->first].second;
+                        RightPhase[romeo] = h_it.second.second.first;
+                        RightPhase[julia] = h_it.second.second.second;
                     }
                 }
-                MPOTensor_detail::Hermitian h_(LeftHerm, RightHerm, LeftPhase, RightPhase);
-                // Construction of the MPO tensor 
-                if (p == 0)
-                    mpo.push_back( MPOTensor<Matrix, SymmGroup>(1, rcd.second, pre_tensor,
-                                     tag_handler->get_operator_table(), h_, left_spins, right_spins));
-                else if (p == length - 1)
-                    mpo.push_back( MPOTensor<Matrix, SymmGroup>(rcd.first, 1, pre_tensor,
-                                     tag_handler->get_operator_table(), h_, left_spins, right_spins));
-                else
-                    mpo.push_back( MPOTensor<Matrix, SymmGroup>(rcd.first, rcd.second, pre_tensor,
-                                     tag_handler->get_operator_table(), h_, left_spins, right_spins));
-                swap(left, right);
-                swap(left_spins, right_spins);
-                swap(LeftHerm, RightHerm);
-                swap(LeftPhase, RightPhase);
-                // Final Print
-                if (verbose)
-                    maquis::cout << "MPO Bond " << p << ": " << rcd.second << "/" << cnt << std::endl;
+            }
+            if (std::find(missing_key.begin(), missing_key.end(), 1) != missing_key.end())
+                throw std::runtime_error("k1 not found!");
+            right.clear();
+            order.clear();
+            if (coefficients) {
+                locate_coefficients(*coefficients, bonds);
+                bond_table().swap(bonds);
+            }
+
+            // -- Spin-related part, the only sequential step --
+            std::vector<std::vector<spin_desc_t> > spins(length+1, std::vector<spin_desc_t>(1));
+            for (pos_t p = 0; p < length; ++p) {
+                spins[p+1].resize(rcd[p].second);
+                for (typename std::vector<tag_block>::const_iterator it = pre_tensor[p].begin(); it != pre_tensor[p].end(); ++it)
+                {
+                    spin_desc_t out_spin = couple(spins[p][boost::tuples::get<0>(*it)],
+                                                  tag_handler->get_op(boost::tuples::get<2>(*it)).spin());
+                    index_type out_index = boost::tuples::get<1>(*it);
+                    assert(spins[p+1][out_index].get() == 0 || spins[p+1][out_index].get() == out_spin.get());
+                    spins[p+1][out_index] = out_spin;
+                }
+            }
 
+            // -- Construction of the MPO tensors --
+            MPO<Matrix, SymmGroup> mpo(length);
+#ifdef MAQUIS_OPENMP
+            #pragma omp parallel for schedule(dynamic)
+#endif
+            for (pos_t p = 0; p < length; ++p) {
+                MPOTensor_detail::Hermitian h_(Herm[p], Herm[p+1], Phase[p], Phase[p+1]);
+                index_type row_dim = (p == 0) ? 1 : rcd[p].first;
+                index_type col_dim = (p == length - 1) ? 1 : rcd[p].second;
+                mpo[p] = MPOTensor<Matrix, SymmGroup>(row_dim, col_dim, pre_tensor[p], tag_handler->get_operator_table(),
+                                                      h_, spins[p], spins[p+1]);
+                std::vector<tag_block>().swap(pre_tensor[p]);
             }
+            // Final Print
+            if (verbose)
+                for (pos_t p = 0; p < length; ++p)
+                    maquis::cout << "MPO Bond " << p << ": " << rcd[p].second << "/" << cnt[p] << std::endl;
             mpo.setCoreEnergy(core_energy);
             return mpo;
         }
@@ -338,12 +527,14 @@ namespace generate_mpo
             /// Due to numerical instability: treat the core energy separately
             if (term.operator_tag(0) == identities[lat.get_prop<int>("type", term.position(0))]) {
                 core_energy += std::real(term.coeff);
+                coefficient_entries.push_back(std::make_pair(term.position(0), coefficient_map_type::core_term));
             }
             else {
                 /// retrieve the actual operator from the tag table
                 op_t current_op = tag_handler->get_op(term.operator_tag(0));
                 current_op *= term.coeff;
                 site_terms[term.position(0)] += current_op;
+                coefficient_entries.push_back(std::make_pair(term.position(0), coefficient_map_type::site_term));
             }
         }
 
@@ -376,6 +567,7 @@ namespace generate_mpo
                 mpo_spin = couple(mpo_spin, (tag_handler->get_op(term.operator_tag(i))).spin());
                 prempo_key_type k2;
                 k2.pos_op.push_back(term[i+1]);
+                coefficient_entries.push_back(std::make_pair(term.position(i), prempo[term.position(i)].size()));
                 k1 = insert_operator(term.position(i), make_pair(k1, k2), prempo_value_type(term.operator_tag(i), term.coeff), detach);
                 if (tag_handler->is_fermionic(term.operator_tag(i)))
                   v_nferm[v_part_type[i]] -= 1;
@@ -561,6 +753,7 @@ namespace generate_mpo
                 ops_right.push_back(term[j]);
             k2 = prempo_key_type(ops_right);
             mpo_spin = couple(mpo_spin, (tag_handler->get_op(term.operator_tag(thresh))).spin());
+            coefficient_entries.push_back(std::make_pair(term.position(thresh), prempo[term.position(thresh)].size()));
             k1 = insert_operator(term.position(thresh), make_pair(k1, k2), prempo_value_type(term.operator_tag(thresh), term.coeff), detach);
             // Extract position and then type
             if (tag_handler->is_fermionic(term.operator_tag(thresh)))
@@ -615,6 +808,7 @@ namespace generate_mpo
 
             {
                 int i = 0;
+                coefficient_entries.push_back(std::make_pair(term.position(i), prempo[term.position(i)].size()));
                 insert_operator(term.position(i), make_pair(k1, k2), prempo_value_type(term.operator_tag(i), term.coeff), detach);
                 k1 = k2;
 
@@ -646,20 +840,19 @@ namespace generate_mpo
          */
         void insert_filling(pos_t i, pos_t j, prempo_key_type k, std::vector<bool> trivial_fill, bool isSpinLargerThanOne)
         {
+            key_id k_id = keys.intern(k);
             for (; i < j; ++i) {
                 auto typei = lat.get_prop<int>("type", i);
                 auto particleTypei = lat.get_prop<int>("ParticleType", i);
                 tag_type use_ident = (isSpinLargerThanOne) ? identities_full[typei] : identities[typei];
                 tag_type op = (trivial_fill[particleTypei]) ? use_ident : fillings[typei];
-                //std::pair<typename prempo_map_type::iterator,bool> ret = prempo[i].insert( make_pair(make_pair(k,k), prempo_value_type(op, 1.)) );
-                //if (!ret.second && ret.first->second.first != op)
-                if (prempo[i].count(make_pair(k,k)) == 0) {
-                    auto ret = prempo[i].insert( make_pair(make_pair(k,k), prempo_value_type(op, 1.)) );
+                if (prempo[i].count(k_id, k_id) == 0) {
+                    prempo[i].insert(k_id, k_id, prempo_value_type(op, 1.));
                 }
                 else {
-                    if (prempo[i].find(make_pair(k,k))->second != prempo_value_type(op, 1.))
+                    if (prempo[i].find(k_id, k_id) != prempo_value_type(op, 1.))
                     throw std::runtime_error("Pre-existing term at site "+std::to_string(i)+ ". Needed "+std::to_string(op)
-                                                + ", found "+std::to_string(prempo[i].find(make_pair(k,k))->second.first));
+                                                + ", found "+std::to_string(prempo[i].find(k_id, k_id).first));
                 }
             }
         }
@@ -676,11 +869,12 @@ namespace generate_mpo
         {
             /// merge_behavior == detach: a new branch will be created, in case op already exist, an offset is used
             /// merge_behavior == attach: if operator tags match, keep the same branch
+            key_id k1 = keys.intern(kk.first), k2 = keys.intern(kk.second);
             if (merge_behavior == detach)
-                prempo[p].insert( make_pair(kk, val) );
+                prempo[p].insert(k1, k2, val);
             else
-                if (prempo[p].count(kk) == 0)
-                    prempo[p].insert( make_pair(kk, val) );
+                if (prempo[p].count(k1, k2) == 0)
+                    prempo[p].insert(k1, k2, val);
 
             return kk.second;
         }
@@ -694,28 +888,71 @@ namespace generate_mpo
         void finalize()
         {
             /// site terms
-            std::pair<prempo_key_type,prempo_key_type> kk = make_pair(trivial_left,trivial_right);
+            key_id trivial_left_id = keys.intern(trivial_left), trivial_right_id = keys.intern(trivial_right);
             for (typename std::map<pos_t, op_t>::const_iterator it = site_terms.begin();
                  it != site_terms.end(); ++it) {
                 tag_type site_tag = tag_handler->register_op(it->second, tag_detail::bosonic);
-                //std::pair<typename prempo_map_type::iterator,bool> ret;
-                //ret = prempo[it->first].insert( make_pair( kk, prempo_value_type(site_tag,1.) ) );
-                typename prempo_map_type::iterator ret;
-                ret = prempo[it->first].insert( make_pair( kk, prempo_value_type(site_tag,1.) ) );
-                if (prempo[it->first].count(ret->first) != 1)
+                site_entries[it->first] = prempo[it->first].size();
+                prempo[it->first].insert(trivial_left_id, trivial_right_id, prempo_value_type(site_tag,1.));
+                if (prempo[it->first].count(trivial_left_id, trivial_right_id) != 1)
                     throw std::runtime_error("another site term already existing!");
             }
             // fill with ident from the begin
             for (size_t p = 0; p < rightmost_left; ++p)
-                prempo[p].insert(make_pair(make_pair(trivial_left,trivial_left),
-                                           prempo_value_type(identities[lat.get_prop<int>("type",p)], 1.)));
+                prempo[p].insert(trivial_left_id, trivial_left_id, prempo_value_type(identities[lat.get_prop<int>("type",p)], 1.));
             /// fill with ident until the end
             for (size_t p = leftmost_right+1; p < length; ++p)
-                prempo[p].insert(make_pair(make_pair(trivial_right,trivial_right),
-                                           prempo_value_type(identities[lat.get_prop<int>("type",p)], 1.)));
+                prempo[p].insert(trivial_right_id, trivial_right_id, prempo_value_type(identities[lat.get_prop<int>("type",p)], 1.));
             finalized = true;
         }
 
+        /**
+         * @brief Fills [coefficients] from the entries which carry the coefficients of the terms
+         * @param bonds (left, right) MPO bond indices of each prempo entry
+         */
+        void locate_coefficients(coefficient_map_type & coefficients, bond_table const & bonds) const
+        {
+            typedef std::tuple<pos_t, index_type, index_type, tag_type> slot_key;
+            auto key_of = [&](pos_t p, std::size_t i) {
+                return std::make_tuple(p, bonds[p][i].first, bonds[p][i].second, prempo[p].entries()[i].value.first);
+            };
+            coefficients = coefficient_map_type();
+            // The slots are the distinct MPO elements and tags of the coefficients
+            std::vector<slot_key> slot_keys;
+            for (auto const& ce : coefficient_entries)
+                if (ce.second != coefficient_map_type::site_term && ce.second != coefficient_map_type::core_term)
+                    slot_keys.push_back(key_of(ce.first, ce.second));
+            std::sort(slot_keys.begin(), slot_keys.end());
+            slot_keys.erase(std::unique(slot_keys.begin(), slot_keys.end()), slot_keys.end());
+            std::vector<std::size_t> n_coefficients(slot_keys.size(), 0), n_entries(slot_keys.size(), 0);
+            coefficients.term_slot.reserve(coefficient_entries.size());
+            for (auto const& ce : coefficient_entries) {
+                if (ce.second == coefficient_map_type::site_term || ce.second == coefficient_map_type::core_term) {
+                    coefficients.term_slot.push_back(ce.second);
+                }
+                else {
+                    std::size_t s = std::lower_bound(slot_keys.begin(), slot_keys.end(), key_of(ce.first, ce.second)) - slot_keys.begin();
+                    coefficients.term_slot.push_back(s);
+                    ++n_coefficients[s];
+                }
+            }
+            // A slot shared with entries which are not coefficients cannot be rewritten
+            for (pos_t p = 0; p < length; ++p)
+                for (std::size_t i = 0; i < prempo[p].size(); ++i) {
+                    auto it = std::lower_bound(slot_keys.begin(), slot_keys.end(), key_of(p, i));
+                    if (it != slot_keys.end() && *it == key_of(p, i))
+                        ++n_entries[it - slot_keys.begin()];
+                }
+            coefficients.valid = (n_entries == n_coefficients);
+            coefficients.slots.reserve(slot_keys.size());
+            for (auto const& sk : slot_keys)
+                coefficients.slots.push_back(typename coefficient_map_type::slot{std::get<0>(sk), std::get<1>(sk), std::get<2>(sk), std::get<3>(sk)});
+            for (auto const& se : site_entries)
+                coefficients.site_slots[se.first] = typename coefficient_map_type::slot{se.first, bonds[se.first][se.second].first,
+                                                                                       bonds[se.first][se.second].second,
+                                                                                       prempo[se.first].entries()[se.second].value.first};
+        }
+
         /** @brief Finds the conjugate key of a given entry */
         std::pair<prempo_key_type, std::pair<int, int> > conjugate_key(prempo_key_type k, pos_t p)
         {
@@ -787,9 +1024,13 @@ namespace generate_mpo
         tag_vec identities, identities_full, fillings;
         pos_t length;
         std::shared_ptr<TagHandler<Matrix, SymmGroup> > tag_handler;
+        key_pool_type keys;
         std::vector<prempo_map_type> prempo;
         prempo_key_type trivial_left, trivial_right;
         std::map<pos_t, op_t> site_terms;
+        // Site and prempo entry of the coefficient of each term, see [CoefficientMap], and prempo entry of each site term
+        std::vector<std::pair<pos_t, std::size_t> > coefficient_entries;
+        std::map<pos_t, std::size_t> site_entries;
         pos_t leftmost_right, rightmost_left;
         bool finalized, verbose;
         double core_energy;
@@ -0,0 +1,284 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef MEASUREMENTS_PREFIX_CACHE_H
+#define MEASUREMENTS_PREFIX_CACHE_H
+
+#include <algorithm>
+#include <complex>
+#include <list>
+#include <map>
+#include <numeric>
+#include <vector>
+
+#ifdef MAQUIS_OPENMP
+#include <omp.h>
+#endif
+
+#include "dmrg/mp_tensors/mps.h"
+#include "dmrg/mp_tensors/mpo.h"
+#include "dmrg/mp_tensors/boundary.h"
+#include "dmrg/mp_tensors/contractions.h"
+
+namespace measurements {
+
+    /**
+     * @brief Global settings of the boundary prefix caches used in the RDM measurements.
+     *
+     * [max_memory] is the total memory (in bytes) that the cached boundaries can occupy,
+     * it is split evenly among the OpenMP threads. 0 disables the caching.
+     */
+    class PrefixCacheSettings
+    {
+    public:
+        /** @brief Getter/setter for the memory cap, the default is 0 (no caching) */
+        static std::size_t & max_memory()
+        {
+            static std::size_t current = 0;
+            return current;
+        }
+
+        /** @brief Sets the memory cap from the value (in MB) of the [rdm_cache_memory] parameter */
+        static void set_max_memory(double megabytes)
+        {
+            max_memory() = static_cast<std::size_t>(std::max(megabytes, 0.) * 1024 * 1024);
+        }
+
+        /** @brief Memory cap for the cache of a single thread */
+        static std::size_t max_memory_per_thread()
+        {
+#ifdef MAQUIS_OPENMP
+            return max_memory() / omp_get_max_threads();
+#else
+            return max_memory();
+#endif
+        }
+
+        /**
+         * @brief Permutation that sorts a list of index tuples by their ascending positions.
+         * Evaluating the RDM elements in this order maximizes the length of the common
+         * operator prefixes of consecutive elements.
+         */
+        template<class PositionsList>
+        static std::vector<std::size_t> evaluation_order(PositionsList const & indices)
+        {
+            using positions_type = typename PositionsList::value_type;
+            std::vector<positions_type> sorted(indices.begin(), indices.end());
+            for (auto & positions : sorted)
+                std::sort(positions.begin(), positions.end());
+            std::vector<std::size_t> ret(indices.size());
+            std::iota(ret.begin(), ret.end(), 0);
+            std::stable_sort(ret.begin(), ret.end(), [&sorted](std::size_t i, std::size_t j) { return sorted[i] < sorted[j]; });
+            return ret;
+        }
+    };
+
+    /**
+     * @brief Left step of the overlap contraction <bra|mpo|ket> that leaves the MPSTensors untouched.
+     *
+     * The contraction routines change the pairing of the bra tensor (the ket is copied
+     * internally). The step works on a copy of the bra tensor only, so that the same
+     * MPSs can be read concurrently by all the threads without a copy per thread.
+     */
+    template<class Matrix, class SymmGroup>
+    Boundary<Matrix, SymmGroup> shared_overlap_left_step(MPSTensor<Matrix, SymmGroup> const & bra_tensor,
+                                                         MPSTensor<Matrix, SymmGroup> const & ket_tensor,
+                                                         Boundary<Matrix, SymmGroup> const & left,
+                                                         MPOTensor<Matrix, SymmGroup> const & mpo)
+    {
+        MPSTensor<Matrix, SymmGroup> bra_cpy = bra_tensor;
+        return contraction::Engine<Matrix, Matrix, SymmGroup>::overlap_mpo_left_step(bra_cpy, ket_tensor, left, mpo, false);
+    }
+
+    /**
+     * @brief Cache of left boundaries indexed by the string of MPOTensors contracted so far.
+     *
+     * The MPOs of two RDM elements that share the first operators coincide on all the
+     * sites up to the position of the first operator in which they differ, and so do
+     * the left boundaries obtained by contracting them from the left. Each distinct
+     * MPOTensor is mapped to an integer id, and a boundary is stored with the key
+     * (first site, ids of the contracted tensors). [contract] restarts from the longest
+     * cached prefix of the MPO, so that, if the elements are evaluated in sorted order,
+     * the operator strings are traversed as a trie.
+     *
+     * The scale of the 1x1 MPOTensors (for instance, the coefficient and the fermionic
+     * sign of a product operator) is factored out of the key, so that prefixes differing
+     * only in the overall coefficient are shared as well.
+     *
+     * When the memory occupied by the cached boundaries exceeds the cap, the least
+     * recently used boundaries are dropped. The class is not thread-safe, each thread
+     * should use its own cache.
+     *
+     * @tparam Matrix numeric matrix type.
+     * @tparam SymmGroup symmetry group of the MPS.
+     */
+    template<class Matrix, class SymmGroup>
+    class BoundaryPrefixCache
+    {
+    public:
+        // Types definition
+        using value_type = typename Matrix::value_type;
+        using boundary_type = Boundary<Matrix, SymmGroup>;
+        using mpotensor_type = MPOTensor<Matrix, SymmGroup>;
+        using pos_t = Lattice::pos_t;
+        using key_type = std::vector<std::size_t>;
+
+        /** @brief Constructor from the memory cap (in bytes), 0 disables the caching */
+        explicit BoundaryPrefixCache(std::size_t max_memory = PrefixCacheSettings::max_memory_per_thread())
+            : max_memory_(max_memory), memory_(0), hits_(0), misses_(0) {}
+
+        /**
+         * @brief Copy constructor, the copy is an empty cache with the same memory cap.
+         * This allows to give each thread its own cache with the OpenMP firstprivate clause.
+         */
+        BoundaryPrefixCache(BoundaryPrefixCache const & rhs)
+            : max_memory_(rhs.max_memory_), memory_(0), hits_(0), misses_(0) {}
+
+        BoundaryPrefixCache & operator=(BoundaryPrefixCache const &) = delete;
+
+        /**
+         * @brief Contracts the sites [first, last] of <bra|mpo|ket> starting from the boundary [start].
+         *
+         * [start] must be the left boundary of site [first] of an MPO which is, on the
+         * sites before [first], the same for all the calls to [contract] on this cache.
+         * The returned boundary must be multiplied by [scale].
+         */
+        boundary_type contract(MPS<Matrix, SymmGroup> const & bra, MPS<Matrix, SymmGroup> const & ket,
+                               MPO<Matrix, SymmGroup> const & mpo, pos_t first, pos_t last,
+                               boundary_type const & start, value_type & scale)
+        {
+            assert(first <= last && last < mpo.length());
+            scale = 1.;
+            if (max_memory_ == 0) {
+                boundary_type left = start;
+                for (pos_t p = first; p <= last; ++p)
+                    left = shared_overlap_left_step(bra[p], ket[p], left, mpo[p]);
+                return left;
+            }
+            // Generates the key and the normalized tensors
+            key_type key(1, first);
+            std::vector<mpotensor_type> tensors;
+            tensors.reserve(last-first+1);
+            for (pos_t p = first; p <= last; ++p) {
+                tensors.push_back(mpo[p]);
+                if (mpo[p].row_dim() == 1 && mpo[p].col_dim() == 1 && mpo[p].has(0, 0) && mpo[p].at(0, 0).size() == 1) {
+                    value_type s = mpo[p].at(0, 0).scale();
+                    if (s != value_type(0.) && s != value_type(1.)) {
+                        tensors.back().divide_by_scalar(s);
+                        scale *= s;
+                    }
+                }
+                key.push_back(tensor_id(tensors.back()));
+            }
+            // Restarts from the longest cached prefix
+            boundary_type left = start;
+            std::size_t n_cached = key.size()-1;
+            for (; n_cached > 0; --n_cached) {
+                auto it = cache_.find(key_type(key.begin(), key.begin()+n_cached+1));
+                if (it != cache_.end()) {
+                    lru_.splice(lru_.begin(), lru_, it->second.second);
+                    left = it->second.first;
+                    break;
+                }
+            }
+            if (n_cached > 0)
+                ++hits_;
+            else
+                ++misses_;
+            // The complete string is rarely shared with other elements and is not cached
+            for (std::size_t i = n_cached; i < tensors.size(); ++i) {
+                left = shared_overlap_left_step(bra[first+i], ket[first+i], left, tensors[i]);
+                if (i+1 < tensors.size())
+                    insert(key_type(key.begin(), key.begin()+i+2), left);
+            }
+            return left;
+        }
+
+        /** @brief Memory (in bytes) occupied by the cached boundaries */
+        std::size_t memory() const { return memory_; }
+
+        /** @brief Number of [contract] calls that started from a cached prefix */
+        std::size_t hits() const { return hits_; }
+
+        /** @brief Number of [contract] calls that started from the [start] boundary */
+        std::size_t misses() const { return misses_; }
+
+    private:
+        /** @brief Unique id of an MPOTensor, based on its elements and on its spin indices */
+        std::size_t tensor_id(mpotensor_type const & tensor)
+        {
+            std::vector<double> description = {static_cast<double>(tensor.row_dim()), static_cast<double>(tensor.col_dim())};
+            for (std::size_t b1 = 0; b1 < tensor.row_dim(); ++b1) {
+                for (std::size_t b2 = 0; b2 < tensor.col_dim(); ++b2) {
+                    if (!tensor.has(b1, b2))
+                        continue;
+                    auto access = tensor.at(b1, b2);
+                    for (std::size_t i = 0; i < access.size(); ++i) {
+                        description.push_back(static_cast<double>(b1));
+                        description.push_back(static_cast<double>(b2));
+                        description.push_back(static_cast<double>(tensor.tag_number(b1, b2, i)));
+                        description.push_back(std::real(access.scale(i)));
+                        description.push_back(std::imag(access.scale(i)));
+                    }
+                }
+            }
+            for (auto const & spin : tensor.row_spin_dim()) {
+                description.push_back(spin.get());
+                description.push_back(spin.action());
+            }
+            for (auto const & spin : tensor.col_spin_dim()) {
+                description.push_back(spin.get());
+                description.push_back(spin.action());
+            }
+            return ids_.insert(std::make_pair(description, ids_.size())).first->second;
+        }
+
+        /** @brief Adds a boundary to the cache, dropping the least recently used ones if needed */
+        void insert(key_type const & key, boundary_type const & boundary)
+        {
+            std::size_t size = size_of(boundary);
+            if (size > max_memory_ || cache_.count(key) > 0)
+                return;
+            while (memory_ + size > max_memory_ && !lru_.empty()) {
+                auto it = cache_.find(lru_.back());
+                memory_ -= size_of(it->second.first);
+                cache_.erase(it);
+                lru_.pop_back();
+            }
+            lru_.push_front(key);
+            cache_.insert(std::make_pair(key, std::make_pair(boundary, lru_.begin())));
+            memory_ += size;
+        }
+
+        std::size_t max_memory_, memory_, hits_, misses_;
+        std::map<std::vector<double>, std::size_t> ids_;
+        std::list<key_type> lru_;
+        std::map<key_type, std::pair<boundary_type, typename std::list<key_type>::iterator> > cache_;
+    };
+
+} // namespace measurements
+
+#endif
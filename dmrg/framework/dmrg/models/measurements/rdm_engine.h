@@ -0,0 +1,177 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef MEASUREMENTS_RDM_ENGINE_H
+#define MEASUREMENTS_RDM_ENGINE_H
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "dmrg/mp_tensors/mps.h"
+#include "dmrg/mp_tensors/mpo.h"
+#include "dmrg/mp_tensors/boundary.h"
+#include "dmrg/mp_tensors/contractions.h"
+#include "dmrg/mp_tensors/mps_mpo_detail.h"
+#include "dmrg/models/model.h"
+#include "prefix_cache.h"
+
+namespace measurements {
+
+    /**
+     * @brief Contraction engine for the matrix elements entering the reduced density matrices.
+     *
+     * The MPOs generated by [generate_mpo::sign_and_fill] for a given RDM element
+     * are the identity on all the sites on the left of the first operator and on the
+     * right of the last one. The engine contracts once, at construction, the overlap
+     * boundaries <bra|ket> for each site from the left and from the right. The matrix
+     * element of an operator is then obtained by contracting only the sites on which
+     * the operator acts (and the fillings in between), and by closing the network
+     * with the cached right boundary. For the 2-RDM, this reduces the cost of each
+     * element from L site contractions to the distance between the first and the last
+     * operator.
+     *
+     * The engine is bound to the block structure of the MPSs passed to the
+     * constructor, and works for Abelian symmetry groups only.
+     *
+     * @tparam Matrix numeric matrix type.
+     * @tparam SymmGroup symmetry group of the MPS.
+     */
+    template<class Matrix, class SymmGroup>
+    class RDMEngine
+    {
+    public:
+        // Types definition
+        using value_type = typename Matrix::value_type;
+        using boundary_type = Boundary<Matrix, SymmGroup>;
+        using tag_type = typename OPTable<Matrix, SymmGroup>::tag_type;
+        using pos_t = Lattice::pos_t;
+        using contr = contraction::Engine<Matrix, Matrix, SymmGroup>;
+
+        /**
+         * @brief Constructor, calculates the left and right overlap boundaries.
+         * @param bra bra MPS.
+         * @param ket ket MPS.
+         * @param identities identity operator tags, one per site type.
+         * @param tag_handler tag handler storing the operators.
+         * @param lat lattice.
+         */
+        RDMEngine(MPS<Matrix, SymmGroup> const & bra, MPS<Matrix, SymmGroup> const & ket,
+                  std::vector<tag_type> const & identities,
+                  std::shared_ptr<TagHandler<Matrix, SymmGroup> > tag_handler, Lattice const & lat)
+            : left_(bra.length()+1), right_(bra.length()+1)
+        {
+            assert(bra.length() == ket.length() && bra.length() == lat.size());
+            pos_t L = bra.length();
+            std::vector<MPOTensor<Matrix, SymmGroup> > identity_mpo(L);
+            for (pos_t p = 0; p < L; ++p) {
+                typename MPOTensor<Matrix, SymmGroup>::prempo_t prempo;
+                prempo.push_back(boost::make_tuple(0, 0, identities[lat.get_prop<typename SymmGroup::subcharge>("type", p)], 1.));
+                identity_mpo[p] = MPOTensor<Matrix, SymmGroup>(1, 1, prempo, tag_handler->get_operator_table());
+            }
+            left_[0] = mps_mpo_detail::mixed_left_boundary(bra, ket);
+            for (pos_t p = 0; p < L; ++p)
+                left_[p+1] = contr::overlap_mpo_left_step(bra[p], ket[p], left_[p], identity_mpo[p], false);
+            right_[L] = mps_mpo_detail::mixed_right_boundary(bra, ket);
+            for (pos_t p = L-1; p >= 0; --p)
+                right_[p] = contr::overlap_mpo_right_step(bra[p], ket[p], right_[p+1], identity_mpo[p], false);
+        }
+
+        /** @brief Overlap <bra|ket>, obtained from the cached boundaries without any further contraction */
+        value_type overlap() const
+        {
+            return close(left_[0], right_[0]);
+        }
+
+        /**
+         * @brief Calculates <bra|mpo|ket> for an MPO that is the identity outside [first, last].
+         *
+         * Note that [bra] and [ket] must have the same block structure as the MPSs passed
+         * to the constructor. The MPSs are not modified, so that they can be shared by
+         * all the threads.
+         */
+        value_type expval(MPS<Matrix, SymmGroup> const & bra, MPS<Matrix, SymmGroup> const & ket,
+                          MPO<Matrix, SymmGroup> const & mpo, pos_t first, pos_t last) const
+        {
+            assert(first <= last && last < mpo.length());
+            boundary_type left = shared_overlap_left_step(bra[first], ket[first], left_[first], mpo[first]);
+            for (pos_t p = first+1; p <= last; ++p)
+                left = shared_overlap_left_step(bra[p], ket[p], left, mpo[p]);
+            return close(left, right_[last+1]);
+        }
+
+        /** @brief Same as above, but restarts from the longest operator prefix stored in [cache] */
+        value_type expval(MPS<Matrix, SymmGroup> const & bra, MPS<Matrix, SymmGroup> const & ket,
+                          MPO<Matrix, SymmGroup> const & mpo, pos_t first, pos_t last,
+                          BoundaryPrefixCache<Matrix, SymmGroup> & cache) const
+        {
+            value_type scale;
+            boundary_type left = cache.contract(bra, ket, mpo, first, last, left_[first], scale);
+            return scale * close(left, right_[last+1]);
+        }
+
+        /**
+         * @brief Calculates <bra|mpo|ket> for the MPO generated by [sign_and_fill] from [term]
+         * If [cache] is given, the contraction restarts from the longest cached operator prefix.
+         */
+        value_type expval(MPS<Matrix, SymmGroup> const & bra, MPS<Matrix, SymmGroup> const & ket,
+                          MPO<Matrix, SymmGroup> const & mpo, term_descriptor<value_type> const & term,
+                          BoundaryPrefixCache<Matrix, SymmGroup> * cache = nullptr) const
+        {
+            pos_t first = term.position(0), last = term.position(0);
+            for (std::size_t i = 1; i < term.size(); ++i) {
+                first = std::min(first, term.position(i));
+                last = std::max(last, term.position(i));
+            }
+            return (cache != nullptr) ? expval(bra, ket, mpo, first, last, *cache) : expval(bra, ket, mpo, first, last);
+        }
+
+    private:
+        /** @brief Contracts a left boundary with a right boundary on the same bond */
+        static value_type close(boundary_type const & left, boundary_type const & right)
+        {
+            assert(left.aux_dim() == 1 && right.aux_dim() == 1);
+            value_type ret = 0.;
+            auto const & lhs = left[0];
+            auto const & rhs = right[0];
+            for (std::size_t k = 0; k < lhs.n_blocks(); ++k) {
+                std::size_t k_rhs = rhs.find_block(lhs.basis().left_charge(k), lhs.basis().right_charge(k));
+                if (k_rhs == rhs.n_blocks())
+                    continue;
+                assert(num_rows(lhs[k]) == num_rows(rhs[k_rhs]) && num_cols(lhs[k]) == num_cols(rhs[k_rhs]));
+                for (std::size_t j = 0; j < num_cols(lhs[k]); ++j)
+                    for (std::size_t i = 0; i < num_rows(lhs[k]); ++i)
+                        ret += lhs[k](i, j) * rhs[k_rhs](i, j);
+            }
+            return ret;
+        }
+
+        std::vector<boundary_type> left_, right_;
+    };
+
+} // namespace measurements
+
+#endif
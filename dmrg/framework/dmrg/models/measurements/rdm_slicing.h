@@ -0,0 +1,158 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef MEASUREMENTS_RDM_SLICING_H
+#define MEASUREMENTS_RDM_SLICING_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include "dmrg/utils/archive.h"
+
+namespace measurements {
+
+    /**
+     * @brief Partitioning of the RDM elements among independent processes.
+     *
+     * The list of elements generated by [iterate_nrdm] is split into [n_slices] slices,
+     * and a process evaluates only the elements of slice [slice]. The partitioning is
+     * deterministic, so that each process can generate its own slice without any
+     * communication. Each process writes its results in its own result file (a shard),
+     * and the shards are then assembled with [merge].
+     */
+    class RDMSlicing
+    {
+    public:
+        /** @brief Number of slices, the default is 1 (no slicing) */
+        static int & n_slices()
+        {
+            static int current = 1;
+            return current;
+        }
+
+        /** @brief Index of the slice evaluated by this process */
+        static int & slice()
+        {
+            static int current = 0;
+            return current;
+        }
+
+        /** @brief Sets the slice from the [rdm_slice] and [rdm_slices] parameters */
+        static void set(int slice_index, int slices)
+        {
+            if (slices < 1 || slice_index < 0 || slice_index >= slices)
+                throw std::runtime_error("Invalid RDM slice " + std::to_string(slice_index) + " out of " + std::to_string(slices));
+            slice() = slice_index;
+            n_slices() = slices;
+        }
+
+        /**
+         * @brief Selects the elements of the current slice.
+         *
+         * The slices are contiguous chunks of [order], so that the elements sharing the first
+         * operators end up in the same slice. The chunks are balanced with respect to the
+         * distance between the first and the last operator, which is the number of sites
+         * to be contracted for each element.
+         *
+         * @param indices list of index tuples.
+         * @param order evaluation order of the elements.
+         * @return the entries of [order] belonging to the slice.
+         */
+        template<class PositionsList>
+        static std::vector<std::size_t> select(PositionsList const & indices, std::vector<std::size_t> const & order)
+        {
+            if (n_slices() == 1)
+                return order;
+            std::vector<double> weights(order.size());
+            double total = 0.;
+            for (std::size_t j = 0; j < order.size(); ++j) {
+                auto const & positions = indices[order[j]];
+                auto range = std::minmax_element(positions.begin(), positions.end());
+                weights[j] = static_cast<double>(*range.second - *range.first + 1);
+                total += weights[j];
+            }
+            std::vector<std::size_t> ret;
+            double cumulative = 0.;
+            for (std::size_t j = 0; j < order.size(); ++j) {
+                int owner = std::min(static_cast<int>((cumulative + weights[j]/2.) * n_slices() / total), n_slices()-1);
+                cumulative += weights[j];
+                if (owner == slice())
+                    ret.push_back(order[j]);
+            }
+            return ret;
+        }
+
+        /**
+         * @brief Assembles the results of a measurement stored in the shards into a single result file.
+         * @param shards result files of the slices.
+         * @param result_file final result file, the measurement is added to the existing content.
+         * @param name name of the measurement (e.g. "fourptdm").
+         */
+        template<class T>
+        static void merge(std::vector<std::string> const & shards, std::string const & result_file, std::string const & name)
+        {
+            std::string path = "/spectrum/results/" + storage::encode(name);
+            std::vector<std::vector<T> > values;
+            std::vector<std::string> labels;
+            std::vector<std::vector<int> > labels_num;
+            for (auto const & shard : shards) {
+                if (!boost::filesystem::exists(shard))
+                    throw std::runtime_error("RDM shard " + shard + " does not exist");
+                storage::archive ar(shard);
+                if (!ar.is_data((path + "/mean/value").c_str()))
+                    throw std::runtime_error("RDM shard " + shard + " does not contain the measurement " + name);
+                // An empty slice stores a scalar placeholder and no labels
+                if (!ar.is_data((path + "/labels_num").c_str()))
+                    continue;
+                std::vector<std::vector<T> > shard_values;
+                ar[path + "/mean/value"] >> shard_values;
+                values.resize(std::max(values.size(), shard_values.size()));
+                for (std::size_t e = 0; e < shard_values.size(); ++e)
+                    values[e].insert(values[e].end(), shard_values[e].begin(), shard_values[e].end());
+                if (ar.is_data((path + "/labels").c_str())) {
+                    std::vector<std::string> shard_labels;
+                    ar[path + "/labels"] >> shard_labels;
+                    labels.insert(labels.end(), shard_labels.begin(), shard_labels.end());
+                }
+                std::vector<std::vector<int> > shard_labels_num;
+                ar[path + "/labels_num"] >> shard_labels_num;
+                labels_num.insert(labels_num.end(), shard_labels_num.begin(), shard_labels_num.end());
+            }
+            storage::archive ar(result_file, "w");
+            ar[path + "/mean/value"] << values;
+            if (labels.size() > 0)
+                ar[path + "/labels"] << labels;
+            ar[path + "/labels_num"] << labels_num;
+        }
+    };
+
+} // namespace measurements
+
+#endif
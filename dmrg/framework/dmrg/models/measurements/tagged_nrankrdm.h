@@ -33,6 +33,7 @@
 
 #include <algorithm>
 #include <functional>
+#include <memory>
 #include <boost/iterator/counting_iterator.hpp>
 #include <boost/filesystem.hpp>
 
@@ -43,6 +44,8 @@
 #include "dmrg/models/chem/su2u1/term_maker.h"
 #include "dmrg/models/chem/transform_symmetry.hpp"
 #include "measurements_details.h"
+#include "rdm_engine.h"
+#include "rdm_slicing.h"
 
 namespace measurements {
 
@@ -143,17 +146,39 @@ namespace measurements {
 
             maquis::cout << " measuring in 2u1 version of tagged_nrank " << std::endl;
 
-            if (operator_terms[0].first.size() == 2)
-                measure_correlation(bra_mps, ket_mps);
-            else if (operator_terms[0].first.size() == 4)
-                measure_nrdm<2>(bra_mps, ket_mps);
-            else if (operator_terms[0].first.size() == 6)
-                measure_nrdm<3>(bra_mps, ket_mps);
-            else if (operator_terms[0].first.size() == 8)
-                measure_nrdm<4>(bra_mps, ket_mps);
-            else
-                throw std::runtime_error("correlation measurements at the moment supported with 2, 4, 6 and 8 operators, size is "
-                                          + boost::lexical_cast<std::string>(operator_terms[0].first.size()));
+            measure(bra_mps, ket_mps);
+        }
+
+        /**
+         * @brief Evaluates the transition RDM between two MPSs which are already in memory.
+         *
+         * Same as [evaluate] for a measurement with a bra checkpoint, but the bra is not loaded
+         * from [bra_ckp], so that a caller which keeps the states in memory can evaluate the
+         * same measurement for many pairs of states (each on a clone of the measurement).
+         */
+        void evaluate_transition(MPS<Matrix, SymmGroup> const& bra_mps, MPS<Matrix, SymmGroup> const& ket_mps)
+        {
+            this->vector_results.clear();
+            this->labels.clear();
+            this->labels_num.clear();
+            measure(bra_mps, ket_mps);
+        }
+
+        /**
+         * @brief Same as above, but contracts the elements against the boundaries of [engine].
+         *
+         * [engine] must have been constructed from [bra_mps] and [ket_mps] (or from the ket only,
+         * for an empty bra), with the identities and the tag handler of the model which generated
+         * the measurement. Several measurements on the same pair of states, e.g. the spin components
+         * of a transition RDM, can then share the overlap boundaries.
+         */
+        void evaluate_transition(MPS<Matrix, SymmGroup> const& bra_mps, MPS<Matrix, SymmGroup> const& ket_mps,
+                                 RDMEngine<Matrix, SymmGroup> const& engine)
+        {
+            this->vector_results.clear();
+            this->labels.clear();
+            this->labels_num.clear();
+            measure(bra_mps, ket_mps, &engine);
         }
 
     protected:
@@ -163,14 +188,37 @@ namespace measurements {
             return new TaggedNRankRDM(*this);
         }
 
+        // Dispatches to the measurement of the RDM of the right order, an empty bra stands for the ket.
+        // Without [engine], the overlap boundaries are calculated by the measurement.
+        void measure(MPS<Matrix, SymmGroup> const& bra_mps, MPS<Matrix, SymmGroup> const& ket_mps,
+                     RDMEngine<Matrix, SymmGroup> const* engine = nullptr)
+        {
+            if (operator_terms[0].first.size() == 2)
+                measure_correlation(bra_mps, ket_mps, engine);
+            else if (operator_terms[0].first.size() == 4)
+                measure_nrdm<2>(bra_mps, ket_mps, engine);
+            else if (operator_terms[0].first.size() == 6)
+                measure_nrdm<3>(bra_mps, ket_mps, engine);
+            else if (operator_terms[0].first.size() == 8)
+                measure_nrdm<4>(bra_mps, ket_mps, engine);
+            else
+                throw std::runtime_error("correlation measurements at the moment supported with 2, 4, 6 and 8 operators, size is "
+                                          + boost::lexical_cast<std::string>(operator_terms[0].first.size()));
+        }
+
         void measure_correlation(MPS<Matrix, SymmGroup> const & dummy_bra_mps,
-                                 MPS<Matrix, SymmGroup> const & ket_mps)
+                                 MPS<Matrix, SymmGroup> const & ket_mps,
+                                 RDMEngine<Matrix, SymmGroup> const* shared_engine = nullptr)
         {
             // Test if a separate bra state has been specified
             bool bra_neq_ket = (dummy_bra_mps.length() > 0);
             //MPS<Matrix, SymmGroup> const & bra_mps = (bra_neq_ket) ? dummy_bra_mps : ket_mps;
             MPS<Matrix, SymmGroup> bra_mps = (bra_neq_ket) ? dummy_bra_mps : ket_mps;
             MPS<Matrix, SymmGroup> ket_mps_local = ket_mps;
+            std::unique_ptr<RDMEngine<Matrix, SymmGroup> > local_engine;
+            if (shared_engine == nullptr)
+                local_engine.reset(new RDMEngine<Matrix, SymmGroup>(bra_mps, ket_mps_local, identities, tag_handler, lattice));
+            RDMEngine<Matrix, SymmGroup> const & engine = (shared_engine != nullptr) ? *shared_engine : *local_engine;
 
             #ifdef MAQUIS_OPENMP
             #pragma omp parallel for schedule(dynamic) firstprivate(ket_mps_local, bra_mps)
@@ -199,7 +247,7 @@ namespace measurements {
                         if(measurements_details::checkpg<SymmGroup>()(term, tag_handler_local, lattice))
                         {
                             MPO<Matrix, SymmGroup> mpo = generate_mpo::sign_and_fill(term, identities, fillings, tag_handler_local, lattice);
-                            value += operator_terms[synop].second * expval(bra_mps, ket_mps_local, mpo);
+                            value += operator_terms[synop].second * engine.expval(bra_mps, ket_mps_local, mpo, term);
                         }
 
                     }
@@ -229,44 +277,68 @@ namespace measurements {
 
         // Generic function for measuring all RDMs
         template<int N>
-        void measure_nrdm(const MPS<Matrix, SymmGroup> & dummy_bra_mps, const MPS<Matrix, SymmGroup> & ket_mps)
+        void measure_nrdm(const MPS<Matrix, SymmGroup> & dummy_bra_mps, const MPS<Matrix, SymmGroup> & ket_mps,
+                          RDMEngine<Matrix, SymmGroup> const* shared_engine = nullptr)
         {
             // Test if a separate bra state has been specified bool bra_neq_ket = (dummy_bra_mps.length() > 0);
             bool bra_neq_ket = (dummy_bra_mps.length() > 0);
 
-            //MPS<Matrix, SymmGroup> const & bra_mps = (bra_neq_ket) ? dummy_bra_mps : ket_mps;
-            MPS<Matrix, SymmGroup> bra_mps = (bra_neq_ket) ? dummy_bra_mps : ket_mps;
-            MPS<Matrix, SymmGroup> ket_mps_local = ket_mps;
+            // The MPSs are only read by the contraction engine and are shared by all the threads
+            MPS<Matrix, SymmGroup> const & bra_mps = (bra_neq_ket) ? dummy_bra_mps : ket_mps;
 
             // Obtain the total number of RDM elements and the list of all indices (eventually for a given slice)
             auto indices = measurements_details::iterate_nrdm<N>(lattice.size(), bra_neq_ket, positions_first);
             maquis::cout << "Number of total " << N << "-RDM elements measured: " << indices.size() << std::endl;
 
-            // Prepare result arrays
-            resize_results(indices.size());
+            // Elements sharing the first operators are evaluated one after the other,
+            // so that they can restart from the cached boundaries of the common prefix
+            auto order = RDMSlicing::select(indices, PrefixCacheSettings::evaluation_order(indices));
+            if (RDMSlicing::n_slices() > 1)
+                maquis::cout << "Number of " << N << "-RDM elements in slice " << RDMSlicing::slice() << " of "
+                             << RDMSlicing::n_slices() << ": " << order.size() << std::endl;
+
+            // Prepare result arrays, the results are stored in the order of [indices]
+            resize_results(order.size());
+            std::vector<std::size_t> selection(order), slot(indices.size());
+            std::sort(selection.begin(), selection.end());
+            for (std::size_t k = 0; k < selection.size(); ++k)
+                slot[selection[k]] = k;
+
+            // Overlap boundaries shared by all the elements
+            std::unique_ptr<RDMEngine<Matrix, SymmGroup> > local_engine;
+            if (shared_engine == nullptr)
+                local_engine.reset(new RDMEngine<Matrix, SymmGroup>(bra_mps, ket_mps, identities, tag_handler, lattice));
+            RDMEngine<Matrix, SymmGroup> const & engine = (shared_engine != nullptr) ? *shared_engine : *local_engine;
+            BoundaryPrefixCache<Matrix, SymmGroup> cache;
 
             // Loop over all indices
             #ifdef MAQUIS_OPENMP
-            #pragma omp parallel for schedule(dynamic) firstprivate(bra_mps, ket_mps_local)
+            #pragma omp parallel firstprivate(cache)
             #endif
-
-            for (int i = 0; i < indices.size(); i++)
             {
-                auto&& positions = indices[i];
-
-                // Prepare labels
-                auto&& num_labels = order_labels(lattice, positions);
-                std::string lbt = label_string(num_labels);
-                this->labels[i] = lbt;
-                this->labels_num[i] = num_labels;
-
-                // MPS<Matrix, SymmGroup> ket_mps_local = ket_mps; // enable if you get pairing issues
-                // Make a local copy of tag_handler since it can be modified by the MPO creator
+                // Make a local copy of tag_handler since it can be modified by the MPO creator.
+                // The copy is kept for all the elements of the thread, so that the tags of the
+                // cached prefixes are consistent.
                 std::shared_ptr<TagHandler<Matrix, SymmGroup> > tag_handler_local(new TagHandler<Matrix, SymmGroup>(*tag_handler));
 
-                // Setup MPO and calculate the expectation value for a given indices set
-                this->vector_results[i] = nrdm_expval(N, bra_mps, ket_mps_local, positions, tag_handler_local);
-            } // iterator loop
+                #ifdef MAQUIS_OPENMP
+                #pragma omp for schedule(dynamic)
+                #endif
+                for (int j = 0; j < order.size(); j++)
+                {
+                    std::size_t i = slot[order[j]];
+                    auto&& positions = indices[order[j]];
+
+                    // Prepare labels
+                    auto&& num_labels = order_labels(lattice, positions);
+                    std::string lbt = label_string(num_labels);
+                    this->labels[i] = lbt;
+                    this->labels_num[i] = num_labels;
+
+                    // Setup MPO and calculate the expectation value for a given indices set
+                    this->vector_results[i] = nrdm_expval(N, engine, cache, bra_mps, ket_mps, positions, tag_handler_local);
+                } // iterator loop
+            }
         }
 
     private:
@@ -290,7 +362,8 @@ namespace measurements {
         }
 
         // Obtain an expectation value for <bra|op|ket> for given n-RDM order and positions
-        inline value_type nrdm_expval(std::size_t n, const MPS<Matrix, SymmGroup> & bra_mps, const MPS<Matrix, SymmGroup> & ket_mps,
+        inline value_type nrdm_expval(std::size_t n, const RDMEngine<Matrix, SymmGroup> & engine, BoundaryPrefixCache<Matrix, SymmGroup> & cache,
+                    const MPS<Matrix, SymmGroup> & bra_mps, const MPS<Matrix, SymmGroup> & ket_mps,
                     const std::vector<int> & positions, const std::shared_ptr<TagHandler<Matrix, SymmGroup> > & tag_handler_local)
         {
             assert(operator_terms.size() > 0);
@@ -311,7 +384,7 @@ namespace measurements {
                     return 0.;
 
                 MPO<Matrix, SymmGroup> mpo = generate_mpo::sign_and_fill(term, identities, fillings, tag_handler_local, lattice);
-                result += operator_terms[synop].second * expval(bra_mps, ket_mps, mpo);
+                result += operator_terms[synop].second * engine.expval(bra_mps, ket_mps, mpo, term, &cache);
 
             }// spin combo loop
 
@@ -405,12 +478,15 @@ namespace measurements {
             //MPS<Matrix, SymmGroup> const & bra_mps = (bra_neq_ket) ? dummy_bra_mps : ket_mps;
             MPS<Matrix, SymmGroup> bra_mps = (bra_neq_ket) ? dummy_bra_mps : ket_mps;
             MPS<Matrix, SymmGroup> ket_mps_local = ket_mps;
+            Boundary<Matrix, SymmGroup> left_boundary = mps_mpo_detail::mixed_left_boundary(bra_mps, ket_mps_local);
             #ifdef MAQUIS_OPENMP
             #pragma omp parallel for schedule(dynamic) firstprivate(bra_mps, ket_mps_local)
             #endif
             for (std::size_t i = 0; i < positions_first.size(); ++i) {
                 pos_t p1 = positions_first[i];
                 std::shared_ptr<TagHandler<Matrix, SymmGroup> > tag_handler_local(new TagHandler<Matrix, SymmGroup>(*tag_handler));
+                // The cached prefixes are valid as long as the tags of tag_handler_local are
+                BoundaryPrefixCache<Matrix, SymmGroup> cache;
 
                 std::vector<typename MPS<Matrix, SymmGroup>::scalar_type> dct;
                 std::vector<std::vector<pos_t> > num_labels;
@@ -440,7 +516,7 @@ namespace measurements {
                     generate_mpo::TaggedMPOMaker<Matrix, SymmGroup> mpo_m(lattice, op_collection.ident.no_couple, op_collection.ident_full.no_couple,
                                                                           op_collection.fill.no_couple, tag_handler_local, terms);
                     MPO<Matrix, SymmGroup> mpo = mpo_m.create_mpo();
-                    typename MPS<Matrix, SymmGroup>::scalar_type value = expval(bra_mps, ket_mps_local, mpo);
+                    typename MPS<Matrix, SymmGroup>::scalar_type value = cached_expval(bra_mps, ket_mps_local, mpo, left_boundary, cache);
 
                     dct.push_back(value);
 
@@ -484,40 +560,63 @@ namespace measurements {
             this->labels.resize(indices.size());
             this->vector_results.resize(indices.size());
 
+            // Elements sharing the first operators are evaluated one after the other,
+            // so that they can restart from the cached boundaries of the common prefix
+            auto order = PrefixCacheSettings::evaluation_order(indices);
+            BoundaryPrefixCache<Matrix, SymmGroup> cache;
+            Boundary<Matrix, SymmGroup> left_boundary = mps_mpo_detail::mixed_left_boundary(bra_mps, ket_mps_local);
+
             #ifdef MAQUIS_OPENMP
-            #pragma omp parallel for schedule(dynamic) firstprivate(ket_mps_local, bra_mps)
+            #pragma omp parallel firstprivate(ket_mps_local, bra_mps, cache)
             #endif
-            for (int i = 0; i < indices.size(); i++)
             {
-                auto&& positions = indices[i];
-
+                // The tag_handler copy is kept for all the elements of the thread, so that
+                // the tags of the cached prefixes are consistent
                 std::shared_ptr<TagHandler<Matrix, SymmGroup> > tag_handler_local(new TagHandler<Matrix, SymmGroup>(*tag_handler));
 
-                std::vector<term_descriptor> terms = SpinSumSU2<Matrix, SymmGroup>::V_term(1., positions[0], positions[1], positions[2], positions[3], op_collection, lattice);
+                #ifdef MAQUIS_OPENMP
+                #pragma omp for schedule(dynamic)
+                #endif
+                for (int j = 0; j < indices.size(); j++)
+                {
+                    int i = order[j];
+                    auto&& positions = indices[i];
 
-                // save labels
-                auto&& num_labels = order_labels(lattice, positions);
-                std::string lbt = label_string(num_labels);
-                this->labels[i] = lbt;
-                this->labels_num[i] = num_labels;
+                    std::vector<term_descriptor> terms = SpinSumSU2<Matrix, SymmGroup>::V_term(1., positions[0], positions[1], positions[2], positions[3], op_collection, lattice);
 
-                // check if term is allowed by symmetry
-                if(not measurements_details::checkpg<SymmGroup>()(terms[0], tag_handler_local, lattice))
-                {
-                    this->vector_results[i] = 0.;
-                    continue;
-                }
+                    // save labels
+                    auto&& num_labels = order_labels(lattice, positions);
+                    std::string lbt = label_string(num_labels);
+                    this->labels[i] = lbt;
+                    this->labels_num[i] = num_labels;
 
-                generate_mpo::TaggedMPOMaker<Matrix, SymmGroup> mpo_m(lattice, op_collection.ident.no_couple, op_collection.ident_full.no_couple,
-                                                                        op_collection.fill.no_couple, tag_handler_local, terms);
-                MPO<Matrix, SymmGroup> mpo = mpo_m.create_mpo();
-                typename MPS<Matrix, SymmGroup>::scalar_type value = expval(bra_mps, ket_mps_local, mpo);
+                    // check if term is allowed by symmetry
+                    if(not measurements_details::checkpg<SymmGroup>()(terms[0], tag_handler_local, lattice))
+                    {
+                        this->vector_results[i] = 0.;
+                        continue;
+                    }
 
-                // save results
-                this->vector_results[i] = value;
+                    generate_mpo::TaggedMPOMaker<Matrix, SymmGroup> mpo_m(lattice, op_collection.ident.no_couple, op_collection.ident_full.no_couple,
+                                                                            op_collection.fill.no_couple, tag_handler_local, terms);
+                    MPO<Matrix, SymmGroup> mpo = mpo_m.create_mpo();
+
+                    // save results
+                    this->vector_results[i] = cached_expval(bra_mps, ket_mps_local, mpo, left_boundary, cache);
+                }
             }
         }
 
+        // <bra|mpo|ket>, restarting from the longest MPO prefix stored in the cache
+        value_type cached_expval(MPS<Matrix, SymmGroup> const & bra_mps, MPS<Matrix, SymmGroup> const & ket_mps,
+                                 MPO<Matrix, SymmGroup> const & mpo, Boundary<Matrix, SymmGroup> const & left_boundary,
+                                 BoundaryPrefixCache<Matrix, SymmGroup> & cache)
+        {
+            value_type scale;
+            Boundary<Matrix, SymmGroup> left = cache.contract(bra_mps, ket_mps, mpo, 0, mpo.length()-1, left_boundary, scale);
+            return scale * left.traces()[0] + mpo.getCoreEnergy();
+        }
+
     private:
         Lattice lattice;
         std::shared_ptr<TagHandler<Matrix, SymmGroup> > tag_handler;
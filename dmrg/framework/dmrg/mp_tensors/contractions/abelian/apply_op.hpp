@@ -41,6 +41,46 @@ using ::contraction::ContractionGrid;
 using ::contraction::common::BoundaryMPSProduct;
 using ::contraction::common::MPSBoundaryProduct;
 
+/**
+ * @brief Allocates the blocks of the output of [lbtm_kernel] associated with a given (b1, b2) pair.
+ * @param T_basis block structure of the b1-th element of the BoundaryMPSProduct object.
+ */
+template<class Matrix, class SymmGroup>
+void lbtm_kernel_allocate_term(size_t b1, size_t b2, ContractionGrid<Matrix, SymmGroup>& contr_grid,
+                               DualIndex<SymmGroup> const & T_basis, MPOTensor<Matrix, SymmGroup> const & mpo,
+                               Index<SymmGroup> const & right_i, Index<SymmGroup> const & out_left_i)
+{
+    typedef typename SymmGroup::charge charge;
+    if (T_basis.size() == 0)
+        return;
+    MPOTensor_detail::term_descriptor<Matrix, SymmGroup, true> access = mpo.at(b1,b2);
+    for (size_t oi = 0; oi < access.size(); ++oi)
+    {
+        typename operator_selector<Matrix, SymmGroup>::type const & W = access.op(oi);
+        if(W.n_blocks() == 0)
+            continue;
+        charge operator_delta = SymmGroup::fuse(W.basis().right_charge(0), -W.basis().left_charge(0));
+        charge        T_delta = SymmGroup::fuse(T_basis.right_charge(0), -T_basis.left_charge(0));
+        charge    total_delta = SymmGroup::fuse(operator_delta, -T_delta);
+        block_matrix<Matrix, SymmGroup>& ret = contr_grid(b1,b2);
+        for(size_t r = 0; r < right_i.size(); ++r) {
+            charge out_r_charge = right_i[r].first;
+            charge out_l_charge = SymmGroup::fuse(out_r_charge, total_delta);
+            if(!out_left_i.has(out_l_charge))
+                continue;
+            size_t r_size = right_i[r].second;
+            if(ret.find_block(out_l_charge, out_r_charge) == ret.n_blocks())
+                #ifdef USE_AMBIENT
+                // both versions should be fine for AMBIENT
+                ret.resize_block(ret.insert_block(Matrix(1,1), out_l_charge, out_r_charge),
+                                 out_left_i.size_of_block(out_l_charge), r_size);
+                #else
+                ret.insert_block(Matrix(out_left_i.size_of_block(out_l_charge), r_size), out_l_charge, out_r_charge);
+                #endif
+        }
+    } // oi
+}
+
 template<class Matrix, class OtherMatrix, class SymmGroup>
 void lbtm_kernel_allocate(size_t b2, ContractionGrid<Matrix, SymmGroup>& contr_grid,
                           Boundary<OtherMatrix, SymmGroup> const & left,
@@ -52,44 +92,29 @@ void lbtm_kernel_allocate(size_t b2, ContractionGrid<Matrix, SymmGroup>& contr_g
 {
     typedef typename MPOTensor<Matrix, SymmGroup>::index_type index_type;
     typedef typename MPOTensor<Matrix, SymmGroup>::col_proxy col_proxy;
-    typedef typename SymmGroup::charge charge;
-    typedef std::size_t size_t;
     col_proxy col_b2 = mpo.column(b2);
     for (typename col_proxy::const_iterator col_it = col_b2.begin(); col_it != col_b2.end(); ++col_it) {
         index_type b1 = col_it.index();
         DualIndex<SymmGroup> T_basis = detail::T_basis_left(left, left_mult_mps, mpo, ket_basis, bra_basis, b1, isHermitian);
-        if (T_basis.size() == 0)
-            continue;
-        MPOTensor_detail::term_descriptor<Matrix, SymmGroup, true> access = mpo.at(b1,b2);
-        for (size_t oi = 0; oi < access.size(); ++oi)
-        {
-            typename operator_selector<Matrix, SymmGroup>::type const & W = access.op(oi);
-            if(W.n_blocks() == 0)
-                continue;
-            charge operator_delta = SymmGroup::fuse(W.basis().right_charge(0), -W.basis().left_charge(0));
-            charge        T_delta = SymmGroup::fuse(T_basis.right_charge(0), -T_basis.left_charge(0));
-            charge    total_delta = SymmGroup::fuse(operator_delta, -T_delta);
-            block_matrix<Matrix, SymmGroup>& ret = contr_grid(b1,b2);
-            for(size_t r = 0; r < right_i.size(); ++r) {
-                charge out_r_charge = right_i[r].first;
-                charge out_l_charge = SymmGroup::fuse(out_r_charge, total_delta);
-                if(!out_left_i.has(out_l_charge))
-                    continue;
-                size_t r_size = right_i[r].second;
-                if(ret.find_block(out_l_charge, out_r_charge) == ret.n_blocks())
-                    #ifdef USE_AMBIENT
-                    // both versions should be fine for AMBIENT
-                    ret.resize_block(ret.insert_block(Matrix(1,1), out_l_charge, out_r_charge),
-                                     out_left_i.size_of_block(out_l_charge), r_size);
-                    #else
-                    ret.insert_block(Matrix(out_left_i.size_of_block(out_l_charge), r_size), out_l_charge, out_r_charge);
-                    #endif
-            }
-        } // oi
+        lbtm_kernel_allocate_term(b1, b2, contr_grid, T_basis, mpo, right_i, out_left_i);
     } // b1
     contr_grid.index_sizes(b2);
 }
 
+/** @brief Same as above, but takes the block structure of the BoundaryMPSProduct from a [ContractionPlan] */
+template<class Matrix, class SymmGroup>
+void lbtm_kernel_allocate(size_t b2, ContractionGrid<Matrix, SymmGroup>& contr_grid,
+                          std::vector<DualIndex<SymmGroup> > const & T_bases,
+                          MPOTensor<Matrix, SymmGroup> const & mpo,
+                          Index<SymmGroup> const & right_i, Index<SymmGroup> const & out_left_i)
+{
+    typedef typename MPOTensor<Matrix, SymmGroup>::col_proxy col_proxy;
+    col_proxy col_b2 = mpo.column(b2);
+    for (typename col_proxy::const_iterator col_it = col_b2.begin(); col_it != col_b2.end(); ++col_it)
+        lbtm_kernel_allocate_term(col_it.index(), b2, contr_grid, T_bases[col_it.index()], mpo, right_i, out_left_i);
+    contr_grid.index_sizes(b2);
+}
+
 // SK: New version which generates same output but uses right-paired input.
 //     The charge delta optimization is indepent from the changes needed to
 //     skip the preceding reshapes.
@@ -284,6 +309,18 @@ void lbtm_kernel(size_t b2, ContractionGrid<Matrix, SymmGroup>& contr_grid,
     lbtm_kernel_execute(b2, contr_grid, left, left_mult_mps, mpo, ket_basis, right_i, out_left_i, in_right_pb, out_left_pb);
 }
 
+template<class Matrix, class OtherMatrix, class SymmGroup>
+void lbtm_kernel(size_t b2, ContractionGrid<Matrix, SymmGroup>& contr_grid,
+                 Boundary<OtherMatrix, SymmGroup> const & left,
+                 BoundaryMPSProduct<Matrix, OtherMatrix, SymmGroup, Gemms> const & left_mult_mps,
+                 MPOTensor<Matrix, SymmGroup> const & mpo,
+                 ::contraction::common::ContractionPlan<Matrix, SymmGroup> const & plan)
+{
+    lbtm_kernel_allocate(b2, contr_grid, plan.T_bases, mpo, plan.right_i_trim, plan.out_left_i);
+    lbtm_kernel_execute(b2, contr_grid, left, left_mult_mps, mpo, plan.ket_basis_right, plan.right_i_trim, plan.out_left_i,
+                        plan.in_right_pb, plan.out_left_pb);
+}
+
 template<class Matrix, class OtherMatrix, class SymmGroup>
 void rbtm_kernel(size_t b1, block_matrix<Matrix, SymmGroup> & ret,
                  Boundary<OtherMatrix, SymmGroup> const & right,
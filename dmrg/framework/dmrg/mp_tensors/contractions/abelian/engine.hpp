@@ -36,6 +36,7 @@
 #include "dmrg/mp_tensors/contractions/common/common.h"
 #include "dmrg/mp_tensors/contractions/abelian/apply_op.hpp"
 #include "dmrg/mp_tensors/contractions/abelian/functors.hpp"
+#include "dmrg/mp_tensors/contractions/abelian/h_diag.hpp"
 
 namespace contraction {
 
@@ -212,6 +213,31 @@ namespace contraction {
                     MPOTensor<Matrix, SymmGroup> const & mpo,
                     bool isHermitian=true);
 
+        /**
+         * @brief Site Hamiltonian application based on a precomputed [ContractionPlan].
+         * The block structure of the boundary-MPS products is stored in the plan at the first call.
+         */
+        static MPSTensor<Matrix, SymmGroup>
+        site_hamil2(MPSTensor<Matrix, SymmGroup> ket_tensor,
+                    Boundary<OtherMatrix, SymmGroup> const & left,
+                    Boundary<OtherMatrix, SymmGroup> const & right,
+                    MPOTensor<Matrix, SymmGroup> const & mpo,
+                    common::ContractionPlan<Matrix, SymmGroup> & plan,
+                    bool isHermitian=true);
+        /**
+         * @brief Applies the site Hamiltonian to a batch of tensors.
+         *
+         * If the tensors share their block structure, they are joined along the right index
+         * (see [common::KetBatch]), so that the boundary-MPS products and the MPO contraction
+         * are carried out once for all the tensors, with n times larger matrices.
+         */
+        static std::vector<MPSTensor<Matrix, SymmGroup> >
+        site_hamil2(std::vector<MPSTensor<Matrix, SymmGroup> > const & ket_tensors,
+                    Boundary<OtherMatrix, SymmGroup> const & left,
+                    Boundary<OtherMatrix, SymmGroup> const & right,
+                    MPOTensor<Matrix, SymmGroup> const & mpo,
+                    bool isHermitian=true);
+
         // Zero-site Hamiltonian
         static block_matrix<Matrix, SymmGroup>
         zerosite_hamil2(block_matrix<Matrix, SymmGroup> ket_tensor, Boundary<OtherMatrix, SymmGroup> const & left,
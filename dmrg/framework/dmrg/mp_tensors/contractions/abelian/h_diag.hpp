@@ -0,0 +1,157 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef CONTRACTIONS_ABELIAN_H_DIAG_HPP
+#define CONTRACTIONS_ABELIAN_H_DIAG_HPP
+
+#include <alps/numeric/conj.hpp>
+
+#include "dmrg/block_matrix/block_matrix.h"
+#include "dmrg/mp_tensors/mpstensor.h"
+#include "dmrg/mp_tensors/mpotensor.h"
+
+namespace contraction {
+namespace abelian {
+
+    /**
+     * @brief Diagonal of the block (c, c) of a boundary.
+     *
+     * If the boundary is not stored because of the hermitian structure of the MPO,
+     * the diagonal is taken from its conjugate partner. Returns an empty vector
+     * if the block is not present.
+     */
+    template<class OtherMatrix, class SymmGroup>
+    std::vector<typename OtherMatrix::value_type>
+    boundary_diagonal(Boundary<OtherMatrix, SymmGroup> const & boundary, std::size_t b, bool skip, std::size_t b_conj,
+                      typename SymmGroup::charge c)
+    {
+        using alps::numeric::conj;
+        block_matrix<OtherMatrix, SymmGroup> const & bm = boundary[skip ? b_conj : b];
+        std::vector<typename OtherMatrix::value_type> ret;
+        std::size_t k = bm.find_block(c, c);
+        if (k == bm.n_blocks())
+            return ret;
+        ret.assign(bm[k].diagonal().first, bm[k].diagonal().second);
+        if (skip)
+            for (auto & v : ret)
+                v = conj(v);
+        return ret;
+    }
+
+    /**
+     * @brief Diagonal of the site Hamiltonian for Abelian symmetry groups.
+     *
+     * The element (sigma l, r) of the left-paired result is the sum over b1, b2 of
+     * W_{b1,b2}(sigma, sigma) L_{b1}(l, l) R_{b2}(r, r), so that only the diagonals of the
+     * boundaries and of the local operators enter. The result has the same block
+     * structure as the left-paired [x].
+     */
+    template<class Matrix, class OtherMatrix, class SymmGroup>
+    block_matrix<Matrix, SymmGroup>
+    diagonal_hamiltonian(Boundary<OtherMatrix, SymmGroup> const & left,
+                         Boundary<OtherMatrix, SymmGroup> const & right,
+                         MPOTensor<Matrix, SymmGroup> const & mpo,
+                         MPSTensor<Matrix, SymmGroup> const & x,
+                         bool isHermitian = true)
+    {
+        typedef typename SymmGroup::charge charge;
+        typedef typename Matrix::value_type value_type;
+        typedef typename MPOTensor<Matrix, SymmGroup>::index_type index_type;
+        typedef typename MPOTensor<Matrix, SymmGroup>::col_proxy col_proxy;
+
+        Index<SymmGroup> const & physical_i = x.site_dim();
+        Index<SymmGroup> const & left_i = x.row_dim();
+        ProductBasis<SymmGroup> out_left_pb(physical_i, left_i);
+
+        MPSTensor<Matrix, SymmGroup> x_cpy = x;
+        x_cpy.make_left_paired();
+        block_matrix<Matrix, SymmGroup> ret = x_cpy.data();
+        for (std::size_t k = 0; k < ret.n_blocks(); ++k)
+            std::fill(elements(ret[k]).first, elements(ret[k]).second, value_type(0.));
+
+        // Each thread fills whole blocks of the result
+#ifdef MAQUIS_OPENMP
+        #pragma omp parallel for schedule(dynamic)
+#endif
+        for (std::size_t k = 0; k < ret.n_blocks(); ++k)
+        {
+            charge in_charge = ret.basis().right_charge(k);
+            for (index_type b2 = 0; b2 < mpo.col_dim(); ++b2)
+            {
+                bool right_skip = mpo.herm_info.right_skip(b2) && isHermitian;
+                index_type b2_conj = right_skip ? mpo.herm_info.right_conj(b2) : b2;
+                col_proxy col_b2 = mpo.column(b2);
+                std::vector<value_type> right_diagonal = boundary_diagonal(right, b2, right_skip, b2_conj, in_charge);
+                if (right_diagonal.empty())
+                    continue;
+                for (typename col_proxy::const_iterator col_it = col_b2.begin(); col_it != col_b2.end(); ++col_it)
+                {
+                    index_type b1 = col_it.index();
+                    bool left_skip = mpo.herm_info.left_skip(b1) && isHermitian;
+                    index_type b1_conj = left_skip ? mpo.herm_info.left_conj(b1) : b1;
+                    MPOTensor_detail::term_descriptor<Matrix, SymmGroup, true> access = mpo.at(b1, b2);
+                    for (std::size_t s = 0; s < physical_i.size(); ++s)
+                    {
+                        charge phys_charge = physical_i[s].first;
+                        std::size_t l = left_i.position(SymmGroup::fuse(in_charge, -phys_charge));
+                        if (l == left_i.size())
+                            continue;
+                        charge lc = left_i[l].first;
+                        std::vector<value_type> left_diagonal = boundary_diagonal(left, b1, left_skip, b1_conj, lc);
+                        if (left_diagonal.empty())
+                            continue;
+                        std::size_t left_offset = out_left_pb(phys_charge, lc);
+                        for (std::size_t op_index = 0; op_index < access.size(); ++op_index)
+                        {
+                            typename operator_selector<Matrix, SymmGroup>::type const & W = access.op(op_index);
+                            std::size_t w_block = W.find_block(phys_charge, phys_charge);
+                            if (w_block == W.n_blocks())
+                                continue;
+                            for (std::size_t ss = 0; ss < physical_i[s].second; ++ss)
+                            {
+                                value_type w = access.scale(op_index) * W[w_block](ss, ss);
+                                if (w == value_type(0.))
+                                    continue;
+                                for (std::size_t c = 0; c < right_diagonal.size(); ++c)
+                                {
+                                    value_type wr = w * right_diagonal[c];
+                                    value_type * out = &ret[k](left_offset + ss * left_diagonal.size(), c);
+                                    for (std::size_t i = 0; i < left_diagonal.size(); ++i)
+                                        out[i] += wr * left_diagonal[i];
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        return ret;
+    }
+
+} // namespace abelian
+} // namespace contraction
+
+#endif
@@ -60,7 +60,7 @@ site_hamil2(MPSTensor<Matrix, SymmGroup> ket_tensor, MPSTensor<Matrix, SymmGroup
     Index<SymmGroup> right_i = ket_tensor.col_dim(),
                      out_left_i = physical_i * left_i;
     Index<SymmGroup> right_i_bra = bra_tensor.col_dim();
-    common_subset(out_left_i, right_i);
+    common_subset(out_left_i, right_i_bra);
     ProductBasis<SymmGroup> out_left_pb(physical_i, left_i);
     ProductBasis<SymmGroup> in_right_pb(physical_i, right_i,
                             boost::lambda::bind(static_cast<charge(*)(charge, charge)>(SymmGroup::fuse),
@@ -92,6 +92,7 @@ site_hamil2(MPSTensor<Matrix, SymmGroup> ket_tensor, MPSTensor<Matrix, SymmGroup
         swap(ret.data(), contr_grid.reduce());
         parallel::sync();
 #else
+    common::BlockReducer<Matrix, SymmGroup> reducer(ret.data());
     omp_for(index_type b2, parallel::range<std::size_t>(0,loop_max), {
         ContractionGrid<Matrix, SymmGroup> contr_grid(mpo, 0, 0);
         abelian::lbtm_kernel(b2, contr_grid, left, t, mpo, ket_tensor.data().basis(), bra_tensor.data().basis(), right_i, out_left_i, in_right_pb, out_left_pb,
@@ -102,14 +103,99 @@ site_hamil2(MPSTensor<Matrix, SymmGroup> ket_tensor, MPSTensor<Matrix, SymmGroup
         else
             gemm(contr_grid(0,0), right[b2], tmp);
         contr_grid(0,0).clear();
-        parallel_critical
-        for (std::size_t k = 0; k < tmp.n_blocks(); ++k)
-            ret.data().match_and_add_block(tmp[k], tmp.basis().left_charge(k), tmp.basis().right_charge(k));
+        reducer.add(tmp);
     });
+    reducer.finalize();
 #endif
     return ret;
 }
 
+template<class Matrix, class OtherMatrix, class SymmGroup, class SymmType>
+MPSTensor<Matrix, SymmGroup>
+Engine<Matrix, OtherMatrix, SymmGroup, SymmType>::
+site_hamil2(MPSTensor<Matrix, SymmGroup> ket_tensor,
+            Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
+            MPOTensor<Matrix, SymmGroup> const & mpo, common::ContractionPlan<Matrix, SymmGroup> & plan,
+            bool isHermitian)
+{
+    using index_type = std::size_t;
+    contraction::common::BoundaryMPSProduct<Matrix, OtherMatrix, SymmGroup, abelian::Gemms> t(ket_tensor, left, mpo, plan.left_trim_basis_rp, isHermitian);
+    // The block structure of the boundary-MPS product does not depend on the numerical values of the ket
+    if (!plan.has_T_bases()) {
+        std::vector<DualIndex<SymmGroup> > T_bases(left.aux_dim());
+        omp_for(index_type b1, parallel::range<index_type>(0,left.aux_dim()), {
+            T_bases[b1] = abelian::detail::T_basis_left(left, t, mpo, plan.ket_basis_right, plan.ket_basis_right, b1, isHermitian);
+        });
+        swap(plan.T_bases, T_bases);
+    }
+    MPSTensor<Matrix, SymmGroup> ret;
+    ret.phys_i = plan.physical_i;
+    ret.left_i = plan.left_i;
+    ret.right_i = plan.right_i;
+    auto loop_max = mpo.col_dim();
+    common::BlockReducer<Matrix, SymmGroup> reducer(ret.data(), plan.ket_basis_left);
+    omp_for(index_type b2, parallel::range<std::size_t>(0,loop_max), {
+        ContractionGrid<Matrix, SymmGroup> contr_grid(mpo, 0, 0);
+        abelian::lbtm_kernel(b2, contr_grid, left, t, mpo, plan);
+        block_matrix<Matrix, SymmGroup> tmp;
+        if (mpo.herm_info.right_skip(b2) && isHermitian)
+            gemm(contr_grid(0,0), adjoint(right[mpo.herm_info.right_conj(b2)]), tmp);
+        else
+            gemm(contr_grid(0,0), right[b2], tmp);
+        contr_grid(0,0).clear();
+        reducer.add(tmp);
+    });
+    reducer.finalize();
+    return ret;
+}
+
+template<class Matrix, class OtherMatrix, class SymmGroup, class SymmType>
+std::vector<MPSTensor<Matrix, SymmGroup> >
+Engine<Matrix, OtherMatrix, SymmGroup, SymmType>::
+site_hamil2(std::vector<MPSTensor<Matrix, SymmGroup> > const & ket_tensors,
+            Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
+            MPOTensor<Matrix, SymmGroup> const & mpo, bool isHermitian)
+{
+    using index_type = std::size_t;
+    // Tensors with different block structures cannot be joined
+    if (ket_tensors.size() < 2 || !common::KetBatch<Matrix, SymmGroup>::compatible(ket_tensors)) {
+        std::vector<MPSTensor<Matrix, SymmGroup> > ret;
+        ret.reserve(ket_tensors.size());
+        for (std::size_t k = 0; k < ket_tensors.size(); ++k)
+            ret.push_back(site_hamil2(ket_tensors[k], left, right, mpo, isHermitian));
+        return ret;
+    }
+    common::KetBatch<Matrix, SymmGroup> batch(ket_tensors);
+    MPSTensor<Matrix, SymmGroup> const & joined = batch.joined();
+    common::ContractionPlan<Matrix, SymmGroup> plan(joined);
+    // Left part of the contraction, carried out once for all the tensors of the batch
+    contraction::common::BoundaryMPSProduct<Matrix, OtherMatrix, SymmGroup, abelian::Gemms> t(joined, left, mpo, plan.left_trim_basis_rp, isHermitian);
+    std::vector<DualIndex<SymmGroup> > T_bases(left.aux_dim());
+    omp_for(index_type b1, parallel::range<index_type>(0,left.aux_dim()), {
+        T_bases[b1] = abelian::detail::T_basis_left(left, t, mpo, plan.ket_basis_right, plan.ket_basis_right, b1, isHermitian);
+    });
+    swap(plan.T_bases, T_bases);
+    // The right boundary acts on each tensor separately: the slices of the tensors are stacked
+    // on top of each other, so that each term is still a single product
+    block_matrix<Matrix, SymmGroup> stacked_ret;
+    auto loop_max = mpo.col_dim();
+    common::BlockReducer<Matrix, SymmGroup> reducer(stacked_ret);
+    omp_for(index_type b2, parallel::range<std::size_t>(0,loop_max), {
+        ContractionGrid<Matrix, SymmGroup> contr_grid(mpo, 0, 0);
+        abelian::lbtm_kernel(b2, contr_grid, left, t, mpo, plan);
+        block_matrix<Matrix, SymmGroup> stacked = batch.stack(contr_grid(0,0));
+        contr_grid(0,0).clear();
+        block_matrix<Matrix, SymmGroup> tmp;
+        if (mpo.herm_info.right_skip(b2) && isHermitian)
+            gemm(stacked, adjoint(right[mpo.herm_info.right_conj(b2)]), tmp);
+        else
+            gemm(stacked, right[b2], tmp);
+        reducer.add(tmp);
+    });
+    reducer.finalize();
+    return batch.split(stacked_ret, ket_tensors[0].col_dim());
+}
+
 } // namespace contraction
 
 #endif
@@ -0,0 +1,198 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef ENGINE_COMMON_BLOCK_REDUCTION_H
+#define ENGINE_COMMON_BLOCK_REDUCTION_H
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef MAQUIS_OPENMP
+#include <omp.h>
+#endif
+
+#include "dmrg/block_matrix/block_matrix.h"
+#include "dmrg/utils/parallel/loops.hpp"
+#include "dmrg/utils/parallel/range.hpp"
+
+namespace contraction {
+    namespace common {
+
+    /**
+     * @brief Global selector of the reduction strategy used in [site_hamil2].
+     *
+     * With [Critical] each thread adds its contribution to the output tensor inside
+     * an OpenMP critical section. With [ThreadLocal] each thread accumulates in a
+     * private buffer, and the buffers are summed up with a pairwise tree reduction
+     * at the end of the loop. The latter avoids the serialization of the
+     * accumulation for large thread counts, at the price of one copy of the
+     * output tensor per thread.
+     */
+    class SiteHamilReduction
+    {
+    public:
+        enum Mode { Critical, ThreadLocal };
+
+        /** @brief Getter/setter for the mode, the default is [Critical] */
+        static Mode & mode()
+        {
+            static Mode current = Critical;
+            return current;
+        }
+
+        /** @brief Sets the mode from the value of the [site_hamil_reduction] parameter */
+        static void set_mode(std::string const & name)
+        {
+            if (name == "critical")
+                mode() = Critical;
+            else if (name == "threadlocal")
+                mode() = ThreadLocal;
+            else
+                throw std::runtime_error("site_hamil_reduction = " + name + " not recognized, use critical or threadlocal");
+        }
+    };
+
+    /**
+     * @brief Accumulates block_matrix contributions coming from an OpenMP loop.
+     *
+     * [add] can be called concurrently by the threads of the loop, [finalize] must
+     * be called once, outside of the parallel region, before the target is used.
+     * If a layout is given, the thread-local buffers are allocated from it upon the
+     * first contribution of each thread, so that the accumulation does not need
+     * to insert new blocks.
+     */
+    template<class Matrix, class SymmGroup>
+    class BlockReducer
+    {
+    public:
+        using block_matrix_type = block_matrix<Matrix, SymmGroup>;
+
+        /** @brief Constructor from the target matrix, without preallocated layout */
+        explicit BlockReducer(block_matrix_type & target, SiteHamilReduction::Mode mode = SiteHamilReduction::mode())
+            : target_(target), mode_(mode)
+        {
+            init_buffers();
+        }
+
+        /** @brief Constructor from the target matrix and the expected block layout of the result */
+        BlockReducer(block_matrix_type & target, DualIndex<SymmGroup> const & layout,
+                     SiteHamilReduction::Mode mode = SiteHamilReduction::mode())
+            : target_(target), mode_(mode), layout_(layout)
+        {
+            init_buffers();
+        }
+
+        /** @brief Adds a contribution to the result */
+        void add(block_matrix_type const & contribution)
+        {
+            std::size_t thread = thread_id();
+            if (mode_ == SiteHamilReduction::ThreadLocal && thread < buffers_.size()) {
+                if (!allocated_[thread]) {
+                    if (layout_.size() > 0)
+                        buffers_[thread] = block_matrix_type(layout_);
+                    allocated_[thread] = 1;
+                }
+                accumulate(buffers_[thread], contribution);
+            }
+            else {
+                parallel_critical
+                accumulate(target_, contribution);
+            }
+        }
+
+        /** @brief Sums up the thread-local buffers into the target matrix */
+        void finalize()
+        {
+            std::size_t n_buffers = buffers_.size();
+            for (std::size_t stride = 1; stride < n_buffers; stride *= 2) {
+                std::size_t n_pairs = (n_buffers + 2*stride - 1) / (2*stride);
+                omp_for(std::size_t i, parallel::range<std::size_t>(0, n_pairs), {
+                    std::size_t lhs = 2*stride*i, rhs = lhs + stride;
+                    if (rhs < n_buffers && allocated_[rhs]) {
+                        if (allocated_[lhs])
+                            accumulate(buffers_[lhs], buffers_[rhs]);
+                        else
+                            swap(buffers_[lhs], buffers_[rhs]);
+                        allocated_[lhs] = 1;
+                        buffers_[rhs].clear();
+                    }
+                });
+            }
+            if (n_buffers > 0 && allocated_[0]) {
+                if (target_.n_blocks() == 0)
+                    swap(target_, buffers_[0]);
+                else
+                    accumulate(target_, buffers_[0]);
+            }
+            buffers_.clear();
+            allocated_.clear();
+        }
+
+    private:
+        void init_buffers()
+        {
+            if (mode_ == SiteHamilReduction::ThreadLocal) {
+                buffers_.resize(max_threads());
+                allocated_.resize(buffers_.size(), 0);
+            }
+        }
+
+        static void accumulate(block_matrix_type & lhs, block_matrix_type const & rhs)
+        {
+            for (std::size_t k = 0; k < rhs.n_blocks(); ++k)
+                lhs.match_and_add_block(rhs[k], rhs.basis().left_charge(k), rhs.basis().right_charge(k));
+        }
+
+        static std::size_t thread_id()
+        {
+#ifdef MAQUIS_OPENMP
+            return omp_get_thread_num();
+#else
+            return 0;
+#endif
+        }
+
+        static std::size_t max_threads()
+        {
+#ifdef MAQUIS_OPENMP
+            return omp_get_max_threads();
+#else
+            return 1;
+#endif
+        }
+
+        block_matrix_type & target_;
+        SiteHamilReduction::Mode mode_;
+        DualIndex<SymmGroup> layout_;
+        std::vector<block_matrix_type> buffers_;
+        std::vector<char> allocated_;
+    };
+
+    } // namespace common
+} // namespace contraction
+
+#endif
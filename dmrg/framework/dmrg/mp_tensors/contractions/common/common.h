@@ -28,7 +28,10 @@
 #ifndef ENGINE_COMMON_H
 #define ENGINE_COMMON_H
 
+#include "dmrg/mp_tensors/contractions/common/block_reduction.hpp"
 #include "dmrg/mp_tensors/contractions/common/boundary_times_mps.hpp"
+#include "dmrg/mp_tensors/contractions/common/contraction_plan.hpp"
+#include "dmrg/mp_tensors/contractions/common/ket_batch.hpp"
 #include "dmrg/mp_tensors/contractions/common/move_boundary.hpp"
 #include "dmrg/mp_tensors/contractions/common/prediction.hpp"
 
@@ -0,0 +1,123 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef ENGINE_COMMON_CONTRACTION_PLAN_H
+#define ENGINE_COMMON_CONTRACTION_PLAN_H
+
+#include <boost/lambda/lambda.hpp>
+#include <boost/lambda/bind.hpp>
+
+#include "dmrg/mp_tensors/mpstensor.h"
+#include "dmrg/block_matrix/indexing.h"
+
+namespace contraction {
+    namespace common {
+
+    /**
+     * @brief Symbolic data of a site Hamiltonian application.
+     *
+     * During an eigensolver call the tensor on which the site Hamiltonian is applied
+     * changes its numerical values, but not its block structure. This class stores
+     * all the quantities that depend only on the block structure (indices, product
+     * bases, trimming references, transposed bases, and the block structure of the
+     * boundary-MPS products), so that they are computed once per [SiteProblem]
+     * and each matrix-vector product only runs the numerical kernels.
+     *
+     * Note that the plan is bound to the boundaries and to the MPOTensor used
+     * the first time it is passed to [site_hamil2], and assumes that the bra and the
+     * ket share the same block structure.
+     *
+     * @tparam Matrix numeric matrix underlying the MPSTensor.
+     * @tparam SymmGroup symmetry group of the Hamiltonian.
+     */
+    template<class Matrix, class SymmGroup>
+    class ContractionPlan
+    {
+    public:
+        // Types definition
+        using charge = typename SymmGroup::charge;
+
+        /** @brief Constructor from the MPSTensor whose block structure is cached */
+        explicit ContractionPlan(MPSTensor<Matrix, SymmGroup> const & ket)
+            : physical_i(ket.site_dim()), left_i(ket.row_dim()), right_i(ket.col_dim()),
+              out_left_pb(physical_i, left_i), in_left_pb(physical_i, left_i),
+              in_right_pb(physical_i, right_i, boost::lambda::bind(static_cast<charge(*)(charge, charge)>(SymmGroup::fuse),
+                                                                   -boost::lambda::_1, boost::lambda::_2)),
+              out_right_pb(physical_i, right_i, boost::lambda::bind(static_cast<charge(*)(charge, charge)>(SymmGroup::fuse),
+                                                                    -boost::lambda::_1, boost::lambda::_2))
+        {
+            // Note that [common_subset] trims both its arguments
+            out_left_i = physical_i * left_i;
+            right_i_trim = right_i;
+            common_subset(out_left_i, right_i_trim);
+            out_right_i = adjoin(physical_i) * right_i;
+            Index<SymmGroup> left_i_trim = left_i;
+            common_subset(out_right_i, left_i_trim);
+            // Bases of the ket
+            ket.make_left_paired();
+            ket_basis_left = ket.data().basis();
+            left_trim_basis_lp = ket.data().left_basis();
+            ket.make_right_paired();
+            ket_basis_right = ket.data().basis();
+            left_trim_basis_rp = ket.data().left_basis();
+            ket_basis_right_transpose = ket_basis_right;
+            for (std::size_t i = 0; i < ket_basis_right_transpose.size(); ++i) {
+                std::swap(ket_basis_right_transpose[i].lc, ket_basis_right_transpose[i].rc);
+                std::swap(ket_basis_right_transpose[i].ls, ket_basis_right_transpose[i].rs);
+            }
+        }
+
+        /**
+         * @brief Checks whether the plan can be used for a given tensor.
+         * Note that this leaves the tensor in right-paired form.
+         */
+        bool matches(MPSTensor<Matrix, SymmGroup> const & ket) const
+        {
+            if (!(ket.site_dim() == physical_i && ket.row_dim() == left_i && ket.col_dim() == right_i))
+                return false;
+            ket.make_right_paired();
+            return ket.data().basis() == ket_basis_right;
+        }
+
+        /** @brief true if the block structure of the boundary-MPS products has already been cached */
+        bool has_T_bases() const { return !T_bases.empty(); }
+
+        // Indices of the input/output tensors
+        Index<SymmGroup> physical_i, left_i, right_i, right_i_trim, out_left_i, out_right_i;
+        // Product bases used by the left- and right-based kernels
+        ProductBasis<SymmGroup> out_left_pb, in_left_pb, in_right_pb, out_right_pb;
+        // Bases of the ket in left- and right-paired form
+        DualIndex<SymmGroup> ket_basis_left, ket_basis_right, ket_basis_right_transpose;
+        // Reference bases for the trimming of the boundary-MPS products
+        Index<SymmGroup> left_trim_basis_lp, left_trim_basis_rp;
+        // Block structure of the boundary-MPS products, one entry per auxiliary index
+        std::vector<DualIndex<SymmGroup> > T_bases;
+    };
+
+    } // namespace common
+} // namespace contraction
+
+#endif
@@ -0,0 +1,166 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef ENGINE_COMMON_KET_BATCH_H
+#define ENGINE_COMMON_KET_BATCH_H
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "dmrg/mp_tensors/mpstensor.h"
+#include "dmrg/block_matrix/block_matrix.h"
+
+namespace contraction {
+    namespace common {
+
+    /**
+     * @brief Batch of MPSTensors sharing the same block structure.
+     *
+     * The tensors are joined along the right index: within each symmetry block of the
+     * left-paired representation, the columns of the n tensors are stored one after
+     * the other, so that the right index of the joined tensor has n times the size of
+     * the original one. All the operations acting on the left and on the physical index
+     * can then be applied to the joined tensor, with matrices n times larger.
+     *
+     * Operations acting on the right index instead see the n tensors side by side
+     * and must be applied to each of them. [stack] reorders the columns of a left-paired
+     * block_matrix on top of each other, so that such an operation becomes a single
+     * product with n times more rows, and [split] recovers the individual results.
+     */
+    template<class Matrix, class SymmGroup>
+    class KetBatch
+    {
+    public:
+        using block_matrix_type = block_matrix<Matrix, SymmGroup>;
+        using tensor_type = MPSTensor<Matrix, SymmGroup>;
+
+        /** @brief Constructor from the tensors to be joined, which must share their block structure */
+        explicit KetBatch(std::vector<tensor_type> const & tensors)
+            : n_(tensors.size())
+        {
+            if (n_ == 0)
+                throw std::runtime_error("Empty batch of MPSTensors");
+            physical_i_ = tensors[0].site_dim();
+            left_i_ = tensors[0].row_dim();
+            right_i_ = tensors[0].col_dim();
+            for (std::size_t r = 0; r < right_i_.size(); ++r)
+                wide_right_i_.insert(std::make_pair(right_i_[r].first, n_*right_i_[r].second));
+            tensors[0].make_left_paired();
+            DualIndex<SymmGroup> const & basis = tensors[0].data().basis();
+            block_matrix_type joined_data;
+            std::vector<std::size_t> position(basis.size());
+            for (std::size_t b = 0; b < basis.size(); ++b)
+                position[b] = joined_data.insert_block(Matrix(basis.left_size(b), n_*basis.right_size(b)),
+                                                       basis.left_charge(b), basis.right_charge(b));
+            for (std::size_t k = 0; k < n_; ++k) {
+                tensors[k].make_left_paired();
+                block_matrix_type const & data = tensors[k].data();
+                if (!(data.basis() == basis))
+                    throw std::runtime_error("The MPSTensors of a batch must share their block structure");
+                for (std::size_t b = 0; b < basis.size(); ++b) {
+                    std::size_t cols = num_cols(data[b]);
+                    for (std::size_t j = 0; j < cols; ++j)
+                        std::copy(data[b].col(j).first, data[b].col(j).second, joined_data[position[b]].col(k*cols + j).first);
+                }
+            }
+            joined_ = tensor_type(physical_i_, left_i_, wide_right_i_, joined_data, LeftPaired);
+        }
+
+        /** @brief Checks whether [tensors] share their block structure and can be joined */
+        static bool compatible(std::vector<tensor_type> const & tensors)
+        {
+            for (std::size_t k = 1; k < tensors.size(); ++k) {
+                if (!(tensors[k].site_dim() == tensors[0].site_dim() && tensors[k].row_dim() == tensors[0].row_dim()
+                      && tensors[k].col_dim() == tensors[0].col_dim()))
+                    return false;
+                tensors[0].make_left_paired();
+                tensors[k].make_left_paired();
+                if (!(tensors[k].data().basis() == tensors[0].data().basis()))
+                    return false;
+            }
+            return true;
+        }
+
+        /** @brief Number of tensors in the batch */
+        std::size_t size() const { return n_; }
+
+        /** @brief The joined tensor, whose right index is n times larger than the original one */
+        tensor_type const & joined() const { return joined_; }
+
+        /**
+         * @brief Moves the column slices of the n tensors of each block of [m] on top of each other.
+         *
+         * The column j of the k-th tensor of a (r x n*c) block becomes the column j of the rows
+         * [k*r, (k+1)*r) of the resulting (n*r x c) block.
+         */
+        block_matrix_type stack(block_matrix_type const & m) const
+        {
+            block_matrix_type ret;
+            for (std::size_t b = 0; b < m.n_blocks(); ++b) {
+                std::size_t rows = num_rows(m[b]), cols = num_cols(m[b]) / n_;
+                assert( cols * n_ == num_cols(m[b]) );
+                std::size_t o = ret.insert_block(Matrix(n_*rows, cols), m.basis().left_charge(b), m.basis().right_charge(b));
+                for (std::size_t k = 0; k < n_; ++k)
+                    for (std::size_t j = 0; j < cols; ++j)
+                        std::copy(m[b].col(k*cols + j).first, m[b].col(k*cols + j).second, ret[o].col(j).first + k*rows);
+            }
+            return ret;
+        }
+
+        /**
+         * @brief Splits a stacked, left-paired block_matrix into the n tensors of the batch.
+         * @param right_i right index of the resulting tensors.
+         */
+        std::vector<tensor_type> split(block_matrix_type const & m, Index<SymmGroup> const & right_i) const
+        {
+            std::vector<block_matrix_type> data(n_);
+            for (std::size_t b = 0; b < m.n_blocks(); ++b) {
+                std::size_t rows = num_rows(m[b]) / n_, cols = num_cols(m[b]);
+                assert( rows * n_ == num_rows(m[b]) );
+                for (std::size_t k = 0; k < n_; ++k) {
+                    std::size_t o = data[k].insert_block(Matrix(rows, cols), m.basis().left_charge(b), m.basis().right_charge(b));
+                    for (std::size_t j = 0; j < cols; ++j)
+                        std::copy(m[b].col(j).first + k*rows, m[b].col(j).first + (k+1)*rows, data[k][o].col(j).first);
+                }
+            }
+            std::vector<tensor_type> ret;
+            ret.reserve(n_);
+            for (std::size_t k = 0; k < n_; ++k)
+                ret.push_back(tensor_type(physical_i_, left_i_, right_i, data[k], LeftPaired));
+            return ret;
+        }
+
+    private:
+        std::size_t n_;
+        Index<SymmGroup> physical_i_, left_i_, right_i_, wide_right_i_;
+        tensor_type joined_;
+    };
+
+    } // namespace common
+} // namespace contraction
+
+#endif
@@ -208,6 +208,24 @@ namespace contraction {
                     MPOTensor<Matrix, SymmGroup> const & mpo,
                     bool isHermitian=true);
 
+        /** @brief Site Hamiltonian application based on a precomputed [ContractionPlan] */
+        static MPSTensor<Matrix, SymmGroup>
+        site_hamil2(MPSTensor<Matrix, SymmGroup> ket_tensor,
+                    Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
+                    MPOTensor<Matrix, SymmGroup> const & mpo, common::ContractionPlan<Matrix, SymmGroup> & plan,
+                    bool isHermitian=true);
+
+        /**
+         * @brief Applies the site Hamiltonian to a batch of tensors.
+         * The tensors are processed one after the other, sharing a single [ContractionPlan] if they
+         * have the same block structure.
+         */
+        static std::vector<MPSTensor<Matrix, SymmGroup> >
+        site_hamil2(std::vector<MPSTensor<Matrix, SymmGroup> > const & ket_tensors,
+                    Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
+                    MPOTensor<Matrix, SymmGroup> const & mpo,
+                    bool isHermitian=true);
+
         static block_matrix<Matrix, SymmGroup>
         zerosite_hamil2(block_matrix<Matrix, SymmGroup> bra_tensor, block_matrix<Matrix, SymmGroup> ket_tensor, 
                         Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
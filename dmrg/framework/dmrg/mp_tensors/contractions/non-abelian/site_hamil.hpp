@@ -43,6 +43,25 @@ site_hamil_rbtm(MPSTensor<Matrix, SymmGroup> ket_tensor, MPSTensor<Matrix, SymmG
                 Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
                 MPOTensor<Matrix, SymmGroup> const & mpo, bool isHermitian);
 
+template<class Matrix, class OtherMatrix, class SymmGroup>
+void
+site_hamil_lbtm_execute(common::BoundaryMPSProduct<Matrix, OtherMatrix, SymmGroup, ::SU2::SU2Gemms> const & t,
+                        Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
+                        MPOTensor<Matrix, SymmGroup> const & mpo, DualIndex<SymmGroup> const & ket_basis_transpose,
+                        Index<SymmGroup> const & physical_i, Index<SymmGroup> const & left_i,
+                        Index<SymmGroup> const & right_i, Index<SymmGroup> const & out_left_i,
+                        ProductBasis<SymmGroup> const & in_right_pb, ProductBasis<SymmGroup> const & out_left_pb,
+                        block_matrix<Matrix, SymmGroup> & ret, bool isHermitian);
+
+template<class Matrix, class OtherMatrix, class SymmGroup>
+void
+site_hamil_rbtm_execute(common::MPSBoundaryProduct<Matrix, OtherMatrix, SymmGroup, ::SU2::SU2Gemms> const & t,
+                        Boundary<OtherMatrix, SymmGroup> const & left, MPOTensor<Matrix, SymmGroup> const & mpo,
+                        DualIndex<SymmGroup> const & ket_basis, Index<SymmGroup> const & left_i,
+                        Index<SymmGroup> const & out_right_i,
+                        ProductBasis<SymmGroup> const & in_left_pb, ProductBasis<SymmGroup> const & out_right_pb,
+                        block_matrix<Matrix, SymmGroup> & collector, bool isHermitian);
+
 // *************************************************************
 
 template<class Matrix, class OtherMatrix, class SymmGroup>
@@ -71,6 +90,55 @@ site_hamil2(MPSTensor<Matrix, SymmGroup> ket_tensor, MPSTensor<Matrix, SymmGroup
         return site_hamil_rbtm(ket_tensor, bra_tensor, left, right, mpo, isHermitian);
 }
 
+template<class Matrix, class OtherMatrix, class SymmGroup>
+MPSTensor<Matrix, SymmGroup>
+Engine<Matrix, OtherMatrix, SymmGroup, symm_traits::enable_if_su2_t<SymmGroup>>::
+site_hamil2(MPSTensor<Matrix, SymmGroup> ket_tensor,
+            Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
+            MPOTensor<Matrix, SymmGroup> const & mpo, common::ContractionPlan<Matrix, SymmGroup> & plan,
+            bool isHermitian)
+{
+    MPSTensor<Matrix, SymmGroup> ret;
+    ret.phys_i  = plan.physical_i;
+    ret.left_i  = plan.left_i;
+    ret.right_i = plan.right_i;
+    if ( (mpo.row_dim() - mpo.num_one_rows()) < (mpo.col_dim() - mpo.num_one_cols()) ) {
+        common::BoundaryMPSProduct<Matrix, OtherMatrix, SymmGroup, ::SU2::SU2Gemms> t(ket_tensor, left, mpo, plan.left_trim_basis_rp, isHermitian);
+        site_hamil_lbtm_execute(t, left, right, mpo, plan.ket_basis_right_transpose, plan.physical_i, plan.left_i, plan.right_i,
+                                plan.out_left_i, plan.in_right_pb, plan.out_left_pb, ret.data(), isHermitian);
+    }
+    else {
+        common::MPSBoundaryProduct<Matrix, OtherMatrix, SymmGroup, ::SU2::SU2Gemms> t(ket_tensor, right, mpo, plan.left_trim_basis_lp, isHermitian);
+        block_matrix<Matrix, SymmGroup> collector;
+        site_hamil_rbtm_execute(t, left, mpo, plan.ket_basis_left, plan.left_i, plan.out_right_i,
+                                plan.in_left_pb, plan.out_right_pb, collector, isHermitian);
+        reshape_right_to_left_new(plan.physical_i, plan.left_i, plan.right_i, collector, ret.data());
+    }
+    return ret;
+}
+
+template<class Matrix, class OtherMatrix, class SymmGroup>
+std::vector<MPSTensor<Matrix, SymmGroup> >
+Engine<Matrix, OtherMatrix, SymmGroup, symm_traits::enable_if_su2_t<SymmGroup>>::
+site_hamil2(std::vector<MPSTensor<Matrix, SymmGroup> > const & ket_tensors,
+            Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
+            MPOTensor<Matrix, SymmGroup> const & mpo, bool isHermitian)
+{
+    std::vector<MPSTensor<Matrix, SymmGroup> > ret;
+    if (ket_tensors.empty())
+        return ret;
+    ret.reserve(ket_tensors.size());
+    if (!common::KetBatch<Matrix, SymmGroup>::compatible(ket_tensors)) {
+        for (std::size_t k = 0; k < ket_tensors.size(); ++k)
+            ret.push_back(site_hamil2(ket_tensors[k], left, right, mpo, isHermitian));
+        return ret;
+    }
+    common::ContractionPlan<Matrix, SymmGroup> plan(ket_tensors[0]);
+    for (std::size_t k = 0; k < ket_tensors.size(); ++k)
+        ret.push_back(site_hamil2(ket_tensors[k], left, right, mpo, plan, isHermitian));
+    return ret;
+}
+
 // *************************************************************
 // specialized variants
 
@@ -132,6 +200,26 @@ site_hamil_lbtm(MPSTensor<Matrix, SymmGroup> ket_tensor, MPSTensor<Matrix, SymmG
         parallel::sync();
 
 #else
+    site_hamil_lbtm_execute(t, left, right, mpo, ket_basis_transpose, physical_i, left_i, right_i, out_left_i,
+                            in_right_pb, out_left_pb, ret.data(), isHermitian);
+#endif
+    return ret;
+}
+
+template<class Matrix, class OtherMatrix, class SymmGroup>
+void
+site_hamil_lbtm_execute(common::BoundaryMPSProduct<Matrix, OtherMatrix, SymmGroup, ::SU2::SU2Gemms> const & t,
+                        Boundary<OtherMatrix, SymmGroup> const & left, Boundary<OtherMatrix, SymmGroup> const & right,
+                        MPOTensor<Matrix, SymmGroup> const & mpo, DualIndex<SymmGroup> const & ket_basis_transpose,
+                        Index<SymmGroup> const & physical_i, Index<SymmGroup> const & left_i,
+                        Index<SymmGroup> const & right_i, Index<SymmGroup> const & out_left_i,
+                        ProductBasis<SymmGroup> const & in_right_pb, ProductBasis<SymmGroup> const & out_left_pb,
+                        block_matrix<Matrix, SymmGroup> & ret, bool isHermitian)
+{
+    typedef typename MPOTensor<Matrix, SymmGroup>::index_type index_type;
+    typedef typename Matrix::value_type value_type;
+    index_type loop_max = mpo.col_dim();
+    common::BlockReducer<Matrix, SymmGroup> reducer(ret);
     omp_for(index_type b2, parallel::range<index_type>(0,loop_max), {
         ContractionGrid<Matrix, SymmGroup> contr_grid(mpo, 0, 0);
         block_matrix<Matrix, SymmGroup> tmp, tmp2;
@@ -158,12 +246,9 @@ site_hamil_lbtm(MPSTensor<Matrix, SymmGroup> ket_tensor, MPSTensor<Matrix, SymmG
                 if (!out_left_i.has(tmp.basis().left_charge(k)))
                     tmp.remove_block(k--);
         }
-        parallel_critical
-        for (std::size_t k = 0; k < tmp.n_blocks(); ++k)
-            ret.data().match_and_add_block(tmp[k], tmp.basis().left_charge(k), tmp.basis().right_charge(k));
+        reducer.add(tmp);
     });
-#endif
-    return ret;
+    reducer.finalize();
 }
 
 template<class Matrix, class OtherMatrix, class SymmGroup>
@@ -194,17 +279,37 @@ site_hamil_rbtm(MPSTensor<Matrix, SymmGroup> ket_tensor, MPSTensor<Matrix, SymmG
     ret.phys_i = bra_tensor.site_dim();
     ret.left_i = bra_tensor.row_dim();
     ret.right_i = bra_tensor.col_dim();
+    site_hamil_rbtm_execute(t, left, mpo, ket_tensor.data().basis(), left_i, out_right_i, in_left_pb, out_right_pb,
+                            collector, isHermitian);
+    reshape_right_to_left_new(physical_i, left_i, right_i, collector, ret.data());
+    DualIndex<SymmGroup> kb2 = ket_tensor.data().basis();
+    if (!(kb1 == kb2))
+        throw std::runtime_error("XX\n");
+    return ret;
+}
+
+template<class Matrix, class OtherMatrix, class SymmGroup>
+void
+site_hamil_rbtm_execute(common::MPSBoundaryProduct<Matrix, OtherMatrix, SymmGroup, ::SU2::SU2Gemms> const & t,
+                        Boundary<OtherMatrix, SymmGroup> const & left, MPOTensor<Matrix, SymmGroup> const & mpo,
+                        DualIndex<SymmGroup> const & ket_basis, Index<SymmGroup> const & left_i,
+                        Index<SymmGroup> const & out_right_i,
+                        ProductBasis<SymmGroup> const & in_left_pb, ProductBasis<SymmGroup> const & out_right_pb,
+                        block_matrix<Matrix, SymmGroup> & collector, bool isHermitian)
+{
+    typedef typename MPOTensor<Matrix, SymmGroup>::index_type index_type;
     index_type loop_max = mpo.row_dim();
+    common::BlockReducer<Matrix, SymmGroup> reducer(collector);
     omp_for(index_type b1, parallel::range<index_type>(0,loop_max), {
         block_matrix<Matrix, SymmGroup> tmp, tmp2;
         SU2::task_capsule<Matrix, SymmGroup> tasks_cap;
-        SU2::rbtm_tasks(b1, t, mpo, ket_tensor.data().basis(), left_i, out_right_i, in_left_pb, out_right_pb, tasks_cap);
+        SU2::rbtm_tasks(b1, t, mpo, ket_basis, left_i, out_right_i, in_left_pb, out_right_pb, tasks_cap);
         if (mpo.herm_info.left_skip(b1) && isHermitian)
             SU2::rbtm_axpy_gemm(b1, tasks_cap, tmp2, out_right_i, left, mpo, conjugate(left[mpo.herm_info.left_conj(b1)]), t);
         else
             SU2::rbtm_axpy_gemm(b1, tasks_cap, tmp2, out_right_i, left, mpo, transpose(left[b1]), t);
         t.free(b1);
-        //SU2::rbtm_kernel(b1, tmp, left, t, mpo, ket_tensor.data().basis(), left_i, out_right_i, in_left_pb, out_right_pb);
+        //SU2::rbtm_kernel(b1, tmp, left, t, mpo, ket_basis, left_i, out_right_i, in_left_pb, out_right_pb);
         //if (mpo.herm_info.left_skip(b1)) {
         //    std::vector<value_type> phases = ::contraction::common::conjugate_phases(left[mpo.herm_info.left_conj(b1)], mpo, b1, true, false);
         //    ::SU2::gemm_trim(left[mpo.herm_info.left_conj(b1)], tmp, tmp2, phases, true);
@@ -212,15 +317,9 @@ site_hamil_rbtm(MPSTensor<Matrix, SymmGroup> ket_tensor, MPSTensor<Matrix, SymmG
         //else
         //    ::SU2::gemm_trim(transpose(left[b1]), tmp, tmp2, std::vector<value_type>(tmp.n_blocks(), 1.), false);
         //tmp.clear();
-        parallel_critical
-        for (std::size_t k = 0; k < tmp2.n_blocks(); ++k)
-            collector.match_and_add_block(tmp2[k], tmp2.basis().left_charge(k), tmp2.basis().right_charge(k));
+        reducer.add(tmp2);
     });
-    reshape_right_to_left_new(physical_i, left_i, right_i, collector, ret.data());
-    DualIndex<SymmGroup> kb2 = ket_tensor.data().basis();
-    if (!(kb1 == kb2))
-        throw std::runtime_error("XX\n");
-    return ret;
+    reducer.finalize();
 }
 
 } // namespace contraction
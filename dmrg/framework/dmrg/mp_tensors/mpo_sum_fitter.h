@@ -0,0 +1,218 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef MP_TENSORS_MPO_SUM_FITTER_H
+#define MP_TENSORS_MPO_SUM_FITTER_H
+
+#include <algorithm>
+#include <vector>
+
+#include "dmrg/mp_tensors/mps.h"
+#include "dmrg/mp_tensors/mpo.h"
+#include "dmrg/mp_tensors/twositetensor.h"
+#include "dmrg/mp_tensors/ts_ops.h"
+#include "dmrg/mp_tensors/mps_mpo_detail.h"
+#include "dmrg/mp_tensors/mps_join.h"
+#include "dmrg/mp_tensors/mps_sectors.h"
+#include "dmrg/mp_tensors/contractions.h"
+
+/**
+ * @brief Variational fit of a sum of MPO applications, |fit> = sum_k O_k |mps_k>.
+ *
+ * Each term keeps its own environments <fit|O_k|mps_k>, whose auxiliary dimension is
+ * the bond dimension of O_k, so that the MPS with the joined bond dimension of all the
+ * products is never formed. The fit is optimized with two-site updates: the SVD of the
+ * two-site target bounds the bond dimension of the fit by [Mmax] and lets its symmetry
+ * sectors adapt to the ones of the target.
+ * A sweep goes from left to right and back, and leaves the norm of the fit on the first site.
+ * The two-site updates cannot create symmetry sectors which are missing on the outer bonds
+ * of the guess, see [enriched_guess].
+ */
+template<class Matrix, class SymmGroup>
+class mpo_sum_fitter
+{
+    typedef contraction::Engine<Matrix, Matrix, SymmGroup> contr;
+    typedef Boundary<Matrix, SymmGroup> boundary_type;
+
+public:
+    /**
+     * @brief Class constructor
+     * @param mpos_ operators of the terms, [mpos_[k]] acts on [mps_[k]]
+     * @param mps_ states of the terms
+     * @param guess initial guess, which defines the initial symmetry sectors of the fit
+     * @param Mmax_ maximum bond dimension of the fit
+     * @param cutoff_ truncation threshold of the two-site SVDs
+     */
+    mpo_sum_fitter(std::vector<MPO<Matrix, SymmGroup> > const & mpos_,
+                   std::vector<MPS<Matrix, SymmGroup> > const & mps_,
+                   MPS<Matrix, SymmGroup> const & guess,
+                   std::size_t Mmax_, double cutoff_)
+    : mpos(mpos_)
+    , mps(mps_)
+    , fit(guess)
+    , Mmax(Mmax_)
+    , cutoff(cutoff_)
+    {
+        assert(mpos.size() == mps.size());
+        assert(fit.length() > 1);
+        fit.canonize(0);
+        init_left_right();
+    }
+
+    /** @brief One sweep from left to right and back, returns the largest truncated weight */
+    double sweep()
+    {
+        std::size_t L = fit.length();
+        double truncated_weight = 0.;
+
+        // The last bond turns the sweep around
+        for (std::size_t p = 0; p < L-1; ++p) {
+            bool turn = (p == L-2);
+            TwoSiteTensor<Matrix, SymmGroup> tst(fit[p], fit[p+1]);
+            tst << target(p, tst.make_mps());
+            boost::tuple<MPSTensor<Matrix, SymmGroup>, MPSTensor<Matrix, SymmGroup>, truncation_results> res
+                = turn ? tst.split_mps_r2l(Mmax, cutoff) : tst.split_mps_l2r(Mmax, cutoff);
+            fit[p] = boost::get<0>(res);
+            fit[p+1] = boost::get<1>(res);
+            truncated_weight = std::max(truncated_weight, boost::get<2>(res).truncated_weight);
+            if (turn)
+                update_right(p+1);
+            else
+                update_left(p);
+        }
+
+        for (int p = static_cast<int>(L)-3; p >= 0; --p) {
+            TwoSiteTensor<Matrix, SymmGroup> tst(fit[p], fit[p+1]);
+            tst << target(p, tst.make_mps());
+            boost::tuple<MPSTensor<Matrix, SymmGroup>, MPSTensor<Matrix, SymmGroup>, truncation_results> res
+                = tst.split_mps_r2l(Mmax, cutoff);
+            fit[p] = boost::get<0>(res);
+            fit[p+1] = boost::get<1>(res);
+            truncated_weight = std::max(truncated_weight, boost::get<2>(res).truncated_weight);
+            update_right(p+1);
+        }
+
+        return truncated_weight;
+    }
+
+    /**
+     * @brief Sweeps until the norm of the fit, which grows towards the one of the target,
+     * changes by less than [tol] (relative), returns the number of sweeps
+     */
+    std::size_t converge(double tol, std::size_t max_sweeps)
+    {
+        double previous = 0.;
+        for (std::size_t n = 1; ; ++n) {
+            sweep();
+            double current = fit[0].scalar_norm();
+            if (std::abs(current - previous) <= tol*current || n == max_sweeps)
+                return n;
+            previous = current;
+        }
+    }
+
+    MPS<Matrix, SymmGroup> const & get_current_mps() const { return fit; }
+
+private:
+    /** @brief Two-site tensor of the target on sites (p, p+1), expressed in the basis of the fit [bra] */
+    MPSTensor<Matrix, SymmGroup> target(std::size_t p, MPSTensor<Matrix, SymmGroup> const & bra) const
+    {
+        MPSTensor<Matrix, SymmGroup> ret;
+        for (std::size_t k = 0; k < mpos.size(); ++k) {
+            MPSTensor<Matrix, SymmGroup> ket = TwoSiteTensor<Matrix, SymmGroup>(mps[k][p], mps[k][p+1]).make_mps();
+            MPOTensor<Matrix, SymmGroup> ts_mpo = make_twosite_mpo<Matrix, Matrix>(mpos[k][p], mpos[k][p+1],
+                                                                                   mps[k][p].site_dim(), mps[k][p+1].site_dim());
+            MPSTensor<Matrix, SymmGroup> term = contr::site_hamil2(ket, bra, left_[k][p], right_[k][p+2], ts_mpo, false);
+            // Blocks which are only reached by some of the terms must be kept
+            term.make_left_paired();
+            if (k == 0) {
+                swap(ret, term);
+            }
+            else {
+                ret.data() += term.data();
+            }
+        }
+        return ret;
+    }
+
+    void update_left(std::size_t p)
+    {
+        for (std::size_t k = 0; k < mpos.size(); ++k)
+            left_[k][p+1] = contr::overlap_mpo_left_step(fit[p], mps[k][p], left_[k][p], mpos[k][p], false);
+    }
+
+    void update_right(std::size_t p)
+    {
+        for (std::size_t k = 0; k < mpos.size(); ++k)
+            right_[k][p] = contr::overlap_mpo_right_step(fit[p], mps[k][p], right_[k][p+1], mpos[k][p], false);
+    }
+
+    void init_left_right()
+    {
+        std::size_t L = fit.length();
+        left_.resize(mpos.size(), std::vector<boundary_type>(L+1));
+        right_.resize(mpos.size(), std::vector<boundary_type>(L+1));
+        for (std::size_t k = 0; k < mpos.size(); ++k) {
+            left_[k][0] = mps_mpo_detail::mixed_left_boundary(fit, mps[k]);
+            right_[k][L] = mps_mpo_detail::mixed_right_boundary(fit, mps[k]);
+        }
+        for (std::size_t p = L-1; p > 1; --p)
+            update_right(p);
+    }
+
+    std::vector<MPO<Matrix, SymmGroup> > const & mpos;
+    std::vector<MPS<Matrix, SymmGroup> > const & mps;
+    MPS<Matrix, SymmGroup> fit;
+    std::size_t Mmax;
+    double cutoff;
+    std::vector<std::vector<boundary_type> > left_, right_;
+};
+
+/**
+ * @brief Guess for [mpo_sum_fitter] with all the symmetry sectors allowed by the total charge of [mps].
+ *
+ * [mps] is joined with an MPS with [m] random states in each allowed sector, so that the
+ * sectors which are reached by the MPOs but are missing in [mps] are present in the guess.
+ */
+template<class Matrix, class SymmGroup>
+MPS<Matrix, SymmGroup> enriched_guess(MPS<Matrix, SymmGroup> const & mps, std::size_t m = 1)
+{
+    std::size_t L = mps.length();
+    std::vector<Index<SymmGroup> > phys_dims(L);
+    std::vector<int> site_type(L);
+    for (std::size_t p = 0; p < L; ++p) {
+        phys_dims[p] = mps[p].site_dim();
+        site_type[p] = p;
+    }
+    std::vector<Index<SymmGroup> > allowed = allowed_sectors(site_type, phys_dims, mps[L-1].col_dim()[0].first, m);
+
+    MPS<Matrix, SymmGroup> random(L);
+    for (std::size_t p = 0; p < L; ++p)
+        random[p] = MPSTensor<Matrix, SymmGroup>(phys_dims[p], allowed[p], allowed[p+1], true, 0);
+    return join(mps, random);
+}
+
+#endif
@@ -66,6 +66,10 @@ MPOTensor<Matrix, SymmGroup>::MPOTensor(index_type ld
                 std::swap(element, new_element);
             }
         }
+        // The operator table is shared by the MPOTensors, which can be built concurrently
+        #ifdef MAQUIS_OPENMP
+        #pragma omp critical (mpotensor_operator_table)
+        #endif
         for (std::size_t i = 0; i < operator_table->size(); ++i)
             operator_table->operator[](i).update_sparse();
     }
@@ -216,6 +216,38 @@ std::vector<typename MPS<Matrix, SymmGroup>::scalar_type> multi_overlap(MPS<Matr
     return vals;
 }
 
+/**
+ * @brief Matrix of the overlaps <bras[i]|kets[j]>.
+ *
+ * The pairs are evaluated concurrently. Each pair contracts its own copies of the MPSs,
+ * since the contraction changes the pairing of the tensors, which may be shared by
+ * several pairs. If [bras] and [kets] are the same vector, only the upper triangle
+ * is contracted and the lower one is obtained from the hermiticity of the overlap.
+ */
+template<class Matrix, class SymmGroup>
+Matrix overlap_matrix(std::vector<MPS<Matrix, SymmGroup> > const & bras,
+                      std::vector<MPS<Matrix, SymmGroup> > const & kets)
+{
+    bool hermitian = (&bras == &kets);
+    std::vector<std::pair<std::size_t, std::size_t> > pairs;
+    for (std::size_t j = 0; j < kets.size(); ++j)
+        for (std::size_t i = 0; i < (hermitian ? j+1 : bras.size()); ++i)
+            pairs.push_back(std::make_pair(i, j));
+
+    Matrix ret(bras.size(), kets.size());
+    #ifdef MAQUIS_OPENMP
+    #pragma omp parallel for schedule(dynamic)
+    #endif
+    for (std::size_t k = 0; k < pairs.size(); ++k) {
+        std::size_t i = pairs[k].first, j = pairs[k].second;
+        MPS<Matrix, SymmGroup> bra = bras[i], ket = kets[j];
+        ret(i, j) = overlap(bra, ket);
+        if (hermitian)
+            ret(j, i) = utils::conj(ret(i, j));
+    }
+    return ret;
+}
+
 //typedef std::vector< std::vector< std::pair<std::string, double> > > entanglement_spectrum_type;
 typedef std::vector< std::pair<std::vector<std::string>, std::vector<double> > > entanglement_spectrum_type;
 template<class Matrix, class SymmGroup>
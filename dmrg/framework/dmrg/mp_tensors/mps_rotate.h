@@ -31,11 +31,14 @@
 #ifndef MPS_ROTATE_H
 #define MPS_ROTATE_H
 
+#include <set>
+
 #include "dmrg/mp_tensors/mps.h"
 #include "dmrg/mp_tensors/mps_sectors.h"
 #include "dmrg/mp_tensors/mpo_times_mps.hpp"
 #include "dmrg/mp_tensors/mps_join.h"
 #include "dmrg/mp_tensors/compression.h"
+#include "dmrg/mp_tensors/mpo_sum_fitter.h"
 #include "dmrg/mp_tensors/mpo.h"
 #include "integral_interface.h"
 #include "dmrg/models/generate_mpo.hpp"
@@ -194,6 +197,83 @@ namespace mps_rotate
     };
     */
 
+    // sum of the MPOs returned by setupMPO as a single MPO
+    // The terms a^+_i a_j share the identities and fillings before and after their operators
+    // and their operators on site j, so that the auxiliary bond states are only: no operator
+    // applied yet, an up or a down term open, both operators applied (at most 3 per bond).
+    // The coefficient of each term, including the fermionic signs, is put on its operator on site i.
+    template<class Matrix, class SymmGroup>
+    MPO<Matrix, SymmGroup> setupSummedMPO(const Matrix & t, int j, const Lattice& lat, const Model<Matrix, SymmGroup> & model)
+    {
+        typedef Lattice::pos_t pos_t;
+        typedef typename Matrix::value_type value_type;
+        enum { pending, open_up, open_down, complete, n_states };
+
+        std::vector<MPO<Matrix, SymmGroup> > terms = setupMPO<Matrix, SymmGroup>()(t, j, lat, model);
+        pos_t L = lat.size();
+
+        // terms[2*n] and terms[2*n+1] are the up and down terms of the n-th orbital i != j
+        std::vector<pos_t> orbital;
+        for (pos_t i = 0; i < L; ++i)
+            if (i != j) {
+                orbital.push_back(i);
+                orbital.push_back(i);
+            }
+
+        auto state = [&](std::size_t k, pos_t b) -> int {
+            if (b <= std::min<pos_t>(orbital[k], j))
+                return pending;
+            if (b > std::max<pos_t>(orbital[k], j))
+                return complete;
+            return (k % 2 == 0) ? open_up : open_down;
+        };
+
+        // index of the bond states present on each bond
+        std::vector<std::vector<int> > index(L+1, std::vector<int>(n_states, -1));
+        std::vector<std::size_t> bond_dim(L+1, 0);
+        for (pos_t b = 0; b <= L; ++b) {
+            for (std::size_t k = 0; k < terms.size(); ++k)
+                index[b][state(k, b)] = 0;
+            for (int s = 0; s < n_states; ++s)
+                if (index[b][s] == 0)
+                    index[b][s] = bond_dim[b]++;
+        }
+
+        std::vector<value_type> coeff(terms.size(), 1.);
+        for (std::size_t k = 0; k < terms.size(); ++k)
+            for (pos_t p = 0; p < L; ++p)
+                coeff[k] *= terms[k][p].at(0,0).scale();
+
+        MPO<Matrix, SymmGroup> ret(L);
+        for (pos_t p = 0; p < L; ++p) {
+            typename MPOTensor<Matrix, SymmGroup>::prempo_t prempo;
+            std::set<std::pair<int, int> > shared;
+            for (std::size_t k = 0; k < terms.size(); ++k) {
+                int li = index[p][state(k, p)], ri = index[p+1][state(k, p+1)];
+                if (p == orbital[k])
+                    prempo.push_back(boost::make_tuple(li, ri, terms[k][p].tag_number(0,0), coeff[k]));
+                else if (shared.insert(std::make_pair(li, ri)).second)
+                    prempo.push_back(boost::make_tuple(li, ri, terms[k][p].tag_number(0,0), 1.));
+            }
+            ret[p] = MPOTensor<Matrix, SymmGroup>(bond_dim[p], bond_dim[p+1], prempo, terms[0][p].get_operator_table());
+        }
+        return ret;
+    }
+
+    // identity MPO, used to add MPSs in the variational fit
+    template<class Matrix, class SymmGroup>
+    MPO<Matrix, SymmGroup> setupIdentityMPO(const Lattice& lat, const Model<Matrix, SymmGroup> & model)
+    {
+        typedef typename SymmGroup::subcharge sc_t;
+        MPO<Matrix, SymmGroup> ret(lat.size());
+        for (Lattice::pos_t p = 0; p < lat.size(); ++p) {
+            typename MPOTensor<Matrix, SymmGroup>::prempo_t prempo;
+            prempo.push_back(boost::make_tuple(0, 0, model.identity_matrix_tag(lat.get_prop<sc_t>("type", p)), 1.));
+            ret[p] = MPOTensor<Matrix, SymmGroup>(1, 1, prempo, model.operators_table()->get_operator_table());
+        }
+        return ret;
+    }
+
     // function to calculate MPS' = MPO|MPS> aka (in CI terminology) calculating the sigma vector: sigma = H*C
     // as used e.g. in Eqs. 46 and 48
     template<class Matrix, class SymmGroup>
@@ -242,27 +322,17 @@ namespace mps_rotate
 
     }
 
-    // MPS rotation as described in Sections III.b.2.b and III.b.2.c
-    // t: rotation matrix from Eqs. 35f but only for active orbitals
-    // inactive_scaling: inactive scaling factor from Eq. 43
+    // parameters of the lattice and model used to set up the rotation MPOs
     template <class Matrix, class SymmGroup>
-    void rotate_mps(MPS<Matrix, SymmGroup> & mps, const Matrix& t, typename Matrix::value_type inactive_scaling)
+    BaseParameters rotation_parameters(MPS<Matrix, SymmGroup> const & mps)
     {
-        typedef Lattice::pos_t pos_t;
-        typedef typename Matrix::value_type value_type;
-
         typename SymmGroup::subcharge Ndown, Nup;
 
-        pos_t L = mps.length();
-
-        assert(t.num_rows() == L);
-        assert(t.num_cols() == L);
+        Lattice::pos_t L = mps.length();
 
         Nup = mps[L-1].col_dim()[0].first[0];
         Ndown = mps[L-1].col_dim()[0].first[1];
 
-        // Create a lattice and model to set up MPOs
-
         // create a fake integral map to build a model so that it's happy.
         // we don't use the Hamiltonian of the models so we don't care for these integrals,
         // but the Model constructor will fail if no integrals are defined
@@ -272,6 +342,25 @@ namespace mps_rotate
         parms.set("integrals_binary", chem::serialize(fake_integrals));
         parms.set("integral_cutoff", 0.);
         parms.set("site_types", chem::detail::infer_site_types(mps));
+        return parms;
+    }
+
+    // MPS rotation as described in Sections III.b.2.b and III.b.2.c
+    // t: rotation matrix from Eqs. 35f but only for active orbitals
+    // inactive_scaling: inactive scaling factor from Eq. 43
+    template <class Matrix, class SymmGroup>
+    void rotate_mps(MPS<Matrix, SymmGroup> & mps, const Matrix& t, typename Matrix::value_type inactive_scaling)
+    {
+        typedef Lattice::pos_t pos_t;
+        typedef typename Matrix::value_type value_type;
+
+        pos_t L = mps.length();
+
+        assert(t.num_rows() == L);
+        assert(t.num_cols() == L);
+
+        // Create a lattice and model to set up MPOs
+        BaseParameters parms = rotation_parameters(mps);
         Lattice lat(parms);
         Model<Matrix,SymmGroup> model = Model<Matrix, SymmGroup>(lat, parms);
 
@@ -346,5 +435,60 @@ namespace mps_rotate
         }
     }
 
+    // MPS rotation as in rotate_mps, where the corrections of each site are obtained with a
+    // variational fit of bond dimension Mmax instead of joining and compressing all the MPO products:
+    // |mps'> is fitted to O|mps>, and the rotated MPS to |mps> + |mps'> + 1/2 O|mps'>,
+    // with O the sum of the one-body terms of site j (see setupSummedMPO).
+    template <class Matrix, class SymmGroup>
+    void rotate_mps(MPS<Matrix, SymmGroup> & mps, const Matrix& t, typename Matrix::value_type inactive_scaling,
+                    std::size_t Mmax, double cutoff)
+    {
+        typedef Lattice::pos_t pos_t;
+
+        pos_t L = mps.length();
+
+        assert(t.num_rows() == L);
+        assert(t.num_cols() == L);
+
+        const std::size_t max_sweeps = 10;
+
+        BaseParameters parms = rotation_parameters(mps);
+        Lattice lat(parms);
+        Model<Matrix,SymmGroup> model = Model<Matrix, SymmGroup>(lat, parms);
+        MPO<Matrix, SymmGroup> identity = setupIdentityMPO(lat, model);
+
+        mps[0].multiply_by_scalar(inactive_scaling);
+
+        for (pos_t j = 0; j < L; ++j)
+        {
+            maquis::cout << "ROTATION of site "<< j << std::endl << "---------------- "<<      std::endl;
+
+            scale_MPSTensor<Matrix, SymmGroup>(mps[j], t(j,j));
+
+            // no one-body terms for a single orbital
+            if (L == 1) continue;
+
+            MPO<Matrix, SymmGroup> mpo = setupSummedMPO<Matrix, SymmGroup>(t, j, lat, model);
+
+            // |mps'> = O|mps> (first correction vector)
+            std::vector<MPO<Matrix, SymmGroup> > first_mpos(1, mpo);
+            std::vector<MPS<Matrix, SymmGroup> > first_mps(1, mps);
+            mpo_sum_fitter<Matrix, SymmGroup> first(first_mpos, first_mps, enriched_guess(mps), Mmax, cutoff);
+            std::size_t n_sweeps = first.converge(cutoff, max_sweeps);
+            maquis::cout << "- first correction MPS fitted, sweeps  : " << n_sweeps << std::endl;
+
+            // |mps> + |mps'> + 1/2 O|mps'>
+            MPO<Matrix, SymmGroup> half_mpo = mpo;
+            half_mpo[0].multiply_by_scalar(0.5);
+            std::vector<MPO<Matrix, SymmGroup> > final_mpos = {identity, identity, half_mpo};
+            std::vector<MPS<Matrix, SymmGroup> > final_mps = {mps, first.get_current_mps(), first.get_current_mps()};
+            mpo_sum_fitter<Matrix, SymmGroup> rotated(final_mpos, final_mps, enriched_guess(mps), Mmax, cutoff);
+            n_sweeps = rotated.converge(cutoff, max_sweeps);
+            maquis::cout << "- final MPS fitted, sweeps             : " << n_sweeps << std::endl;
+
+            mps = rotated.get_current_mps();
+        }
+    }
+
 }
 #endif
\ No newline at end of file
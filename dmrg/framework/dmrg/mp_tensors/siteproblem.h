@@ -29,6 +29,8 @@
 #include "dmrg/mp_tensors/mpotensor.h"
 #include "dmrg/optimize/ietl_lanczos_solver.h"
 
+#include <memory>
+
 #ifndef SITEPROBLEM
 #define SITEPROBLEM
 
@@ -64,11 +66,27 @@ struct SiteProblem
         return maquis::real(res);
     }
 
+    /**
+     * @brief Getter for the contraction plan associated with a given input vector.
+     *
+     * The plan is built at the first call and reused as long as the block structure
+     * of the input vector does not change (which is the case for all the iterations
+     * of an eigensolver).
+     */
+    contraction::common::ContractionPlan<Matrix, SymmGroup> & contraction_plan(MPSTensor<Matrix, SymmGroup> const & x) const
+    {
+        if (!plan || !plan->matches(x))
+            plan = std::make_shared<contraction::common::ContractionPlan<Matrix, SymmGroup> >(x);
+        return *plan;
+    }
+
     /** Class members */
     Boundary<typename storage::constrained<Matrix>::type, SymmGroup> const & left;
     Boundary<typename storage::constrained<Matrix>::type, SymmGroup> const & right;
     MPOTensor<Matrix, SymmGroup> const & mpo;
     double ortho_shift=0.;
+private:
+    mutable std::shared_ptr<contraction::common::ContractionPlan<Matrix, SymmGroup> > plan;
 };
 
 namespace ietl {
@@ -85,6 +85,22 @@ public:
     boost::tuple<MPSTensor<Matrix, SymmGroup>, MPSTensor<Matrix, SymmGroup>, truncation_results>
     predict_split_r2l(std::size_t Mmax, double cutoff, double alpha, Boundary<Matrix, SymmGroup> const& right,
                       MPOTensor<Matrix, SymmGroup> const& mpo);
+
+    /**
+     * @brief Splits several states given in the same two-site basis, moving to the right.
+     *
+     * The common left tensor is built from the eigenvectors of the reduced density matrix
+     * averaged over the states with [weights]; the right tensors contain the states
+     * expressed in the truncated basis.
+     */
+    static boost::tuple<MPSTensor<Matrix, SymmGroup>, std::vector<MPSTensor<Matrix, SymmGroup> >, truncation_results>
+    split_averaged_l2r(std::vector<TwoSiteTensor> const & states, std::vector<double> const & weights,
+                       std::size_t Mmax, double cutoff);
+
+    /** @brief Same as [split_averaged_l2r], with the common tensor on the right */
+    static boost::tuple<std::vector<MPSTensor<Matrix, SymmGroup> >, MPSTensor<Matrix, SymmGroup>, truncation_results>
+    split_averaged_r2l(std::vector<TwoSiteTensor> const & states, std::vector<double> const & weights,
+                       std::size_t Mmax, double cutoff);
     
     void clear();
     void swap_with(TwoSiteTensor & b);
@@ -30,6 +30,7 @@
 
 #include "dmrg/mp_tensors/reshapes.h"
 #include "dmrg/block_matrix/block_matrix_algorithms.h"
+#include "dmrg/block_matrix/density_matrix.h"
 
 #include "dmrg/utils/random.hpp"
 #include <alps/numeric/real.hpp>
@@ -214,7 +215,7 @@ TwoSiteTensor<Matrix, SymmGroup>::predict_split_l2r(std::size_t Mmax, double cut
     
     /// build reduced density matrix (with left index open)
     block_matrix<Matrix, SymmGroup> dm;
-    gemm(data_, transpose(conjugate(data_)), dm, parallel::scheduler_balanced(data_));
+    gram_left(data_, dm);
     
     /// state prediction
     if (alpha != 0.) {
@@ -227,7 +228,7 @@ TwoSiteTensor<Matrix, SymmGroup>::predict_split_l2r(std::size_t Mmax, double cut
         
         omp_for(std::size_t b, parallel::range<std::size_t>(0,half_dm.aux_dim()), {
             block_matrix<Matrix, SymmGroup> tdm;
-            gemm(half_dm[b], transpose(conjugate(half_dm[b])), tdm);
+            gram_left(half_dm[b], tdm);
             tdm *= alpha;
             swap(tdm, half_dm[b]);
         });
@@ -282,7 +283,7 @@ TwoSiteTensor<Matrix, SymmGroup>::predict_split_r2l(std::size_t Mmax, double cut
     
     /// build reduced density matrix (with right index open)
     block_matrix<Matrix, SymmGroup> dm;
-    gemm(transpose(conjugate(data_)), data_, dm, parallel::scheduler_balanced(data_));
+    gram_right(data_, dm);
     
     /// state prediction
     if (alpha != 0.) {
@@ -295,7 +296,7 @@ TwoSiteTensor<Matrix, SymmGroup>::predict_split_r2l(std::size_t Mmax, double cut
         
         omp_for(std::size_t b, parallel::range<std::size_t>(0,half_dm.aux_dim()), {
             block_matrix<Matrix, SymmGroup> tdm;
-            gemm(transpose(conjugate(half_dm[b])), half_dm[b], tdm);
+            gram_right(half_dm[b], tdm);
             tdm *= alpha;
             swap(tdm, half_dm[b]);
         });
@@ -342,6 +343,81 @@ TwoSiteTensor<Matrix, SymmGroup>::predict_split_r2l(std::size_t Mmax, double cut
 }
 
 
+template<class Matrix, class SymmGroup>
+boost::tuple<MPSTensor<Matrix, SymmGroup>, std::vector<MPSTensor<Matrix, SymmGroup> >, truncation_results>
+TwoSiteTensor<Matrix, SymmGroup>::split_averaged_l2r(std::vector<TwoSiteTensor> const & states, std::vector<double> const & weights,
+                                                     std::size_t Mmax, double cutoff)
+{
+    assert( !states.empty() && states.size() == weights.size() );
+
+    /// build the state-averaged reduced density matrix (with left index open)
+    block_matrix<Matrix, SymmGroup> dm;
+    for (std::size_t k = 0; k < states.size(); ++k) {
+        states[k].make_both_paired();
+        block_matrix<Matrix, SymmGroup> tdm;
+        gram_left(states[k].data_, tdm);
+        tdm *= weights[k];
+        dm += tdm;
+    }
+
+    /// truncation
+    block_matrix<Matrix, SymmGroup> U;
+    block_matrix<typename alps::numeric::associated_real_diagonal_matrix<Matrix>::type, SymmGroup> S;
+    truncation_results trunc = heev_truncate(dm, U, S, cutoff, Mmax);
+    dm = block_matrix<Matrix, SymmGroup>();
+
+    MPSTensor<Matrix, SymmGroup> mps_tensor1(states[0].phys_i_left, states[0].left_i, U.right_basis(), U, LeftPaired);
+    assert( mps_tensor1.reasonable() );
+
+    std::vector<MPSTensor<Matrix, SymmGroup> > mps_tensors2(states.size());
+    for (std::size_t k = 0; k < states.size(); ++k) {
+        block_matrix<Matrix, SymmGroup> V;
+        gemm(transpose(conjugate(U)), states[k].data_, V);
+        mps_tensors2[k] = MPSTensor<Matrix, SymmGroup>(states[k].phys_i_right, V.left_basis(), states[k].right_i, V, RightPaired);
+        assert( mps_tensors2[k].reasonable() );
+    }
+
+    return boost::make_tuple(mps_tensor1, mps_tensors2, trunc);
+}
+
+template<class Matrix, class SymmGroup>
+boost::tuple<std::vector<MPSTensor<Matrix, SymmGroup> >, MPSTensor<Matrix, SymmGroup>, truncation_results>
+TwoSiteTensor<Matrix, SymmGroup>::split_averaged_r2l(std::vector<TwoSiteTensor> const & states, std::vector<double> const & weights,
+                                                     std::size_t Mmax, double cutoff)
+{
+    assert( !states.empty() && states.size() == weights.size() );
+
+    /// build the state-averaged reduced density matrix (with right index open)
+    block_matrix<Matrix, SymmGroup> dm;
+    for (std::size_t k = 0; k < states.size(); ++k) {
+        states[k].make_both_paired();
+        block_matrix<Matrix, SymmGroup> tdm;
+        gram_right(states[k].data_, tdm);
+        tdm *= weights[k];
+        dm += tdm;
+    }
+
+    /// truncation
+    block_matrix<Matrix, SymmGroup> U;
+    block_matrix<typename alps::numeric::associated_real_diagonal_matrix<Matrix>::type, SymmGroup> S;
+    truncation_results trunc = heev_truncate(dm, U, S, cutoff, Mmax);
+    dm = block_matrix<Matrix, SymmGroup>();
+
+    MPSTensor<Matrix, SymmGroup> mps_tensor2(states[0].phys_i_right, U.left_basis(), states[0].right_i, transpose(conjugate(U)), RightPaired);
+    assert( mps_tensor2.reasonable() );
+
+    std::vector<MPSTensor<Matrix, SymmGroup> > mps_tensors1(states.size());
+    for (std::size_t k = 0; k < states.size(); ++k) {
+        block_matrix<Matrix, SymmGroup> V;
+        gemm(states[k].data_, U, V);
+        mps_tensors1[k] = MPSTensor<Matrix, SymmGroup>(states[k].phys_i_left, states[k].left_i, V.right_basis(), V, LeftPaired);
+        assert( mps_tensors1[k].reasonable() );
+    }
+
+    return boost::make_tuple(mps_tensors1, mps_tensor2, trunc);
+}
+
+
 template<class Matrix, class SymmGroup>
 std::ostream& operator<<(std::ostream& os, TwoSiteTensor<Matrix, SymmGroup> const & mps)
 {
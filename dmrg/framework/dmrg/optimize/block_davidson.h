@@ -0,0 +1,218 @@
+/*****************************************************************************
+ *
+ * QCMaquis DMRG Project
+ *
+ * Copyright (C) 2021 Laboratory for Physical Chemistry, ETH Zurich
+ *
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+// Block version of the Davidson algorithm of davidson.h, targeting several roots at once
+
+#ifndef IETL_BLOCK_DAVIDSON_H
+#define IETL_BLOCK_DAVIDSON_H
+
+#include <ietl/traits.h>
+#include <ietl/fmatrix.h>
+#include <ietl/ietl2lapack.h>
+
+#include <vector>
+
+#include <alps/numeric/conj.hpp>
+
+namespace ietl
+{
+    /**
+     * @brief Block Davidson solver for the lowest eigenpairs of a hermitian operator.
+     *
+     * At each iteration, the preconditioned residuals of all the roots that are not
+     * converged yet are added to the subspace together, and the operator is applied
+     * to all of them with a single call to ietl::mult, so that the cost of traversing
+     * the operator is shared by the roots.
+     */
+    template <class MATRIX, class VS>
+    class block_davidson
+    {
+    public:
+        typedef typename vectorspace_traits<VS>::vector_type vector_type;
+        typedef typename vectorspace_traits<VS>::scalar_type scalar_type;
+        typedef typename ietl::number_traits<scalar_type>::magnitude_type magnitude_type;
+
+        /**
+         * @param n_roots number of eigenpairs to compute.
+         * @param max_subspace the subspace is collapsed onto the current Ritz vectors when it gets larger.
+         */
+        block_davidson(const MATRIX& matrix, const VS& vec, std::size_t n_roots, std::size_t max_subspace = 40);
+
+        /**
+         * @brief Computes the lowest [n_roots] eigenpairs.
+         * @param initial starting guesses, at least one. Missing guesses are taken from the
+         *        preconditioned residuals of the first iteration.
+         * @param mdiag preconditioner, providing precondition(r, u, theta).
+         * @param iter iteration control, the iteration stops when all the roots are converged.
+         */
+        template <class PRECOND, class ITER>
+        std::vector<std::pair<magnitude_type, vector_type> > calculate_eigenvalues(std::vector<vector_type> const & initial,
+                                                                                   PRECOND& mdiag,
+                                                                                   ITER& iter);
+    private:
+        std::size_t add_vectors(std::vector<vector_type> & new_vectors);
+
+        static scalar_type conj_value(scalar_type x)
+        {
+            alps::numeric::conj_inplace(x);
+            return x;
+        }
+
+        MATRIX const & matrix_;
+        VS vecspace_;
+        std::size_t n_roots_, max_subspace_;
+        std::vector<vector_type> V, VA;
+    };
+
+    template <class MATRIX, class VS>
+    block_davidson<MATRIX, VS>::block_davidson(const MATRIX& matrix, const VS& vec, std::size_t n_roots, std::size_t max_subspace)
+    : matrix_(matrix)
+    , vecspace_(vec)
+    , n_roots_(n_roots)
+    , max_subspace_(std::max(max_subspace, 2*n_roots))
+    {}
+
+    /**
+     * Orthonormalizes [new_vectors] against the subspace and among themselves (Gram-Schmidt
+     * applied twice), drops the linearly dependent ones, and applies the operator to the
+     * remaining ones in a single batch. Returns the number of vectors added to the subspace.
+     */
+    template <class MATRIX, class VS>
+    std::size_t block_davidson<MATRIX, VS>::add_vectors(std::vector<vector_type> & new_vectors)
+    {
+        std::size_t first = V.size();
+        for (std::size_t k = 0; k < new_vectors.size(); ++k)
+        {
+            vector_type & t = new_vectors[k];
+            ietl::project(t, vecspace_);
+            magnitude_type tau = ietl::two_norm(t);
+            for (int pass = 0; pass < 2; ++pass)
+                for (std::size_t i = 0; i < V.size(); ++i)
+                    t -= ietl::dot(V[i], t) * V[i];
+            magnitude_type norm = ietl::two_norm(t);
+            if (norm < 1e-8 * tau || norm == 0.)
+                continue;
+            t /= norm;
+            V.push_back(t);
+        }
+
+        std::vector<vector_type> images;
+        std::vector<vector_type> batch(V.begin() + first, V.end());
+        if (!batch.empty())
+            ietl::mult(matrix_, batch, images);
+        VA.insert(VA.end(), images.begin(), images.end());
+        return V.size() - first;
+    }
+
+    template <class MATRIX, class VS>
+    template <class PRECOND, class ITER>
+    std::vector<std::pair<typename block_davidson<MATRIX, VS>::magnitude_type, typename block_davidson<MATRIX, VS>::vector_type> >
+    block_davidson<MATRIX, VS>::calculate_eigenvalues(std::vector<vector_type> const & initial,
+                                                      PRECOND& mdiag,
+                                                      ITER& iter)
+    {
+        typedef alps::numeric::matrix<scalar_type> matrix_t;
+
+        V.clear();
+        VA.clear();
+        // Projection of the operator onto the subspace, extended with the new vectors at each iteration
+        matrix_t M;
+
+        std::vector<vector_type> new_vectors(initial);
+        std::vector<vector_type> u(n_roots_), uA(n_roots_);
+        std::vector<magnitude_type> theta(n_roots_);
+        std::size_t n_found = 0;
+
+        do
+        {
+            std::size_t first = V.size();
+            if (add_vectors(new_vectors) == 0 && first > 0)
+                break;
+
+            std::size_t iter_dim = V.size();
+            M.resize(iter_dim, iter_dim);
+            for (std::size_t j = first; j < iter_dim; ++j)
+                for (std::size_t i = 0; i <= j; ++i)
+                {
+                    M(i, j) = ietl::dot(V[i], VA[j]);
+                    M(j, i) = conj_value(M(i, j));
+                }
+
+            matrix_t Mevecs = M;
+            std::vector<magnitude_type> Mevals(iter_dim);
+            boost::numeric::bindings::lapack::heevd('V', Mevecs, Mevals);
+
+            // Ritz pairs and residuals of the roots, the subspace itself is not rotated
+            n_found = std::min(n_roots_, iter_dim);
+            magnitude_type max_residual = 0.;
+            new_vectors.clear();
+            for (std::size_t k = 0; k < n_found; ++k)
+            {
+                u[k] = V[0] * Mevecs(0, k);
+                uA[k] = VA[0] * Mevecs(0, k);
+                for (std::size_t i = 1; i < iter_dim; ++i)
+                {
+                    u[k] += V[i] * Mevecs(i, k);
+                    uA[k] += VA[i] * Mevecs(i, k);
+                }
+                theta[k] = Mevals[k];
+
+                vector_type r = uA[k];
+                r -= Mevals[k] * u[k];
+                magnitude_type residual = ietl::two_norm(r);
+                max_residual = std::max(max_residual, residual);
+                if (!iter.converged(residual, Mevals[k]))
+                {
+                    mdiag.precondition(r, u[k], Mevals[k]);
+                    new_vectors.push_back(r);
+                }
+            }
+
+            ++iter;
+            if (n_found == n_roots_ && iter.finished(max_residual, Mevals[0]))
+                break;
+
+            if (V.size() + new_vectors.size() > max_subspace_)
+            {
+                // Restart from the Ritz vectors
+                V.assign(u.begin(), u.begin() + n_found);
+                VA.assign(uA.begin(), uA.begin() + n_found);
+                M = matrix_t(n_found, n_found, scalar_type(0.));
+                for (std::size_t k = 0; k < n_found; ++k)
+                    M(k, k) = theta[k];
+            }
+
+        } while (true);
+
+        std::vector<std::pair<magnitude_type, vector_type> > ret;
+        ret.reserve(n_roots_);
+        for (std::size_t k = 0; k < n_found; ++k)
+            ret.push_back(std::make_pair(theta[k], u[k]));
+        return ret;
+    }
+}
+
+#endif
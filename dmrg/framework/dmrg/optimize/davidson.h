@@ -46,6 +46,8 @@
 
 #include <boost/function.hpp>
 
+#include <alps/numeric/conj.hpp>
+
 namespace ietl
 {
     //enum DesiredEigenvalue { Largest, Smallest };
@@ -69,6 +71,16 @@ namespace ietl
                                                                     PRECOND& mdiag,
                                                                     ITER& iter);
     private:
+        template <class MATRIX_T>
+        void ritz_vector(std::vector<vector_type> const & V, std::vector<vector_type> const & VA, MATRIX_T const & evecs,
+                         std::size_t k, vector_type & u, vector_type & uA) const;
+
+        static scalar_type conj_value(scalar_type x)
+        {
+            alps::numeric::conj_inplace(x);
+            return x;
+        }
+
         MATRIX const & matrix_;
         VS vecspace_;
         magnitude_type atol_;
@@ -82,6 +94,24 @@ namespace ietl
     desired_(desired)
     {}
     
+    /**
+     * Computes the k-th Ritz vector u = sum_i V_i evecs(i,k) and its image uA = A u, as
+     * a linear combination of the stored images of the subspace vectors.
+     */
+    template <class MATRIX, class VS>
+    template <class MATRIX_T>
+    void davidson<MATRIX, VS>::ritz_vector(std::vector<vector_type> const & V, std::vector<vector_type> const & VA,
+                                           MATRIX_T const & evecs, std::size_t k, vector_type & u, vector_type & uA) const
+    {
+        u = V[0] * evecs(0, k);
+        uA = VA[0] * evecs(0, k);
+        for (std::size_t i = 1; i < V.size(); ++i)
+        {
+            u += V[i] * evecs(i, k);
+            uA += VA[i] * evecs(i, k);
+        }
+    }
+
     template <class MATRIX, class VS> 
     template <class GEN, class SOLVER, class PRECOND, class ITER>
     std::pair<typename davidson<MATRIX,VS>::magnitude_type, typename davidson<MATRIX, VS>::vector_type> 
@@ -96,21 +126,22 @@ namespace ietl
         vector_type u  = new_vector(vecspace_);
         vector_type uA = new_vector(vecspace_);
         vector_type r  = new_vector(vecspace_);
+        vector_type uA_1;
 
-        std::vector<scalar_type> s(iter.max_iterations());
         std::vector<vector_type> V;
         std::vector<vector_type> VA;
+        // Projection of the matrix onto the subspace, extended by one row and column per iteration
+        matrix_t M;
 
-        unsigned int i,j;
+        unsigned int i;
         magnitude_type theta, tau;
         magnitude_type kappa = 0.25;
-        magnitude_type rel_tol;
         atol_ = iter.absolute_tolerance();
-        
+
         // Start with t=v_o, starting guess
         ietl::generate(t,gen);
         ietl::project(t,vecspace_);
-        
+
         // Start iteration
         do
         {
@@ -121,66 +152,61 @@ namespace ietl
             if (ietl::two_norm(t) < kappa * tau)
                 for (i = 0; i < V.size(); i++)
                     t -= ietl::dot(V[i], t) * V[i];
-            
+
             // Project out orthogonal subspace
             ietl::project(t, vecspace_);
-            
+
             // v_m = t / |t|_2,  v_m^A = A v_m
-            V.push_back(t/ietl::two_norm(t));
+            t /= ietl::two_norm(t);
+            V.push_back(t);
             VA.resize(V.size());
-            ietl::mult(matrix_, V[V.size() - 1], VA[V.size() - 1]);
-            
-            std::size_t iter_dim = V.size();
-            matrix_t M(iter_dim, iter_dim), Mevecs(iter_dim, iter_dim);
-            std::vector<magnitude_type> Mevals(iter_dim);
-
-            for (i = 0; i < iter_dim; ++i)
-            for (j = i; j < iter_dim; ++j)
-            {
-                M(i,j) = ietl::dot(V[i], VA[j]);
-                M(j,i) = M(i,j);
-            }
-
-            boost::numeric::bindings::lapack::heevd('V', M, Mevals);
-            Mevecs = M;
+            ietl::mult(matrix_, V.back(), VA.back());
 
-            std::vector<vector_type> Vp = V, VAp = VA;
+            std::size_t iter_dim = V.size();
+            M.resize(iter_dim, iter_dim);
             for (i = 0; i < iter_dim; ++i)
             {
-                V[i] *= Mevecs(i,i);
-                VA[i] *= Mevecs(i,i);
+                M(i, iter_dim-1) = ietl::dot(V[i], VA[iter_dim-1]);
+                M(iter_dim-1, i) = conj_value(M(i, iter_dim-1));
             }
 
-            for (i = 0; i < iter_dim; ++i)
-            for (j = 0; j < iter_dim; ++j)
-                if(i != j)
-                {
-                    V[j] += Vp[i] * Mevecs(i,j);
-                    VA[j] += VAp[i] * Mevecs(i,j);
-                }
+            matrix_t Mevecs = M;
+            std::vector<magnitude_type> Mevals(iter_dim);
+            boost::numeric::bindings::lapack::heevd('V', Mevecs, Mevals);
 
-            r = VA[0] - V[0] * Mevals[0];
+            // Ritz vector and its image, the subspace itself is not rotated
+            ritz_vector(V, VA, Mevecs, 0, u, uA);
+            r = uA;
+            r -= Mevals[0] * u;
 
             theta = Mevals[0];
-            u = V[0];
 
             // if (|r|_2 < \epsilon) stop
             ++iter;
             if (iter.finished(ietl::two_norm(r), Mevals[0]))
                 break;
 
-            mdiag.precondition(r, V[0], Mevals[0]);
-            std::swap(t,r);  
+            mdiag.precondition(r, u, Mevals[0]);
+            std::swap(t,r);
             t /= ietl::two_norm(t);
 
             if (V.size() >= 20)
             {
+                // Restart from the two lowest Ritz vectors
+                ritz_vector(V, VA, Mevecs, 1, r, uA_1);
+                std::swap(V[1], r);
+                std::swap(VA[1], uA_1);
+                V[0] = u;
+                VA[0] = uA;
                 V.resize(2);
                 VA.resize(2);
+                M = matrix_t(2, 2, scalar_type(0.));
+                M(0, 0) = Mevals[0];
+                M(1, 1) = Mevals[1];
             }
 
         } while (true);
-        
+
         // accept lambda=theta and x=u
         return std::make_pair(theta, u);
     }
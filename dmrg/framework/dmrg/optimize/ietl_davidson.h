@@ -33,18 +33,31 @@
 #include "ietl_lanczos_solver.h"
 
 #include "davidson.h"
+#include "block_davidson.h"
 
 namespace davidson_detail {
 
+    /** @brief Diagonal of the site Hamiltonian, computed with the engine of the symmetry group */
     template<class Matrix, class SymmGroup, class = void>
-    class ref_diag
+    struct diagonal_hamiltonian
     {
-    public:
-        void operator()(SiteProblem<Matrix, SymmGroup> const & H, MPSTensor<Matrix, SymmGroup> x){}
+        static block_matrix<Matrix, SymmGroup> apply(SiteProblem<Matrix, SymmGroup> const & H, MPSTensor<Matrix, SymmGroup> const & x)
+        {
+            return contraction::abelian::diagonal_hamiltonian(H.left, H.right, H.mpo, x);
+        }
     };
 
     template<class Matrix, class SymmGroup>
-    class ref_diag<Matrix, SymmGroup, symm_traits::enable_if_su2_t<SymmGroup>>
+    struct diagonal_hamiltonian<Matrix, SymmGroup, symm_traits::enable_if_su2_t<SymmGroup>>
+    {
+        static block_matrix<Matrix, SymmGroup> apply(SiteProblem<Matrix, SymmGroup> const & H, MPSTensor<Matrix, SymmGroup> const & x)
+        {
+            return contraction::SU2::diagonal_hamiltonian(H.left, H.right, H.mpo, x);
+        }
+    };
+
+    template<class Matrix, class SymmGroup>
+    class ref_diag
     {
     public:
         void operator()(SiteProblem<Matrix, SymmGroup> const & H, MPSTensor<Matrix, SymmGroup> x)
@@ -57,7 +70,7 @@ namespace davidson_detail {
             block_matrix<Matrix, SymmGroup> & bm = x.data();
 
 
-            block_matrix<Matrix, SymmGroup> ret2 = contraction::SU2::diagonal_hamiltonian(H.left, H.right, H.mpo, x);
+            block_matrix<Matrix, SymmGroup> ret2 = diagonal_hamiltonian<Matrix, SymmGroup>::apply(H, x);
 
             for (size_t b = 0; b < bm.n_blocks(); ++b)
             {
@@ -76,64 +89,132 @@ namespace davidson_detail {
         }
     };
 
-    template<class Matrix, class SymmGroup, class = void>
+    /**
+     * @brief Davidson preconditioner based on the diagonal of the site Hamiltonian.
+     *
+     * The diagonal is computed once per site problem and stored as a flat array of real
+     * numbers, block after block and column after column, so that the shifted inverse
+     * can be applied with contiguous loops that the compiler can vectorize.
+     */
+    template<class Matrix, class SymmGroup>
     class MultDiagonal
     {
         typedef MPSTensor<Matrix, SymmGroup> vector_type;
         typedef typename Matrix::value_type value_type;
+        typedef typename vector_type::real_type real_type;
+        typedef typename SymmGroup::charge charge;
 
     public:
 
         MultDiagonal(SiteProblem<Matrix, SymmGroup> const& H, vector_type const& x)
         {
-            throw std::runtime_error("Davidson only implemented for spin-adapted Hamiltonians\n");
+            block_matrix<Matrix, SymmGroup> Hdiag = diagonal_hamiltonian<Matrix, SymmGroup>::apply(H, x);
+            std::size_t n_blocks = Hdiag.n_blocks();
+            charges.reserve(n_blocks);
+            rows.reserve(n_blocks);
+            cols.reserve(n_blocks);
+            offsets.reserve(n_blocks+1);
+            offsets.push_back(0);
+            for (std::size_t b = 0; b < n_blocks; ++b)
+            {
+                charges.push_back(std::make_pair(Hdiag.basis().left_charge(b), Hdiag.basis().right_charge(b)));
+                rows.push_back(num_rows(Hdiag[b]));
+                cols.push_back(num_cols(Hdiag[b]));
+                offsets.push_back(offsets.back() + num_rows(Hdiag[b]) * num_cols(Hdiag[b]));
+            }
+            diagonal.resize(offsets.back());
+            for (std::size_t b = 0; b < n_blocks; ++b)
+                for (std::size_t j = 0; j < cols[b]; ++j)
+                    std::transform(Hdiag[b].col(j).first, Hdiag[b].col(j).second, &diagonal[offsets[b] + j*rows[b]],
+                                   [](value_type const & d) { return maquis::real(d); });
         }
 
+        /**
+         * @brief Preconditions the residual [r] of the Ritz pair ([theta], [V]).
+         *
+         * Computes r <- (theta - D)^{-1} (r - a/b V), with a = <(theta - D)^{-1} V|r> and
+         * b = <V|(theta - D)^{-1} V>. Both overlaps are accumulated in a first pass over the
+         * blocks, r is then updated in place in a second one, without temporary vectors.
+         */
         void precondition(vector_type& r, vector_type& V, value_type theta)
         {
-        }
-    };
-
-    template<class Matrix, class SymmGroup>
-    class MultDiagonal<Matrix, SymmGroup, symm_traits::enable_if_su2_t<SymmGroup>>
-    {
-        typedef MPSTensor<Matrix, SymmGroup> vector_type;
-        typedef typename Matrix::value_type value_type;
-
-    public:
+            r.make_left_paired();
+            V.make_left_paired();
+            block_matrix<Matrix, SymmGroup> & r_data = r.data();
+            block_matrix<Matrix, SymmGroup> const & V_data = V.data();
+
+            // The blocks of r and V are matched by charge, they may be stored in a different order
+            r_blocks.resize(charges.size());
+            V_blocks.resize(charges.size());
+            for (std::size_t b = 0; b < charges.size(); ++b)
+            {
+                r_blocks[b] = r_data.find_block(charges[b].first, charges[b].second);
+                V_blocks[b] = V_data.find_block(charges[b].first, charges[b].second);
+                assert(r_blocks[b] == r_data.n_blocks() || num_rows(r_data[r_blocks[b]]) == rows[b]);
+                assert(V_blocks[b] == V_data.n_blocks() || num_rows(V_data[V_blocks[b]]) == rows[b]);
+            }
 
-        MultDiagonal(SiteProblem<Matrix, SymmGroup> const& H, vector_type const& x)
-        {
-            Hdiag = contraction::SU2::diagonal_hamiltonian(H.left, H.right, H.mpo, x);
-        }
+            real_type shift = maquis::real(theta);
+            value_type a = 0., b = 0.;
+            for (std::size_t k = 0; k < charges.size(); ++k)
+            {
+                if (V_blocks[k] == V_data.n_blocks())
+                    continue;
+                bool has_r = r_blocks[k] != r_data.n_blocks();
+                for (std::size_t j = 0; j < cols[k]; ++j)
+                {
+                    real_type const * d = &diagonal[offsets[k] + j*rows[k]];
+                    value_type const * v = &V_data[V_blocks[k]](0, j);
+                    value_type const * x = has_r ? &r_data[r_blocks[k]](0, j) : NULL;
+                    for (std::size_t i = 0; i < rows[k]; ++i)
+                    {
+                        value_type w = inverse(shift - d[i]) * v[i];
+                        b += conj_value(v[i]) * w;
+                        if (has_r)
+                            a += conj_value(w) * x[i];
+                    }
+                }
+            }
 
-        void precondition(vector_type& r, vector_type& V, value_type theta)
-        {
-            vector_type Vcpy = V;
-            mult_diag(theta, Vcpy);
-            value_type a = Vcpy.scalar_overlap(r);
-            value_type b = V.scalar_overlap(Vcpy);
-            r -= a/b * V;
-            mult_diag(theta, r);
+            value_type ratio = a/b;
+            for (std::size_t k = 0; k < charges.size(); ++k)
+            {
+                if (r_blocks[k] == r_data.n_blocks())
+                    continue;
+                bool has_V = V_blocks[k] != V_data.n_blocks();
+                for (std::size_t j = 0; j < cols[k]; ++j)
+                {
+                    real_type const * d = &diagonal[offsets[k] + j*rows[k]];
+                    value_type * x = &r_data[r_blocks[k]](0, j);
+                    if (has_V) {
+                        value_type const * v = &V_data[V_blocks[k]](0, j);
+                        for (std::size_t i = 0; i < rows[k]; ++i)
+                            x[i] = inverse(shift - d[i]) * (x[i] - ratio * v[i]);
+                    }
+                    else {
+                        for (std::size_t i = 0; i < rows[k]; ++i)
+                            x[i] *= inverse(shift - d[i]);
+                    }
+                }
+            }
         }
 
     private:
 
-        void mult_diag(value_type theta, vector_type& x)
-        {
-            block_matrix<Matrix, SymmGroup> & data = x.data();
+        // Elements with theta = D are left unchanged
+        static real_type inverse(real_type d) { return d != real_type(0.) ? real_type(1.) / d : real_type(1.); }
 
-            assert(shape_equal(data, Hdiag));
-            for (size_t b = 0; b < data.n_blocks(); ++b)
-            {
-                for (size_t i = 0; i < num_rows(data[b]); ++i)
-                    for (size_t j = 0; j < num_cols(data[b]); ++j)
-                        if (std::abs(theta - Hdiag[b](i,j)))
-                            data[b](i,j) /= (theta - Hdiag[b](i,j));
-            }
+        static value_type conj_value(value_type x)
+        {
+            alps::numeric::conj_inplace(x);
+            return x;
         }
 
-        block_matrix<Matrix, SymmGroup> Hdiag;
+        std::vector<std::pair<charge, charge> > charges;
+        std::vector<std::size_t> rows, cols, offsets;
+        std::vector<real_type> diagonal;
+        // Scratch space, reused at each call
+        std::vector<std::size_t> r_blocks, V_blocks;
     };
 
 } // namespace davidson detail
@@ -181,4 +262,37 @@ solve_ietl_davidson(SiteProblem<Matrix, SymmGroup> & sp,
     return r0;
 }
 
+/**
+ * @brief Lowest [initial.size()] eigenpairs of the site problem, found with the block Davidson solver.
+ *
+ * The eigenvectors are returned in increasing order of the eigenvalues.
+ */
+template<class Matrix, class SymmGroup>
+std::vector<std::pair<double, MPSTensor<Matrix, SymmGroup> > >
+solve_ietl_block_davidson(SiteProblem<Matrix, SymmGroup> & sp,
+                          std::vector<MPSTensor<Matrix, SymmGroup> > const & initial,
+                          BaseParameters & params)
+{
+    assert( !initial.empty() );
+    SingleSiteVS<Matrix, SymmGroup> vs(initial[0], std::vector<MPSTensor<Matrix, SymmGroup> >());
+
+    ietl::block_davidson<SiteProblem<Matrix, SymmGroup>, SingleSiteVS<Matrix, SymmGroup> >
+    bd(sp, vs, initial.size());
+
+    davidson_detail::MultDiagonal<Matrix, SymmGroup> mdiag(sp, initial[0]);
+
+    double tol = params["ietl_jcd_tol"];
+    ietl::basic_iteration<double> iter(params["ietl_jcd_maxiter"], tol, tol);
+    contraction::ContractionGrid<Matrix, SymmGroup>::iterate_reduction_layout(0, params["ietl_jcd_maxiter"]);
+
+    std::vector<std::pair<double, MPSTensor<Matrix, SymmGroup> > > ret = bd.calculate_eigenvalues(initial, mdiag, iter);
+
+    maquis::cout << "Block Davidson used " << iter.iterations() << " iterations for " << initial.size() << " roots." << std::endl;
+
+    if (ret.size() < initial.size())
+        throw std::runtime_error("The block Davidson solver found fewer roots than requested, the site problem is too small");
+
+    return ret;
+}
+
 #endif
@@ -129,10 +129,21 @@ namespace ietl
               MPSTensor<Matrix, SymmGroup> const & x,
               MPSTensor<Matrix, SymmGroup> & y)
     {
-        y = contraction::Engine<Matrix, Matrix, SymmGroup>::site_hamil2(x, H.left, H.right, H.mpo);
+        y = contraction::Engine<Matrix, Matrix, SymmGroup>::site_hamil2(x, H.left, H.right, H.mpo, H.contraction_plan(x));
         x.make_left_paired();
     }
 
+    /** @brief Applies the site Hamiltonian to all the tensors of [x] with a single batched contraction */
+    template<class Matrix, class SymmGroup>
+    void mult(SiteProblem<Matrix, SymmGroup> const & H,
+              std::vector<MPSTensor<Matrix, SymmGroup> > const & x,
+              std::vector<MPSTensor<Matrix, SymmGroup> > & y)
+    {
+        y = contraction::Engine<Matrix, Matrix, SymmGroup>::site_hamil2(x, H.left, H.right, H.mpo);
+        for (std::size_t k = 0; k < x.size(); ++k)
+            x[k].make_left_paired();
+    }
+
     template<class Matrix, class SymmGroup>
     struct vectorspace_traits<SingleSiteVS<Matrix, SymmGroup> >
     {
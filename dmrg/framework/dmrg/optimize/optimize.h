@@ -234,5 +234,6 @@ protected:
 
 #include "ss_optimize.hpp"
 #include "ts_optimize.hpp"
+#include "ts_sa_optimize.hpp"
 
 #endif
@@ -0,0 +1,282 @@
+/*****************************************************************************
+ *
+ * QCMaquis DMRG Project
+ *
+ * Copyright (C) 2021 Laboratory for Physical Chemistry, ETH Zurich
+ *
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef TS_SA_OPTIMIZE_H
+#define TS_SA_OPTIMIZE_H
+
+#include "dmrg/optimize/optimize.h"
+
+#include "dmrg/mp_tensors/twositetensor.h"
+#include "dmrg/mp_tensors/mpo_ops.h"
+
+#include <boost/tuple/tuple.hpp>
+
+#include <numeric>
+
+/**
+ * @brief State-averaged two-site optimizer.
+ *
+ * Targets the [n_sa_states] lowest states at once. The states share all the MPS
+ * tensors but the one carrying the orthogonality center: at each pair of sites, the
+ * block Davidson solver finds all the roots of the same site problem, and the
+ * two-site tensors are split with the density matrix averaged over the states
+ * with the weights [sa_weights]. The first state is stored in [mps], the center
+ * tensors of the other ones are kept by the optimizer, see [state].
+ */
+template<class Matrix, class SymmGroup, class Storage>
+class ts_sa_optimize : public optimizer_base<Matrix, SymmGroup, Storage>
+{
+public:
+    typedef typename Matrix::value_type value_type;
+
+    typedef optimizer_base<Matrix, SymmGroup, Storage> base;
+    using base::mpo;
+    using base::mps;
+    using base::left_;
+    using base::right_;
+    using base::parms;
+    using base::iteration_results_;
+    using base::stop_callback;
+
+    ts_sa_optimize(MPS<Matrix, SymmGroup> & mps_,
+                   MPO<Matrix, SymmGroup> const & mpo_,
+                   BaseParameters & parms_,
+                   boost::function<bool ()> stop_callback_,
+                   const Lattice& lat,
+                   int initial_site_ = 0)
+    : base(mps_, mpo_, parms_, stop_callback_, to_site(mps_.length(), initial_site_))
+    , initial_site((initial_site_ < 0) ? 0 : initial_site_), center_site(-1)
+    {
+        if (base::northo > 0)
+            throw std::runtime_error("State-averaged optimization cannot be combined with ortho_states");
+        if (parms.template get<int>("n_sa_states") < 1)
+            throw std::runtime_error("n_sa_states must be at least 1");
+        n_states_ = parms.template get<int>("n_sa_states");
+        if (parms.is_set("sa_weights"))
+            weights = parms.template get<std::vector<double> >("sa_weights");
+        else
+            weights = std::vector<double>(n_states_, 1.);
+        if (weights.size() != n_states_)
+            throw std::runtime_error("sa_weights must contain one weight per state");
+        double sum = std::accumulate(weights.begin(), weights.end(), 0.);
+        for (double & w : weights)
+            w /= sum;
+
+        parallel::guard::serial guard;
+        make_ts_cache_mpo(mpo, ts_cache_mpo, mps);
+    }
+
+    inline int to_site(const int L, const int i) const
+    {
+        if (i < 0) return 0;
+        /// i, or (L-1) - (i - (L-1))
+        return (i < L-1) ? i : 2*L - 2 - i;
+    }
+
+    /** @brief Number of targeted states */
+    std::size_t n_states() const { return n_states_; }
+
+    /**
+     * @brief MPS of the [k]-th state.
+     *
+     * Shares all the tensors with [mps], except for the center tensor.
+     */
+    MPS<Matrix, SymmGroup> state(std::size_t k) const
+    {
+        MPS<Matrix, SymmGroup> ret = mps;
+        if (k > 0) {
+            if (center_site < 0 || centers.size() != n_states_-1)
+                throw std::runtime_error("The states are available only after a sweep of the state-averaged optimizer");
+            ret[center_site] = centers[k-1];
+        }
+        return ret;
+    }
+
+    void sweep(int sweep, OptimizeDirection d = Both)
+    {
+        std::chrono::high_resolution_clock::time_point sweep_now = std::chrono::high_resolution_clock::now();
+
+        iteration_results_.clear();
+
+        std::size_t L = mps.length();
+
+        int _site = 0, site = 0;
+        if (initial_site != -1) {
+            _site = initial_site;
+            site = to_site(L, _site);
+        }
+
+        for (; _site < 2*L-2; ++_site) {
+
+            int lr, site1, site2;
+            if (_site < L-1) {
+                site = to_site(L, _site);
+                lr = 1;
+                site1 = site;
+                site2 = site+1;
+            } else {
+                site = to_site(L, _site);
+                lr = -1;
+                site1 = site-1;
+                site2 = site;
+            }
+
+            maquis::cout << std::endl;
+            maquis::cout << "Sweep " << sweep << ", optimizing sites " << site1 << " and " << site2
+                         << " for " << n_states_ << " states" << std::endl;
+
+            if (_site != L-1)
+            {
+                Storage::fetch(left_[site1]);
+                Storage::fetch(right_[site2+1]);
+            }
+
+            if (lr == +1) {
+                if (site2+2 < right_.size())
+                    Storage::prefetch(right_[site2+2]);
+            } else {
+                if (site1 > 0)
+                    Storage::prefetch(left_[site1-1]);
+            }
+
+            std::chrono::high_resolution_clock::time_point now, then;
+
+            // Starting guesses: the two-site tensors of all the states
+            std::vector<MPSTensor<Matrix, SymmGroup> > guesses(n_states_);
+            guesses[0] = TwoSiteTensor<Matrix, SymmGroup>(mps[site1], mps[site2]).make_mps();
+            bool have_centers = centers.size() == n_states_-1 && center_site == ((lr == +1) ? site1 : site2);
+            for (std::size_t k = 1; k < n_states_; ++k) {
+                if (have_centers) {
+                    guesses[k] = (lr == +1) ? TwoSiteTensor<Matrix, SymmGroup>(centers[k-1], mps[site2]).make_mps()
+                                            : TwoSiteTensor<Matrix, SymmGroup>(mps[site1], centers[k-1]).make_mps();
+                } else {
+                    guesses[k] = guesses[0];
+                    guesses[k].make_left_paired();
+                    guesses[k].data().generate(static_cast<dmrg_random::value_type(*)()>(&dmrg_random::uniform));
+                }
+            }
+
+            SiteProblem<Matrix, SymmGroup> sp(left_[site1], right_[site2+1], ts_cache_mpo[site1]);
+
+            std::vector<std::pair<double, MPSTensor<Matrix, SymmGroup> > > res;
+            if (d == Both ||
+                (d == LeftOnly && lr == -1) ||
+                (d == RightOnly && lr == +1))
+            {
+                BEGIN_TIMING("BLOCK_DAVIDSON")
+                res = solve_ietl_block_davidson(sp, guesses, parms);
+                END_TIMING("BLOCK_DAVIDSON")
+            }
+            else {
+                for (std::size_t k = 0; k < n_states_; ++k)
+                    res.push_back(std::make_pair(sp.get_energy(guesses[k]), guesses[k]));
+            }
+            guesses.clear();
+
+            double average = 0.;
+            {
+                int prec = maquis::cout.precision();
+                maquis::cout.precision(15);
+                for (std::size_t k = 0; k < n_states_; ++k) {
+                    maquis::cout << "Energy " << lr << " state " << k << " " << res[k].first + mpo.getCoreEnergy() << std::endl;
+                    average += weights[k] * res[k].first;
+                }
+                maquis::cout.precision(prec);
+            }
+            iteration_results_["Energy"] << res[0].first + mpo.getCoreEnergy();
+            iteration_results_["StateAveragedEnergy"] << average + mpo.getCoreEnergy();
+            for (std::size_t k = 1; k < n_states_; ++k)
+                iteration_results_["EnergyState" + std::to_string(k)] << res[k].first + mpo.getCoreEnergy();
+
+            std::vector<TwoSiteTensor<Matrix, SymmGroup> > tst;
+            tst.reserve(n_states_);
+            for (std::size_t k = 0; k < n_states_; ++k) {
+                tst.push_back(TwoSiteTensor<Matrix, SymmGroup>(mps[site1], mps[site2]));
+                tst.back() << res[k].second;
+            }
+            res.clear();
+
+            double cutoff = this->get_cutoff(sweep);
+            std::size_t Mmax = this->get_Mmax(sweep);
+            truncation_results trunc;
+            std::vector<MPSTensor<Matrix, SymmGroup> > state_tensors;
+
+            BEGIN_TIMING("TRUNC")
+            if (lr == +1)
+                boost::tie(mps[site1], state_tensors, trunc) = TwoSiteTensor<Matrix, SymmGroup>::split_averaged_l2r(tst, weights, Mmax, cutoff);
+            else
+                boost::tie(state_tensors, mps[site2], trunc) = TwoSiteTensor<Matrix, SymmGroup>::split_averaged_r2l(tst, weights, Mmax, cutoff);
+            END_TIMING("TRUNC")
+            tst.clear();
+
+            // The center tensor of the first state is stored in the MPS, the other ones are kept aside
+            center_site = (lr == +1) ? site2 : site1;
+            mps[center_site] = state_tensors[0];
+            centers.assign(state_tensors.begin()+1, state_tensors.end());
+
+            if (lr == +1) {
+                if (site1 != L-2)
+                    Storage::drop(right_[site2+1]);
+                this->boundary_left_step(mpo, site1); // creating left_[site2]
+                if (site1 != L-2) {
+                    Storage::evict(mps[site1]);
+                    Storage::evict(left_[site1]);
+                }
+            } else {
+                if (site1 != 0)
+                    Storage::drop(left_[site1]);
+                this->boundary_right_step(mpo, site2); // creating right_[site2]
+                if (site1 != 0) {
+                    Storage::evict(mps[site2]);
+                    Storage::evict(right_[site2+1]);
+                }
+            }
+
+            iteration_results_["BondDimension"]     << trunc.bond_dimension;
+            iteration_results_["TruncatedWeight"]   << trunc.truncated_weight;
+            iteration_results_["TruncatedFraction"] << trunc.truncated_fraction;
+            iteration_results_["SmallestEV"]        << trunc.smallest_ev;
+
+            std::chrono::high_resolution_clock::time_point sweep_then = std::chrono::high_resolution_clock::now();
+            double elapsed = std::chrono::duration<double>(sweep_then - sweep_now).count();
+            maquis::cout << "Sweep has been running for " << elapsed << " seconds." << std::endl;
+
+            if (stop_callback())
+                throw dmrg::time_limit(sweep, _site+1);
+        } // for sites
+        initial_site = -1;
+    } // sweep
+
+private:
+    int initial_site, center_site;
+    std::size_t n_states_;
+    std::vector<double> weights;
+    /* Center tensors of the states 1, ..., n_states-1, at center_site */
+    std::vector<MPSTensor<Matrix, SymmGroup> > centers;
+    MPO<Matrix, SymmGroup> ts_cache_mpo;
+};
+
+#endif
@@ -50,7 +50,8 @@ class interface_sim : public sim<Matrix, SymmGroup>, public abstract_interface_s
     // Types definition
     using base = sim<Matrix, SymmGroup>;
     using interface_base = abstract_interface_sim<Matrix>;
-    using opt_base_t = optimizer_base<Matrix, SymmGroup, storage::disk>;
+    template<class Storage>
+    using opt_base_t = optimizer_base<Matrix, SymmGroup, Storage>;
     using status_type = typename base::status_type;
     using measurements_type = typename base::measurements_type;
     using meas_with_results_type = typename interface_base::meas_with_results_type;
@@ -68,6 +69,7 @@ class interface_sim : public sim<Matrix, SymmGroup>, public abstract_interface_s
     using base::rfile;
     using base::lat;
     using base::model;
+    using base::mpo_coefficients;
 
 public:
 
@@ -97,6 +99,16 @@ public:
 
     /** @brief Runs an optimization calculation */
     void optimize()
+    {
+        if (storage::mmap::enabled())
+            optimize_with_storage<storage::mmap>();
+        else
+            optimize_with_storage<storage::disk>();
+    }
+
+    /** @brief Runs an optimization calculation with a given out-of-core storage policy */
+    template<class Storage>
+    void optimize_with_storage()
     {
         // Reads in input parameters
         int meas_each = parms["measure_each"];
@@ -108,15 +120,21 @@ public:
         if (parms["use_compressed"])
             mpoc.compress(1e-12);
         // Optimizer initialization
-        std::shared_ptr<opt_base_t> optimizer;
+        std::shared_ptr<opt_base_t<Storage> > optimizer;
+        std::shared_ptr<ts_sa_optimize<Matrix, SymmGroup, Storage> > sa_optimizer;
         if (parms["optimization"] == "singlesite") {
-            optimizer.reset( new ss_optimize<Matrix, SymmGroup, storage::disk>
+            optimizer.reset( new ss_optimize<Matrix, SymmGroup, Storage>
                             (mps, mpoc, parms, stop_callback, lat, init_site) );
         }
         else if(parms["optimization"] == "twosite") {
-            optimizer.reset( new ts_optimize<Matrix, SymmGroup, storage::disk>
+            optimizer.reset( new ts_optimize<Matrix, SymmGroup, Storage>
                             (mps, mpoc, parms, stop_callback, lat, init_site) );
         }
+        else if(parms["optimization"] == "twosite_sa") {
+            sa_optimizer.reset( new ts_sa_optimize<Matrix, SymmGroup, Storage>
+                               (mps, mpoc, parms, stop_callback, lat, init_site) );
+            optimizer = sa_optimizer;
+        }
         else {
             throw std::runtime_error("Don't know this optimizer");
         }
@@ -128,7 +146,7 @@ public:
                 // TODO: introduce some timings
 
                 optimizer->sweep(sweep, Both);
-                storage::disk::sync();
+                Storage::sync();
 
                 bool converged = false;
 
@@ -175,14 +193,19 @@ public:
 
                 /// write checkpoint
                 bool stopped = stop_callback() || converged;
-                if (stopped || (sweep+1) % chkp_each == 0 || (sweep+1) == parms["nsweeps"])
+                if (stopped || (sweep+1) % chkp_each == 0 || (sweep+1) == parms["nsweeps"]) {
                     checkpoint_simulation(mps, sweep, -1);
+                    if (sa_optimizer)
+                        checkpoint_sa_states(*sa_optimizer, sweep, -1);
+                }
 
                 if (stopped) break;
             }
         } catch (dmrg::time_limit const& e) {
             maquis::cout << e.what() << " checkpointing partial result." << std::endl;
             checkpoint_simulation(mps, e.sweep(), e.site());
+            if (sa_optimizer)
+                checkpoint_sa_states(*sa_optimizer, e.sweep(), e.site());
 
             {
                 iteration_results_ = optimizer->iteration_results();
@@ -363,13 +386,17 @@ public:
             throw std::runtime_error("updating integrals in the interface not supported yet in the FCIDUMP format");
         parms.set("integrals_binary", chem::serialize(integrals));
 
-        //std::cout << " parms are set (and ints are updated) -> " << std::endl;
-        //std::cout << parms << std::endl;
-
-        // construct new model and mpo with new integrals
-        // hope this doesn't give any memory leaks
-        model = Model<Matrix, SymmGroup>(lat, parms);
-        mpo = make_mpo(lat, model);
+        // Between the macro-iterations of a CASSCF only the values of the integrals change, so the
+        // coefficients of the MPO are rewritten in place. The MPO is rebuilt only if the terms
+        // have different operator strings, e.g., because some integrals fell below the cutoff.
+        Model<Matrix, SymmGroup> new_model(lat, parms);
+        new_model.create_terms();
+        if (!generate_mpo::update_coefficients(mpo, mpo_coefficients, model.hamiltonian_terms(), new_model.hamiltonian_terms()))
+        {
+            generate_mpo::TaggedMPOMaker<Matrix, SymmGroup> mpom(lat, new_model);
+            mpo = mpom.create_mpo(&mpo_coefficients);
+        }
+        model = new_model;
 
         // check if MPS is still OK
         maquis::checks::right_end_check(mps, model.total_quantum_numbers(parms));
@@ -450,6 +477,32 @@ private:
         return base::checkpoint_simulation(state, status);
     }
 
+    /**
+     * @brief Checkpoints the excited states of a state-averaged optimization.
+     *
+     * The k-th state is stored in [chkpfile].state<k>, the ground state goes to the
+     * regular checkpoint.
+     */
+    template<class Storage>
+    void checkpoint_sa_states(ts_sa_optimize<Matrix, SymmGroup, Storage> const& optimizer, int sweep, int site)
+    {
+        if (base::dns || base::chkpfile.empty())
+            return;
+        status_type status;
+        status["sweep"] = sweep;
+        status["site"]  = site;
+        for (std::size_t k = 1; k < optimizer.n_states(); ++k) {
+            std::string state_chkpfile = base::chkpfile + ".state" + std::to_string(k);
+            if (parallel::master() && !boost::filesystem::exists(state_chkpfile))
+                boost::filesystem::create_directory(state_chkpfile);
+            save(state_chkpfile, optimizer.state(k));
+            if (!parallel::master())
+                continue;
+            storage::archive ar(state_chkpfile+"/props.h5", "w");
+            ar["/status"] << status;
+        }
+    }
+
 
 };
 
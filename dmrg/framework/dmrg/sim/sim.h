@@ -99,6 +99,7 @@ protected:
     Model<Matrix, SymmGroup> model;
     MPS<Matrix, SymmGroup> mps;
     MPO<Matrix, SymmGroup> mpo, mpoc;
+    generate_mpo::CoefficientMap<Matrix, SymmGroup> mpo_coefficients;
     measurements_type all_measurements, sweep_measurements;
 };
 
@@ -29,6 +29,7 @@
 #include "dmrg/version.h"
 
 #include "dmrg/block_matrix/symmetry/gsl_coupling.h"
+#include "dmrg/models/chem/binary_integrals.h"
 
 namespace sim_detail {
     // Checks if the parameters in the list parm already exists in parms, if not, loads it from ar
@@ -139,6 +140,10 @@ sim<Matrix, SymmGroup>::sim(DmrgParameters & parms_)
                 parms_toload.push_back("integrals_binary");
             }
             sim_detail::load_if_not_exists(parms_toload, parms, ar_in);
+            // Integrals stored as datasets in the checkpoint
+            if (!parms.is_set("integral_file") && !parms.is_set("integrals") && !parms.is_set("integrals_binary")
+                && ar_in.is_data("/integrals_binary/values"))
+                parms.set("integrals_binary", chem::serialize(chem::detail::load_integral_datasets<typename Matrix::value_type>(ar_in, "/integrals_binary")));
             sim_detail::print_important_parameters<SymmGroup>(parms);
         }
     }
@@ -166,10 +171,29 @@ sim<Matrix, SymmGroup>::sim(DmrgParameters & parms_)
         }
     }
 
+    // Reduction strategy for the site Hamiltonian
+    contraction::common::SiteHamilReduction::set_mode(parms["site_hamil_reduction"].str());
+
+    // SVD algorithm of the truncation
+    SVDSettings::set(parms["svd_algorithm"].str(), parms["randomized_svd_oversampling"].as<int>(), parms["randomized_svd_power_iterations"].as<int>());
+
+    // Construction of the reduced density matrices
+    DensityMatrixSettings::set_product(parms["density_matrix_product"].str());
+
+    // Memory for the operator prefix caches of the RDM measurements
+    measurements::PrefixCacheSettings::set_max_memory(parms["rdm_cache_memory"].as<double>());
+
+    // Slice of the RDM elements evaluated by this process
+    measurements::RDMSlicing::set(parms["rdm_slice"], parms["rdm_slices"]);
+
     // Model initialization
     lat = Lattice(parms);
     model = Model<Matrix, SymmGroup>(lat, parms);
-    mpo = make_mpo(lat, model);
+    // Integrals given in binary form can be updated through the interface, see [interface_sim::update_integrals]
+    if (parms.is_set("integrals_binary"))
+        mpo = make_mpo(lat, model, mpo_coefficients);
+    else
+        mpo = make_mpo(lat, model);
     all_measurements = model.measurements();
     all_measurements << overlap_measurements<Matrix, SymmGroup>(parms);
 
@@ -196,7 +220,17 @@ sim<Matrix, SymmGroup>::sim(DmrgParameters & parms_)
             boost::filesystem::create_directory(chkpfile);
         storage::archive ar(chkpfile+"/props.h5", "w");
 
-        ar["/parameters"] << parms;
+        // The integrals are stored as datasets rather than as a serialized string in the parameters
+        if (parms.is_set("integrals_binary"))
+        {
+            BaseParameters chkp_parms = parms;
+            chkp_parms.erase("integrals_binary");
+            chem::detail::save_integral_datasets(ar, "/integrals_binary",
+                chem::deserialize<typename Matrix::value_type>(parms["integrals_binary"].as<std::string>()));
+            ar["/parameters"] << chkp_parms;
+        }
+        else
+            ar["/parameters"] << parms;
         ar["/version"] << DMRG_VERSION_STRING;
     }
 
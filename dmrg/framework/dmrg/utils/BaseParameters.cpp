@@ -262,6 +262,7 @@
 
     template std::vector<int> BaseParameters::get<std::vector<int> >(std::string const & key);
     template std::vector<unsigned long> BaseParameters::get<std::vector<unsigned long> >(std::string const & key);
+    template std::vector<double> BaseParameters::get<std::vector<double> >(std::string const & key);
 
     template void BaseParameters::print_description(std::ostream& os) const;
 
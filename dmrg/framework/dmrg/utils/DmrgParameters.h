@@ -60,7 +60,7 @@ private:
         add_option("max_bond_dimension", "");
         add_option("sweep_bond_dimensions", "");
 
-        add_option("optimization", "singlesite or twosite", value("twosite"));
+        add_option("optimization", "singlesite, twosite or twosite_sa (state-averaged)", value("twosite"));
         add_option("twosite_truncation", "`svd` on the two-site mps or `heev` on the reduced density matrix (with alpha factor)", value("svd"));
 
         add_option("alpha_initial","", value(1e-2));
@@ -71,6 +71,11 @@ private:
         add_option("ietl_jcd_tol", "", value(1e-8));
         add_option("ietl_jcd_gmres", "", value(0));
         add_option("ietl_jcd_maxiter", "", value(10));
+        add_option("site_hamil_reduction", "`critical` or `threadlocal` accumulation of the site Hamiltonian output blocks across OpenMP threads", value("critical"));
+        add_option("svd_algorithm", "`full` or `randomized` SVD of the blocks which are much larger than the maximum bond dimension in the truncation", value("full"));
+        add_option("randomized_svd_oversampling", "number of additional random vectors of the randomized SVD", 10);
+        add_option("randomized_svd_power_iterations", "number of subspace iterations of the randomized SVD", 2);
+        add_option("density_matrix_product", "`gemm` or `herk` (symmetric rank-k update) construction of the reduced density matrices of the two-site splits", value("gemm"));
 
         add_option("nsweeps", "");
         add_option("nmainsweeps", "", 0);
@@ -83,9 +88,17 @@ private:
         add_option("run_seconds", "", value(0));
         add_option("storagedir", "", value(""));
         add_option("use_compressed", "", value(0));
+        add_option("storage_backend", "`disk` (asynchronous file I/O) or `mmap` (memory-mapped files) temporary storage", value("disk"));
+        add_option("storage_io_threads", "number of threads performing the I/O of the temporary storage", value(1));
+        add_option("storage_queue_size", "maximum number of pending I/O requests of the temporary storage", value(8));
+        add_option("storage_compression", "compress the files of the temporary storage (requires zlib)", value(0));
+        add_option("storage_memory_budget", "memory (in MB) that boundaries can occupy before being written to the temporary storage, 0 writes them immediately", value(0));
         add_option("seed", "", value(42));
         add_option("ALWAYS_MEASURE", "comma separated list of measurements", value(""));
         add_option("measure_each", "", value(1));
+        add_option("rdm_cache_memory", "memory (in MB) of the boundaries cached for RDM elements sharing their first operators, 0 disables the caching", value(0));
+        add_option("rdm_slices", "number of slices into which the elements of the RDM measurements are partitioned, each slice can be evaluated by an independent process", value(1));
+        add_option("rdm_slice", "index (starting from 0) of the slice of RDM elements evaluated by this process", value(0));
         add_option("chkp_each", "", value(1));
         add_option("update_each", "", value(-1));
         add_option("entanglement_spectra", "", value(0));
@@ -93,6 +106,7 @@ private:
 
         // TD-related parameters
         add_option("propagator_accuracy", "Accuracy of the iterative approximation of the time-evolution operator", value(1.0E-10));
+        add_option("propagator_two_pass", "Equal to yes to regenerate the Krylov vectors of the Lanczos propagator in a second pass instead of storing them", value("no"));
         add_option("time_step", "Time-step for the TD-DMRG propagation");
         add_option("hamiltonian_units", "Units in which the SQ Hamiltonian is expressed", value("Hartree"));
         add_option("time_units", "Units in which the time-step is expressed");
@@ -123,6 +137,8 @@ private:
         add_option("NUMBER_EIGENVALUES", "", value(1));
         add_option("n_ortho_states", "", value(0));
         add_option("ortho_states", "comma separated list of filenames", "");
+        add_option("n_sa_states", "number of states targeted by the state-averaged optimization", value(2));
+        add_option("sa_weights", "comma separated list of the weights of the states in the state-averaged optimization, equal weights if empty", "");
 
         add_option("MEASURE[Energy]", "", value(true));
         add_option("MEASURE[EnergyVariance]", "", value(0));
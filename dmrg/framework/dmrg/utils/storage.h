@@ -34,6 +34,10 @@
 
 #include <iostream>
 #include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <set>
 
 #include "utils.hpp"
 #include "utils/timings.h"
@@ -41,6 +45,7 @@
 #include "dmrg/utils/BaseParameters.h"
 #include "dmrg/utils/parallel/tracking.hpp"
 #include "dmrg/utils/parallel.hpp"
+#include "dmrg/utils/storage_io.h"
 
 #ifdef HAVE_ALPS_HDF5
 #include "dmrg/utils/archive.h"
@@ -99,16 +104,16 @@ namespace storage {
     template<class Matrix, class SymmGroup>
     class evict_request< Boundary<Matrix, SymmGroup> > {
     public:
-        evict_request(std::string fp, Boundary<Matrix, SymmGroup>* ptr) : fp(fp), ptr(ptr) { }
+        evict_request(std::string fp, Boundary<Matrix, SymmGroup>* ptr, bool compress = false) : fp(fp), ptr(ptr), compress(compress) { }
         void operator()(){
-            std::ofstream ofs(fp.c_str(), std::ofstream::binary);
             Boundary<Matrix, SymmGroup>& o = *ptr;
             size_t loop_max = o.aux_dim();
+#ifdef USE_AMBIENT
+            std::ofstream ofs(fp.c_str(), std::ofstream::binary);
             for(size_t b = 0; b < loop_max; ++b){
                 assert( o[b].reasonable() );
                 for (std::size_t k = 0; k < o[b].n_blocks(); ++k){
                     Matrix& m = o[b][k];
-#ifdef USE_AMBIENT
                     for(int j = 0; j < m.nt; ++j)
                     for(int i = 0; i < m.mt; ++i){
                         if(ambient::weak(m.tile(i,j))) continue;
@@ -119,19 +124,30 @@ namespace storage {
                         std::free(data);
                         ambient::ext::naked(m.tile(i,j)).data = NULL;
                     }
+                }
+            }
+            ofs.close();
 #else
+            // All the blocks are gathered in a single buffer, which is then written at once
+            typedef typename Matrix::value_type value_type;
+            std::vector<char> buffer;
+            buffer.reserve(size_of(o));
+            for(size_t b = 0; b < loop_max; ++b){
+                assert( o[b].reasonable() );
+                for (std::size_t k = 0; k < o[b].n_blocks(); ++k){
+                    Matrix& m = o[b][k];
                     for (std::size_t c = 0; c < num_cols(m); ++c)
-                        ofs.write((char*)(&m(0, c)), num_rows(m)*
-                                 sizeof(typename Matrix::value_type)/sizeof(char));
+                        buffer.insert(buffer.end(), (char*)(&m(0, c)), (char*)(&m(0, c)) + num_rows(m)*sizeof(value_type));
                     m = Matrix();
-#endif
                 }
             }
-            ofs.close();
+            detail::write_buffer(fp, buffer, compress, detail::shuffle_word_size<value_type>());
+#endif
         }
     private:
         std::string fp;
         Boundary<Matrix, SymmGroup>* ptr;
+        bool compress;
     };
 
     template<class Matrix, class SymmGroup>
@@ -139,12 +155,12 @@ namespace storage {
     public:
         fetch_request(std::string fp, Boundary<Matrix, SymmGroup>* ptr) : fp(fp), ptr(ptr) { }
         void operator()(){
-            std::ifstream ifs(fp.c_str(), std::ifstream::binary);
             Boundary<Matrix, SymmGroup>& o = *ptr;
             size_t loop_max = o.aux_dim();
+#ifdef USE_AMBIENT
+            std::ifstream ifs(fp.c_str(), std::ifstream::binary);
             for(size_t b = 0; b < loop_max; ++b){
                 for (std::size_t k = 0; k < o[b].n_blocks(); ++k){
-#ifdef USE_AMBIENT
                     Matrix& m = o[b][k];
                     for(int j = 0; j < m.nt; ++j)
                     for(int i = 0; i < m.mt; ++i){
@@ -154,16 +170,26 @@ namespace storage {
                         ifs.read((char*)ambient::ext::naked(m.tile(i,j)), m.tile(i,j).num_cols() * m.tile(i,j).num_rows() *
                                  sizeof(typename Matrix::value_type)/sizeof(char));
                     }
+                }
+            }
+            ifs.close();
 #else
+            std::vector<char> buffer;
+            detail::read_buffer(fp, buffer);
+            std::size_t offset = 0;
+            for(size_t b = 0; b < loop_max; ++b){
+                for (std::size_t k = 0; k < o[b].n_blocks(); ++k){
                     o[b][k] = Matrix(o[b].left_basis()[k].second,
                                      o[b].right_basis()[k].second);
                     Matrix& m = o[b][k];
-                    ifs.read((char*)(&m(0,0)), num_cols(m)*num_rows(m)*
-                             sizeof(typename Matrix::value_type)/sizeof(char));
-#endif
+                    std::size_t n_bytes = num_cols(m)*num_rows(m)*sizeof(typename Matrix::value_type);
+                    if (n_bytes == 0) continue;
+                    assert( offset + n_bytes <= buffer.size() );
+                    std::memcpy((char*)(&m(0,0)), buffer.data() + offset, n_bytes);
+                    offset += n_bytes;
                 }
             }
-            ifs.close();
+#endif
         }
     private:
         std::string fp;
@@ -197,45 +223,121 @@ namespace storage {
         Boundary<Matrix, SymmGroup>* ptr;
     };
 
+    template<class T> class map_request {};
+    template<class T> class unmap_request {};
+
+    template<class Matrix, class SymmGroup>
+    class map_request< Boundary<Matrix, SymmGroup> > {
+    public:
+        map_request(detail::mapped_file* file, Boundary<Matrix, SymmGroup>* ptr) : file(file), ptr(ptr) { }
+        void operator()(){
+#ifdef USE_AMBIENT
+            throw std::runtime_error("Memory-mapped storage is not supported with ambient");
+#else
+            Boundary<Matrix, SymmGroup>& o = *ptr;
+            char* dst = file->data();
+            for(size_t b = 0; b < o.aux_dim(); ++b){
+                for (std::size_t k = 0; k < o[b].n_blocks(); ++k){
+                    Matrix& m = o[b][k];
+                    std::size_t n_bytes = num_rows(m)*sizeof(typename Matrix::value_type);
+                    for (std::size_t c = 0; c < num_cols(m); ++c, dst += n_bytes)
+                        std::memcpy(dst, (char*)(&m(0, c)), n_bytes);
+                    m = Matrix();
+                }
+            }
+#endif
+        }
+    private:
+        detail::mapped_file* file;
+        Boundary<Matrix, SymmGroup>* ptr;
+    };
+
+    template<class Matrix, class SymmGroup>
+    class unmap_request< Boundary<Matrix, SymmGroup> > {
+    public:
+        unmap_request(detail::mapped_file* file, Boundary<Matrix, SymmGroup>* ptr) : file(file), ptr(ptr) { }
+        void operator()(){
+#ifdef USE_AMBIENT
+            throw std::runtime_error("Memory-mapped storage is not supported with ambient");
+#else
+            Boundary<Matrix, SymmGroup>& o = *ptr;
+            char const* src = file->data();
+            for(size_t b = 0; b < o.aux_dim(); ++b){
+                for (std::size_t k = 0; k < o[b].n_blocks(); ++k){
+                    o[b][k] = Matrix(o[b].left_basis()[k].second,
+                                     o[b].right_basis()[k].second);
+                    Matrix& m = o[b][k];
+                    std::size_t n_bytes = num_cols(m)*num_rows(m)*sizeof(typename Matrix::value_type);
+                    if (n_bytes == 0) continue;
+                    std::memcpy((char*)(&m(0,0)), src, n_bytes);
+                    src += n_bytes;
+                }
+            }
+#endif
+        }
+    private:
+        detail::mapped_file* file;
+        Boundary<Matrix, SymmGroup>* ptr;
+    };
+
+    /**
+     * @brief Out-of-core storage of the boundaries.
+     *
+     * The transfers between memory and disk are executed asynchronously by a persistent
+     * pool of I/O threads with a bounded queue of pending requests. Each object is
+     * stored in a single file, optionally compressed.
+     * If a memory budget is set, [evict] does not write the object immediately, but
+     * keeps it in memory as long as the total size of the evicted-but-resident objects
+     * fits in the budget. When the budget is exceeded, the objects that have been
+     * evicted the longest time ago (i.e. the farthest ones along the sweep) and the
+     * largest ones are written to disk first.
+     */
     class disk : public nop {
     public:
         class descriptor {
         public:
-            descriptor() : state(core), dumped(false), sid(disk::index()), worker(NULL) {}
+            descriptor() : state(core), dumped(false), sid(disk::index()) {}
            ~descriptor(){
-                this->join();
+                try {
+                    this->join();
+                } catch (std::exception & e) {
+                    maquis::cerr << "Error in the temporary storage: " << e.what() << std::endl;
+                }
             }
-            void thread(boost::thread* t){
-                this->worker = t;
+            void submit(std::function<void()> request){
+                this->pending = disk::pool().submit(request);
                 disk::track(this);
             }
             void join(){
-                if(this->worker){
-                    this->worker->join();
-                    delete this->worker;
-                    this->worker = NULL;
+                if(this->pending.valid()){
+                    std::shared_future<void> request = this->pending;
+                    this->pending = std::shared_future<void>();
                     disk::untrack(this);
+                    request.get();
                 }
             }
             enum { core, storing, uncore, prefetching } state;
             bool dumped;
             size_t sid;
-            boost::thread* worker;
-            size_t record;
+            std::shared_future<void> pending;
+            std::shared_ptr<detail::mapped_file> mapping; // used by the [mmap] storage
         };
 
         template<class T> class serializable : public descriptor {
         public: 
             ~serializable(){
+                disk::undefer(this);
                 if (dumped) std::remove(disk::fp(sid).c_str()); // only delete existing file, too slow otherwise on NFS or similar
             }
             serializable& operator = (const serializable& rhs){
+                disk::undefer(this);
                 this->join();
                 if(dumped) std::remove(disk::fp(sid).c_str());
                 descriptor::operator=(rhs);
                 return *this;
             }
             void fetch(){
+                disk::undefer(this);
                 if(this->state == core) return;
                 else if(this->state == prefetching) this->join();
                 assert(this->state != storing); // isn't prefetched prior load
@@ -243,43 +345,85 @@ namespace storage {
                 this->state = core;
             }
             void prefetch(){
+                disk::undefer(this);
                 if(this->state == core) return;
                 else if(this->state == prefetching) return;
                 else if(this->state == storing) this->join();
 
                 state = prefetching;
-                this->thread(new boost::thread(fetch_request<T>(disk::fp(sid), (T*)this)));
+                this->submit(fetch_request<T>(disk::fp(sid), (T*)this));
             }
             void evict(){
                 if(state == core){
-                    state = storing;
-                    dumped = true;
-                    parallel::sync();
-                    this->thread(new boost::thread(evict_request<T>(disk::fp(sid), (T*)this)));
+                    if(disk::budget() > 0){
+                        if(!disk::deferred(this))
+                            disk::defer(this, size_of(*(T*)this), [this](){ this->store(); });
+                    }
+                    else
+                        this->store();
                 }
                 assert(this->state != prefetching); // evict of prefetched
             }
             void drop(){
+                disk::undefer(this);
                 if(dumped) std::remove(disk::fp(sid).c_str());
                 if(state == core) drop_request<T>(disk::fp(sid), (T*)this)();
                 assert(this->state != storing);     // drop of already stored data
                 assert(this->state != uncore);      // drop of already stored data
                 assert(this->state != prefetching); // drop of prefetched data
             }
+        private:
+            void store(){
+                state = storing;
+                dumped = true;
+                parallel::sync();
+                this->submit(evict_request<T>(disk::fp(sid), (T*)this, disk::compression()));
+            }
         };
 
         static disk& instance(){
             static disk singleton;
             return singleton;
         }
-        static void init(const std::string& path){
-            maquis::cout << "Temporary storage enabled in " << path << "\n";
+        /**
+         * @brief Enables the storage.
+         * @param path directory where the files are written
+         * @param io_threads number of I/O threads
+         * @param queue_size maximum number of pending I/O requests
+         * @param compression if true, the files are compressed
+         * @param budget memory (in bytes) that evicted objects can occupy before being written to disk
+         */
+        static void init(const std::string& path, std::size_t io_threads = 1, std::size_t queue_size = 8,
+                         bool compression = false, std::size_t budget = 0){
+            if (compression && !detail::compression_available()) {
+                maquis::cout << "Compression of the temporary storage not available, storing uncompressed data\n";
+                compression = false;
+            }
+            maquis::cout << "Temporary storage enabled in " << path << " (" << io_threads << " I/O threads"
+                         << (compression ? ", compressed" : "");
+            if (budget > 0)
+                maquis::cout << ", memory budget " << budget/1024/1024 << " MB";
+            maquis::cout << ")\n";
             instance().active = true;
             instance().path = path;
+            instance().compress = compression;
+            instance().budget_ = budget;
+            instance().pool_.reset(new detail::io_pool(io_threads, queue_size));
         }
         static bool enabled(){
             return instance().active;
         }
+        static bool compression(){
+            return instance().compress;
+        }
+        static std::size_t budget(){
+            return instance().budget_;
+        }
+        static detail::io_pool& pool(){
+            if(!instance().pool_)
+                instance().pool_.reset(new detail::io_pool(1, 8));
+            return *instance().pool_;
+        }
         static std::string fp(size_t sid){
             return (instance().path + boost::lexical_cast<std::string>(sid));
         }
@@ -287,16 +431,44 @@ namespace storage {
             return instance().sid++;
         }
         static void track(descriptor* d){ 
-            d->record = instance().queue.size();
-            instance().queue.push_back(d);
+            instance().queue.insert(d);
         }
         static void untrack(descriptor* d){ 
-            instance().queue[d->record] = NULL;
+            instance().queue.erase(d);
         }
         static void sync(){
-            for(int i = 0; i < instance().queue.size(); ++i)
-                if(instance().queue[i]) instance().queue[i]->join();
-            instance().queue.clear();
+            std::set<descriptor*> pending = instance().queue;
+            for(descriptor* d : pending)
+                d->join();
+        }
+        /** @brief Keeps an evicted object in memory, writes the least useful ones if the budget is exceeded */
+        static void defer(descriptor* d, std::size_t size, std::function<void()> store){
+            disk& s = instance();
+            s.resident.push_back(resident_entry{d, size, ++s.clock, store});
+            s.resident_size += size;
+            while(s.resident_size > s.budget_ && !s.resident.empty()){
+                auto victim = std::max_element(s.resident.begin(), s.resident.end(),
+                                               [&s](resident_entry const& a, resident_entry const& b){
+                                                   return s.score(a) < s.score(b);
+                                               });
+                std::function<void()> victim_store = victim->store;
+                s.resident_size -= victim->size;
+                s.resident.erase(victim);
+                victim_store();
+            }
+        }
+        static bool deferred(descriptor* d){
+            disk& s = instance();
+            return std::any_of(s.resident.begin(), s.resident.end(), [d](resident_entry const& e){ return e.d == d; });
+        }
+        static void undefer(descriptor* d){
+            disk& s = instance();
+            for(auto it = s.resident.begin(); it != s.resident.end(); ++it)
+                if(it->d == d){
+                    s.resident_size -= it->size;
+                    s.resident.erase(it);
+                    return;
+                }
         }
         template<class T> static void fetch(serializable<T>& t)   { if(enabled()) t.fetch();    }
         template<class T> static void prefetch(serializable<T>& t){ if(enabled()) t.prefetch(); }
@@ -307,11 +479,88 @@ namespace storage {
         template<class Matrix, class SymmGroup> 
         static void evict(MPSTensor<Matrix, SymmGroup>& t){ }
 
-        disk() : active(false), sid(0) {}
-        std::vector<descriptor*> queue;
+        disk() : active(false), compress(false), sid(0), budget_(0), resident_size(0), clock(0) {}
+        std::set<descriptor*> queue;
         std::string path;
-        bool active; 
+        bool active;
+        bool compress;
         size_t sid;
+    private:
+        struct resident_entry {
+            descriptor* d;
+            std::size_t size;
+            std::size_t stamp;
+            std::function<void()> store;
+        };
+        // Objects evicted earlier are needed later in the sweep, large objects free more memory
+        double score(resident_entry const& e) const {
+            return double(clock - e.stamp + 1) * double(e.size);
+        }
+        std::unique_ptr<detail::io_pool> pool_;
+        std::size_t budget_, resident_size, clock;
+        std::list<resident_entry> resident;
+    };
+
+    /**
+     * @brief Out-of-core storage of the boundaries based on memory-mapped files.
+     *
+     * [evict] copies the object in a shared mapping of a file and releases the heap
+     * memory, the kernel writes the pages back to disk when it needs memory.
+     * [prefetch] only advises the kernel to read the pages in, so that no I/O thread
+     * is needed, and [fetch] copies the data back into the matrices and releases the
+     * mapping. This policy uses the same descriptor as [disk], and it can be used as
+     * [Storage] template parameter of the optimizers.
+     */
+    class mmap : public nop {
+    public:
+        static mmap& instance(){
+            static mmap singleton;
+            return singleton;
+        }
+        static void init(const std::string& path){
+            maquis::cout << "Memory-mapped temporary storage enabled in " << path << "\n";
+            instance().active = true;
+            instance().path = path;
+        }
+        static bool enabled(){
+            return instance().active;
+        }
+        static std::string fp(){
+            return instance().path + "mmap_" + boost::lexical_cast<std::string>(instance().counter++);
+        }
+        template<class T> static void fetch(disk::serializable<T>& t){
+            if(!enabled() || t.state == disk::descriptor::core) return;
+            unmap_request<T>(t.mapping.get(), static_cast<T*>(&t))();
+            t.mapping.reset();
+            t.state = disk::descriptor::core;
+        }
+        template<class T> static void prefetch(disk::serializable<T>& t){
+            if(!enabled() || t.state != disk::descriptor::uncore) return;
+            t.mapping->will_need();
+            t.state = disk::descriptor::prefetching;
+        }
+        template<class T> static void evict(disk::serializable<T>& t){
+            if(!enabled() || t.state != disk::descriptor::core) return;
+            t.mapping = std::make_shared<detail::mapped_file>(fp(), size_of(static_cast<T&>(t)));
+            map_request<T>(t.mapping.get(), static_cast<T*>(&t))();
+            t.mapping->flush();
+            t.state = disk::descriptor::uncore;
+        }
+        template<class T> static void drop(disk::serializable<T>& t){
+            if(!enabled()) return;
+            if(t.state == disk::descriptor::core) drop_request<T>(std::string(), static_cast<T*>(&t))();
+            t.mapping.reset();
+            t.state = disk::descriptor::core;
+        }
+        template<class T> static void pin(disk::serializable<T>& t){ }
+
+        template<class Matrix, class SymmGroup>
+        static void evict(MPSTensor<Matrix, SymmGroup>& t){ }
+
+        mmap() : active(false), counter(0) {}
+        std::string path;
+        bool active;
+        size_t counter;
     };
 
 #ifdef USE_AMBIENT
@@ -355,7 +604,13 @@ namespace storage {
                 maquis::cerr << "Error creating dir/file at " << dp << ". Try different 'storagedir'.\n";
                 throw;
             }
-            storage::disk::init(dp.string());
+            if(parms["storage_backend"] == "mmap"){
+                storage::mmap::init(dp.string());
+            }else{
+                std::size_t budget = static_cast<std::size_t>(parms["storage_memory_budget"].as<double>()*1024*1024);
+                storage::disk::init(dp.string(), parms["storage_io_threads"], parms["storage_queue_size"],
+                                    parms["storage_compression"], budget);
+            }
         }else{
             maquis::cout << "Temporary storage is disabled\n";
         }
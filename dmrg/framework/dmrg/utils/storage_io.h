@@ -0,0 +1,318 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+#ifndef STORAGE_IO_H
+#define STORAGE_IO_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace storage {
+    namespace detail {
+
+    /**
+     * @brief Persistent pool of I/O threads.
+     *
+     * Tasks are executed in submission order by a fixed number of workers. The queue
+     * of pending tasks is bounded: [submit] blocks when [max_queue] tasks are waiting,
+     * so that the computation cannot run arbitrarily ahead of the disk.
+     */
+    class io_pool
+    {
+    public:
+        io_pool(std::size_t n_threads, std::size_t max_queue)
+            : max_queue_(std::max<std::size_t>(max_queue, 1)), stop_(false)
+        {
+            for (std::size_t i = 0; i < std::max<std::size_t>(n_threads, 1); ++i)
+                workers_.emplace_back(&io_pool::work, this);
+        }
+
+        ~io_pool()
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            task_available_.notify_all();
+            for (auto& w : workers_)
+                w.join();
+        }
+
+        io_pool(io_pool const&) = delete;
+        io_pool& operator=(io_pool const&) = delete;
+
+        /** @brief Enqueues a task, the returned future becomes ready when the task is done */
+        std::shared_future<void> submit(std::function<void()> task)
+        {
+            std::packaged_task<void()> packaged(std::move(task));
+            std::shared_future<void> ret = packaged.get_future().share();
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                space_available_.wait(lock, [this]{ return tasks_.size() < max_queue_; });
+                tasks_.push_back(std::move(packaged));
+            }
+            task_available_.notify_one();
+            return ret;
+        }
+
+        std::size_t n_threads() const { return workers_.size(); }
+        std::size_t max_queue() const { return max_queue_; }
+
+    private:
+        void work()
+        {
+            while (true) {
+                std::packaged_task<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    task_available_.wait(lock, [this]{ return stop_ || !tasks_.empty(); });
+                    if (tasks_.empty())
+                        return;
+                    task = std::move(tasks_.front());
+                    tasks_.pop_front();
+                }
+                space_available_.notify_one();
+                // Exceptions are stored in the shared state and rethrown by the waiting thread
+                task();
+            }
+        }
+
+        std::size_t max_queue_;
+        bool stop_;
+        std::deque<std::packaged_task<void()> > tasks_;
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable task_available_, space_available_;
+    };
+
+    /**
+     * @brief Header of a storage file.
+     * [raw_size] is the size of the serialized data, [stored_size] the number of bytes
+     * following the header, which differs from [raw_size] if the data is compressed.
+     */
+    struct file_header
+    {
+        std::uint64_t raw_size;
+        std::uint64_t stored_size;
+        std::uint32_t compressed;
+        std::uint32_t word_size;
+    };
+
+    /** @brief true if the library has been compiled with compression support */
+    inline bool compression_available()
+    {
+#ifdef HAVE_ZLIB
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * @brief Byte-shuffle of an array of words of size [word_size].
+     * Groups the i-th byte of all the words together. Exponents and high mantissa bytes
+     * of floating point numbers are very repetitive, so that shuffling makes the
+     * buffer much more compressible.
+     */
+    inline void shuffle(std::vector<char> const & in, std::vector<char> & out, std::size_t word_size)
+    {
+        std::size_t n_words = in.size() / word_size;
+        out.resize(in.size());
+        for (std::size_t i = 0; i < n_words; ++i)
+            for (std::size_t b = 0; b < word_size; ++b)
+                out[b*n_words + i] = in[i*word_size + b];
+        std::memcpy(out.data() + n_words*word_size, in.data() + n_words*word_size, in.size() - n_words*word_size);
+    }
+
+    /** @brief Inverse of [shuffle] */
+    inline void unshuffle(std::vector<char> const & in, std::vector<char> & out, std::size_t word_size)
+    {
+        std::size_t n_words = in.size() / word_size;
+        out.resize(in.size());
+        for (std::size_t i = 0; i < n_words; ++i)
+            for (std::size_t b = 0; b < word_size; ++b)
+                out[i*word_size + b] = in[b*n_words + i];
+        std::memcpy(out.data() + n_words*word_size, in.data() + n_words*word_size, in.size() - n_words*word_size);
+    }
+
+    /** @brief Size of the words used to shuffle the bytes of a buffer of [T] */
+    template<class T>
+    std::size_t shuffle_word_size() { return (sizeof(T) % sizeof(double) == 0) ? sizeof(double) : sizeof(T); }
+
+    /**
+     * @brief Writes a buffer to file with a single write call.
+     * If [compress] is true (and compression is available), the buffer is byte-shuffled
+     * and compressed with the fastest zlib level. The compressed data is kept only if
+     * it is actually smaller than the original one.
+     */
+    inline void write_buffer(std::string const & fp, std::vector<char> const & buffer, bool compress, std::size_t word_size)
+    {
+        file_header header{buffer.size(), buffer.size(), 0, static_cast<std::uint32_t>(word_size)};
+        std::vector<char> compressed;
+#ifdef HAVE_ZLIB
+        if (compress && buffer.size() > 0) {
+            std::vector<char> shuffled;
+            shuffle(buffer, shuffled, word_size);
+            uLongf compressed_size = compressBound(shuffled.size());
+            compressed.resize(compressed_size);
+            if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size,
+                          reinterpret_cast<Bytef const*>(shuffled.data()), shuffled.size(), Z_BEST_SPEED) == Z_OK
+                && compressed_size < buffer.size()) {
+                compressed.resize(compressed_size);
+                header.stored_size = compressed_size;
+                header.compressed = 1;
+            }
+            else {
+                compressed.clear();
+            }
+        }
+#endif
+        std::vector<char> const & data = header.compressed ? compressed : buffer;
+        std::ofstream ofs(fp.c_str(), std::ofstream::binary);
+        ofs.write(reinterpret_cast<char const*>(&header), sizeof(header));
+        ofs.write(data.data(), data.size());
+        ofs.close();
+        if (!ofs)
+            throw std::runtime_error("Error writing the temporary storage file " + fp);
+    }
+
+    /** @brief Reads a buffer written by [write_buffer] */
+    inline void read_buffer(std::string const & fp, std::vector<char> & buffer)
+    {
+        std::ifstream ifs(fp.c_str(), std::ifstream::binary);
+        file_header header;
+        ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!ifs)
+            throw std::runtime_error("Error reading the temporary storage file " + fp);
+        if (!header.compressed) {
+            buffer.resize(header.raw_size);
+            ifs.read(buffer.data(), buffer.size());
+        }
+        else {
+#ifdef HAVE_ZLIB
+            std::vector<char> compressed(header.stored_size), shuffled(header.raw_size);
+            ifs.read(compressed.data(), compressed.size());
+            uLongf raw_size = header.raw_size;
+            if (uncompress(reinterpret_cast<Bytef*>(shuffled.data()), &raw_size,
+                           reinterpret_cast<Bytef const*>(compressed.data()), compressed.size()) != Z_OK
+                || raw_size != header.raw_size)
+                throw std::runtime_error("Error decompressing the temporary storage file " + fp);
+            unshuffle(shuffled, buffer, header.word_size);
+#else
+            throw std::runtime_error("Temporary storage file " + fp + " is compressed, but compression is not available");
+#endif
+        }
+        if (!ifs)
+            throw std::runtime_error("Error reading the temporary storage file " + fp);
+    }
+
+    /**
+     * @brief File of fixed size mapped in memory.
+     *
+     * The mapping is shared, so that the kernel writes the modified pages back to the
+     * file and reads them in again on demand. The file is removed when the object
+     * is destroyed.
+     */
+    class mapped_file
+    {
+    public:
+        mapped_file(std::string const & fp, std::size_t size) : fp_(fp), size_(size), data_(NULL)
+        {
+            int fd = ::open(fp_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+            if (fd < 0)
+                throw std::runtime_error("Error creating the temporary storage file " + fp_);
+            if (size_ > 0) {
+                void* ptr = MAP_FAILED;
+                if (::ftruncate(fd, size_) == 0)
+                    ptr = ::mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if (ptr == MAP_FAILED) {
+                    ::close(fd);
+                    std::remove(fp_.c_str());
+                    throw std::runtime_error("Error mapping the temporary storage file " + fp_);
+                }
+                data_ = static_cast<char*>(ptr);
+            }
+            // The mapping stays valid after closing the descriptor
+            ::close(fd);
+        }
+
+        ~mapped_file()
+        {
+            if (data_)
+                ::munmap(data_, size_);
+            std::remove(fp_.c_str());
+        }
+
+        mapped_file(mapped_file const&) = delete;
+        mapped_file& operator=(mapped_file const&) = delete;
+
+        char* data() { return data_; }
+        std::size_t size() const { return size_; }
+
+        /** @brief Starts the write-back of the modified pages without waiting for it */
+        void flush()
+        {
+            if (data_)
+                ::msync(data_, size_, MS_ASYNC);
+        }
+
+        /** @brief Tells the kernel that the data will be needed soon, so that it is read in asynchronously */
+        void will_need()
+        {
+            if (data_)
+                ::posix_madvise(data_, size_, POSIX_MADV_WILLNEED);
+        }
+
+    private:
+        std::string fp_;
+        std::size_t size_;
+        char* data_;
+    };
+
+    } // namespace detail
+} // namespace storage
+
+#endif
@@ -170,6 +170,19 @@ namespace chem {
         return ss.str();
     }
 
+    // Deserialize the integrals from a string generated by serialize()
+
+    template <class V, Hamiltonian HamiltonianType=Hamiltonian::Electronic>
+    integral_map<V, HamiltonianType> deserialize(const std::string& s)
+    {
+        integral_map<V, HamiltonianType> ints;
+        std::stringstream ss(s);
+        boost::archive::text_iarchive ia{ss};
+        ia >> ints;
+
+        return ints;
+    }
+
 }
 
 #endif
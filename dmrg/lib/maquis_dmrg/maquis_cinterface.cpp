@@ -35,6 +35,7 @@
 #include "starting_guess.h"
 #include "dmrg/utils/stdout_redirector.hpp"
 #include "dmrg/models/measurements/measurements_details.h" // for 4-RDM functions
+#include "dmrg/models/measurements/rdm_slicing.h"
 
 std::unique_ptr<maquis::DMRGInterface<double> > interface_ptr;
 DmrgParameters parms;
@@ -341,6 +342,59 @@ extern "C"
     }
     #undef measure_and_save_rdm
 
+    // Measures one slice of the N-RDM and saves it into its own result file
+    void qcmaquis_interface_measure_and_save_hirdm_slice(int N, int state, int slice, int n_slices)
+    {
+        BaseParameters meas_parms = parms.measurements();
+        parms.erase_measurements();
+        parms.set("MEASURE[" + std::to_string(N) + "rdm]", 1);
+        parms.set("rdm_slice", slice);
+        parms.set("rdm_slices", n_slices);
+        qcmaquis_interface_set_state(state);
+        parms.set("resultfile", maquis::interface_detail::rdm_slice_result_name(pname, state, slice));
+
+        if (N == 3)
+            interface_ptr->measure_and_save_3rdm();
+        else
+            interface_ptr->measure_and_save_4rdm();
+
+        // restore the complete measurements and the result file of the state
+        parms.erase_measurements();
+        parms << meas_parms;
+        parms.set("rdm_slice", 0);
+        parms.set("rdm_slices", 1);
+        parms.set("resultfile", maquis::interface_detail::su2u1_result_name(pname, state));
+        measurements::RDMSlicing::set(0, 1);
+    }
+
+    void qcmaquis_interface_measure_and_save_3rdm_slice(int state, int slice, int n_slices)
+    {
+        qcmaquis_interface_measure_and_save_hirdm_slice(3, state, slice, n_slices);
+    }
+
+    void qcmaquis_interface_measure_and_save_4rdm_slice(int state, int slice, int n_slices)
+    {
+        qcmaquis_interface_measure_and_save_hirdm_slice(4, state, slice, n_slices);
+    }
+
+    void qcmaquis_interface_merge_hirdm_slices(int N, int state, int n_slices)
+    {
+        std::vector<std::string> shards;
+        for (int slice = 0; slice < n_slices; slice++)
+            shards.push_back(maquis::interface_detail::rdm_slice_result_name(pname, state, slice));
+        maquis::DMRGInterface<V>::merge_rdm_slices(N, shards, maquis::interface_detail::su2u1_result_name(pname, state));
+    }
+
+    void qcmaquis_interface_merge_3rdm_slices(int state, int n_slices)
+    {
+        qcmaquis_interface_merge_hirdm_slices(3, state, n_slices);
+    }
+
+    void qcmaquis_interface_merge_4rdm_slices(int state, int n_slices)
+    {
+        qcmaquis_interface_merge_hirdm_slices(4, state, n_slices);
+    }
+
     // this one does not use the macro above as it's a bit too complicated
     void qcmaquis_interface_measure_and_save_trans3rdm(int state, int bra_state)
     {
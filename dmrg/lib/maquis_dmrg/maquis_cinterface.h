@@ -132,6 +132,17 @@ extern "C"
     void qcmaquis_interface_measure_and_save_4rdm(int state);
     void qcmaquis_interface_measure_and_save_trans3rdm(int state, int bra_state);
 
+    // Measure a slice of the 3/4-RDM and save it into a separate HDF5 result file
+    // The elements are partitioned deterministically into n_slices slices, so that
+    // each slice can be evaluated by an independent process
+    // slice: slice index (starting from 0)
+    void qcmaquis_interface_measure_and_save_3rdm_slice(int state, int slice, int n_slices);
+    void qcmaquis_interface_measure_and_save_4rdm_slice(int state, int slice, int n_slices);
+
+    // Assemble the slices of the 3/4-RDM into the result file of the state
+    void qcmaquis_interface_merge_3rdm_slices(int state, int n_slices);
+    void qcmaquis_interface_merge_4rdm_slices(int state, int n_slices);
+
     // Measure overlap
     double qcmaquis_interface_get_overlap(const char* filename);
 
@@ -35,6 +35,7 @@
 #include "dmrg/sim/symmetry_factory.h"
 #include "dmrg/sim/matrix_types.h"
 #include "dmrg/sim/interface_sim.h"
+#include "dmrg/models/measurements/rdm_slicing.h"
 
 namespace maquis
 {
@@ -219,6 +220,17 @@ namespace maquis
 
     #undef measure_and_save_rdm
 
+    template <class V, Hamiltonian HamiltonianType>
+    void DMRGInterface<V, HamiltonianType>::merge_rdm_slices(int N, const std::vector<std::string> & shards, const std::string & result_file)
+    {
+        if (N == 3)
+            measurements::RDMSlicing::merge<V>(shards, result_file, "threeptdm");
+        else if (N == 4)
+            measurements::RDMSlicing::merge<V>(shards, result_file, "fourptdm");
+        else
+            throw std::runtime_error("Merging of RDM slices is supported only for the 3- and 4-RDM");
+    }
+
     template <class V, Hamiltonian HamiltonianType>
     void DMRGInterface<V, HamiltonianType>::measure_and_save_trans3rdm(const std::string & bra_name)
     {
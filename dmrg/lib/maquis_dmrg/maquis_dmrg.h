@@ -100,6 +100,11 @@ public:
     void measure_and_save_3rdm();
     void measure_and_save_4rdm();
 
+    // The 3 and 4-RDM measurements can be split in slices with parms["rdm_slices"] and parms["rdm_slice"]
+    // Each slice can be evaluated by an independent process that saves it into its own result file (a shard)
+    // merge_rdm_slices assembles the N-RDM stored in the shards into result_file
+    static void merge_rdm_slices(int N, const std::vector<std::string> & shards, const std::string & result_file);
+
     /** @brief Getter for the mutual information */
     const meas_with_results_type& mutinf();
 
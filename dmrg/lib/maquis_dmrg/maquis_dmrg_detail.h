@@ -64,6 +64,13 @@ namespace maquis {
             return ret;
         }
 
+        // Result file name for a slice of the 3/4-RDM measurements
+        inline std::string rdm_slice_result_name(const std::string& pname, int state, int slice)
+        {
+            std::string ret = pname + ".results_state." + std::to_string(state) + ".slice." + std::to_string(slice) + ".h5";
+            return ret;
+        }
+
         // Result file name for transition 3-RDM measurements
         inline std::string trans3rdm_result_name(const std::string& pname, int state, int bra_state)
         {
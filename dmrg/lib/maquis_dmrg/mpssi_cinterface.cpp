@@ -158,4 +158,25 @@ extern "C"
         mpssi_interface_ptr->rotate(pname_, state, t_vec, scale_inactive, Ms);
     }
 
+    void qcmaquis_mpssi_overlaps(char* bra_pname, int* bra_states, char* ket_pname, int* ket_states, int npairs, bool su2u1, V* overlaps)
+    {
+        std::string bra_pname_(bra_pname);
+        std::string ket_pname_(ket_pname);
+        std::vector<typename maquis::MPSSIInterface<V>::state_pair> pairs;
+        pairs.reserve(npairs);
+        for (int i = 0; i < npairs; i++)
+            pairs.emplace_back(bra_pname_, bra_states[i], ket_pname_, ket_states[i]);
+
+        std::vector<V> ret = mpssi_interface_ptr->overlap(pairs, su2u1);
+        std::copy(ret.begin(), ret.end(), overlaps);
+    }
+
+    void qcmaquis_mpssi_rotate_states(char* pname, int* states, int nstates, V* t, int t_size, V scale_inactive, int Ms)
+    {
+        std::string pname_(pname);
+        std::vector<int> states_(states, states + nstates);
+        std::vector<V> t_vec(t, t + t_size);
+        mpssi_interface_ptr->rotate(pname_, states_, t_vec, scale_inactive, Ms);
+    }
+
 }
\ No newline at end of file
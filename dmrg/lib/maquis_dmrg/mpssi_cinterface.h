@@ -58,6 +58,13 @@ extern "C"
     void qcmaquis_mpssi_transform(char* pname, int state, int Ms);
     void qcmaquis_mpssi_rotate(char* pname, int state, V* t, int t_size, V scale_inactive, int Ms);
 
+    // Batch versions, which keep the MPSs in memory and work on the states concurrently
+    // overlaps of the states bra_states[i] of bra_pname with ket_states[i] of ket_pname (arrays of size npairs)
+    // output: overlaps -- array of size npairs
+    void qcmaquis_mpssi_overlaps(char* bra_pname, int* bra_states, char* ket_pname, int* ket_states, int npairs, bool su2u1, V* overlaps);
+    // rotation of the nstates states in the array states
+    void qcmaquis_mpssi_rotate_states(char* pname, int* states, int nstates, V* t, int t_size, V scale_inactive, int Ms);
+
 }
 
 #endif
\ No newline at end of file
@@ -27,11 +27,15 @@
 *
 *****************************************************************************/
 
+#include <map>
 #include "mpssi_interface.h"
 #include "dmrg/mp_tensors/mps.h"
 #include "dmrg/mp_tensors/mps_mpo_ops.h"
 #include "dmrg/utils/BaseParameters.h"
 #include "dmrg/mp_tensors/mps_rotate.h"
+#include "dmrg/models/lattice.h"
+#include "dmrg/models/model.h"
+#include "dmrg/models/measurements/tagged_nrankrdm.h"
 #include "dmrg/sim/matrix_types.h"
 
 
@@ -69,21 +73,172 @@ namespace maquis
 #endif
 
         typedef alps::numeric::matrix<V> Matrix;
-        // Overlap calculation
-        V overlap_2u1(const std::string& bra_checkpoint, const std::string& ket_checkpoint)
+        typedef MPS<Matrix, TwoU1grp> twou1_mps_type;
+        typedef MPS<matrix, SU2U1grp> su2u1_mps_type;
+        typedef typename Model<Matrix, TwoU1grp>::measurements_type measurements_type;
+        typedef typename Model<Matrix, TwoU1grp>::tag_type tag_type;
+        typedef std::pair<std::string, std::string> checkpoint_pair;
+
+        // Returns the MPS stored in the checkpoint, which is loaded from disk only the first time it is requested.
+        // HDF5 is not thread-safe: all the MPSs needed in a parallel section must be requested before it.
+        template <class MPSType>
+        const MPSType& cached_mps(std::map<std::string, MPSType> & cache, const std::string& checkpoint)
         {
-            MPS<Matrix, TwoU1grp> bra, ket;
-            load(bra_checkpoint, bra);
-            load(ket_checkpoint, ket);
-            return (V) ::overlap(bra, ket);
+            auto it = cache.find(checkpoint);
+            if (it == cache.end())
+            {
+                it = cache.emplace(checkpoint, MPSType()).first;
+                load(checkpoint, it->second);
+            }
+            return it->second;
+        }
+
+        // Overlap calculation for all the pairs of (bra, ket) checkpoints, the pairs are evaluated concurrently
+        template <class MPSType>
+        std::vector<V> overlaps(std::map<std::string, MPSType> & cache, const std::vector<checkpoint_pair>& checkpoints)
+        {
+            std::vector<const MPSType*> bras(checkpoints.size()), kets(checkpoints.size());
+            for (int i = 0; i < checkpoints.size(); i++)
+            {
+                bras[i] = &cached_mps(cache, checkpoints[i].first);
+                kets[i] = &cached_mps(cache, checkpoints[i].second);
+            }
+
+            // <ket|bra> is the complex conjugate of <bra|ket>, so that only one of the two is contracted
+            std::map<checkpoint_pair, int> first_occurrence;
+            std::vector<int> contracted, conjugated(checkpoints.size(), -1);
+            for (int i = 0; i < checkpoints.size(); i++)
+            {
+                auto it = first_occurrence.find(checkpoint_pair(checkpoints[i].second, checkpoints[i].first));
+                if (it != first_occurrence.end())
+                    conjugated[i] = it->second;
+                else
+                {
+                    first_occurrence.emplace(checkpoints[i], i);
+                    contracted.push_back(i);
+                }
+            }
+
+            std::vector<V> ret(checkpoints.size());
+#ifdef MAQUIS_OPENMP
+            #pragma omp parallel for schedule(dynamic)
+#endif
+            for (int k = 0; k < contracted.size(); k++)
+            {
+                int i = contracted[k];
+                // The contraction changes the pairing of the tensors, so each pair works on its own copies
+                MPSType bra = *bras[i], ket = *kets[i];
+                ret[i] = (V) ::overlap(bra, ket);
+            }
+
+            for (int i = 0; i < checkpoints.size(); i++)
+                if (conjugated[i] != -1)
+                    ret[i] = utils::conj(ret[conjugated[i]]);
+            return ret;
+        }
+
+        std::vector<V> overlaps_2u1(const std::vector<checkpoint_pair>& checkpoints)
+        {
+            return overlaps(twou1_cache_, checkpoints);
+        }
+
+        std::vector<V> overlaps_su2u1(const std::vector<checkpoint_pair>& checkpoints)
+        {
+            return overlaps(su2u1_cache_, checkpoints);
+        }
+
+        // 1-RDM and 1-TDM measurements (aa and bb) for the 2U1 states of a project, with the
+        // lattice, the identities and the operators required to set up the contraction engines
+        struct tdm_setup
+        {
+            Lattice lat;
+            std::vector<tag_type> identities;
+            std::shared_ptr<TagHandler<Matrix, TwoU1grp> > tag_handler;
+            measurements_type meas;
+        };
+
+        // The measurements are generated once per project from the parameters of the checkpoint [ket_checkpoint]
+        const tdm_setup& tdm_measurements(const std::string& pname, const std::string& ket_checkpoint)
+        {
+            auto it = tdm_measurements_.find(pname);
+            if (it == tdm_measurements_.end())
+            {
+                DmrgParameters parms;
+                storage::archive ar_in(ket_checkpoint + "/props.h5");
+                ar_in["/parameters"] >> parms;
+                parms.erase_measurements();
+#if defined(HAVE_SU2U1PG)
+                parms.set("symmetry", "2u1pg");
+#elif defined(HAVE_SU2U1)
+                parms.set("symmetry", "2u1");
+#endif
+                parms.set("MEASURE[1rdm_aa]", "1");
+                parms.set("MEASURE[1rdm_bb]", "1");
+                // The bra checkpoint is only required by the measurements to be valid, the bras are passed from memory
+                parms.set("MEASURE[trans1rdm_aa]", ket_checkpoint);
+                parms.set("MEASURE[trans1rdm_bb]", ket_checkpoint);
+
+                tdm_setup setup;
+                setup.lat = Lattice(parms);
+                Model<Matrix, TwoU1grp> model(setup.lat, parms);
+                for (int type = 0; type <= setup.lat.maximum_vertex_type(); type++)
+                    setup.identities.push_back(model.identity_matrix_tag(type));
+                setup.tag_handler = model.operators_table();
+                setup.meas = model.measurements();
+                it = tdm_measurements_.emplace(pname, std::move(setup)).first;
+            }
+            return it->second;
         }
 
-        V overlap_su2u1(const std::string& bra_checkpoint, const std::string& ket_checkpoint)
+        // 1-TDMs (aa and bb components) for all the pairs of 2U1 checkpoints, the pairs are evaluated concurrently.
+        // [bra_eq_ket] selects the 1-RDM measurements, [ket_pnames] the project of the ket of each pair.
+        std::vector<std::vector<maquis::meas_with_results_type<V> > > onetdms_2u1(const std::vector<checkpoint_pair>& checkpoints,
+                                                                                  const std::vector<bool>& bra_eq_ket,
+                                                                                  const std::vector<std::string>& ket_pnames)
         {
-            MPS<matrix, SU2U1grp> bra, ket;
-            load(bra_checkpoint, bra);
-            load(ket_checkpoint, ket);
-            return (V) ::overlap(bra, ket);
+            typedef measurement<Matrix, TwoU1grp> measurement_type;
+            typedef measurements::TaggedNRankRDM<Matrix, TwoU1grp> tdm_type;
+
+            std::vector<const twou1_mps_type*> bras(checkpoints.size()), kets(checkpoints.size());
+            std::vector<const tdm_setup*> setups(checkpoints.size());
+            std::vector<std::vector<const measurement_type*> > meas(checkpoints.size());
+            for (int i = 0; i < checkpoints.size(); i++)
+            {
+                kets[i] = &cached_mps(twou1_cache_, checkpoints[i].second);
+                bras[i] = bra_eq_ket[i] ? kets[i] : &cached_mps(twou1_cache_, checkpoints[i].first);
+                setups[i] = &tdm_measurements(ket_pnames[i], checkpoints[i].second);
+
+                std::vector<std::string> names = bra_eq_ket[i] ? std::vector<std::string>{"oneptdm_aa", "oneptdm_bb"}
+                                                               : std::vector<std::string>{"transition_oneptdm_aa", "transition_oneptdm_bb"};
+                for (auto&& name: names)
+                    for (auto&& m: setups[i]->meas)
+                        if (m.name() == name)
+                            meas[i].push_back(&m);
+                assert(meas[i].size() == 2);
+            }
+
+            std::vector<std::vector<maquis::meas_with_results_type<V> > > ret(checkpoints.size());
+#ifdef MAQUIS_OPENMP
+            #pragma omp parallel for schedule(dynamic)
+#endif
+            for (int i = 0; i < checkpoints.size(); i++)
+            {
+                // The overlap boundaries of the pair are shared by the two spin components
+                twou1_mps_type bra = *bras[i], ket = *kets[i];
+                measurements::RDMEngine<Matrix, TwoU1grp> engine(bra, ket, setups[i]->identities, setups[i]->tag_handler, setups[i]->lat);
+                for (auto&& m: meas[i])
+                {
+                    // Each pair evaluates its own clone of the measurement, which stores the results
+                    std::unique_ptr<measurement_type> local(m->clone());
+                    tdm_type& tdm = dynamic_cast<tdm_type&>(*local);
+                    if (bra_eq_ket[i])
+                        tdm.evaluate_transition(twou1_mps_type(), ket, engine);
+                    else
+                        tdm.evaluate_transition(bra, ket, engine);
+                    ret[i].push_back(std::make_pair(local->get_labels_num(), local->get_vec_results()));
+                }
+            }
+            return ret;
         }
 
         std::string twou1_name(std::string pname, int state, int Ms, bool rotated)
@@ -105,19 +260,9 @@ namespace maquis
 
         }
 
-        // MPS rotation
-        void rotate(const std::string & pname, int state, const std::vector<V> & t, V scale_inactive, int Ms)
+        // MPS rotation of several states of a project, the states are rotated concurrently
+        void rotate(const std::string & pname, const std::vector<int>& states, const std::vector<V> & t, V scale_inactive, int Ms)
         {
-
-#if defined(HAVE_SU2U1PG)
-            typedef TwoU1PG grp;
-#elif defined(HAVE_SU2U1)
-            typedef TwoU1 grp;
-#endif
-            // generate checkpoint names
-            std::string checkpoint_name = twou1_name(pname, state, Ms, false);
-            std::string checkpoint_name_rotated = twou1_name(pname, state, Ms, true);
-
             // convert t to alps::matrix
 
             // check if the length of the vector is a square number
@@ -133,31 +278,53 @@ namespace maquis
                 for (int j = 0; j < dim; j++)
                     t_mat(i,j) = t[idx++];
 
+            // generate checkpoint names and load the MPSs
+            std::vector<std::string> checkpoint_names(states.size()), checkpoint_names_rotated(states.size());
+            std::vector<twou1_mps_type> mps(states.size());
+            for (int i = 0; i < states.size(); i++)
+            {
+                checkpoint_names[i] = twou1_name(pname, states[i], Ms, false);
+                checkpoint_names_rotated[i] = twou1_name(pname, states[i], Ms, true);
+
+                // check if the checkpoint has 2U1/2U1PG symmetry
+                storage::archive ar_in(checkpoint_names[i]+"/props.h5");
+                BaseParameters chkp_parms;
+                ar_in["/parameters"] >> chkp_parms;
+                std::string sym = chkp_parms["symmetry"].str();
+                // check if we have "2u1" or "2u1pg": "su2u1"/"su2u1pg" should NOT work
+                // i.e. 2u1 must be found at the beginning of the string
+                std::size_t twou1_pos = sym.find("2u1");
+                if ((twou1_pos == std::string::npos) || (twou1_pos > 0))
+                    throw std::runtime_error("checkpoint for MPS rotation does not have 2U1 symmetry");
+
+                // the unrotated MPS is kept in the cache, since it is also used in the overlaps within a project
+                mps[i] = cached_mps(twou1_cache_, checkpoint_names[i]);
+            }
 
-            MPS<Matrix, grp> mps;
-            load(checkpoint_name, mps);
-
-            mps.canonize(0); // TODO: Stefan -- why is it needed?
+#ifdef MAQUIS_OPENMP
+            #pragma omp parallel for schedule(dynamic)
+#endif
+            for (int i = 0; i < states.size(); i++)
+            {
+                mps[i].canonize(0); // TODO: Stefan -- why is it needed?
 
-            // check if the checkpoint has 2U1/2U1PG symmetry
-            storage::archive ar_in(checkpoint_name+"/props.h5");
-            BaseParameters chkp_parms;
-            ar_in["/parameters"] >> chkp_parms;
-            std::string sym = chkp_parms["symmetry"].str();
-            // check if we have "2u1" or "2u1pg": "su2u1"/"su2u1pg" should NOT work
-            // i.e. 2u1 must be found at the beginning of the string
-            std::size_t twou1_pos = sym.find("2u1");
-            if ((twou1_pos == std::string::npos) || (twou1_pos > 0))
-                throw std::runtime_error("checkpoint for MPS rotation does not have 2U1 symmetry");
+                // variational rotation, with the bond dimension and the truncation threshold
+                // of the compression of the joined rotation
+                mps_rotate::rotate_mps(mps[i], t_mat, scale_inactive, 8000, 1e-8);
+            }
 
-            mps_rotate::rotate_mps(mps, t_mat, scale_inactive);
-            save(checkpoint_name_rotated, mps);
+            for (int i = 0; i < states.size(); i++)
+            {
+                save(checkpoint_names_rotated[i], mps[i]);
 
-            // copy over props.h5 file, overwriting the old one
-            if (boost::filesystem::exists(checkpoint_name_rotated + "/props.h5"))
-                boost::filesystem::remove(checkpoint_name_rotated + "/props.h5");
-            boost::filesystem::copy(checkpoint_name + "/props.h5", checkpoint_name_rotated + "/props.h5");
+                // copy over props.h5 file, overwriting the old one
+                if (boost::filesystem::exists(checkpoint_names_rotated[i] + "/props.h5"))
+                    boost::filesystem::remove(checkpoint_names_rotated[i] + "/props.h5");
+                boost::filesystem::copy(checkpoint_names[i] + "/props.h5", checkpoint_names_rotated[i] + "/props.h5");
 
+                // the rotated MPS replaces the one of a previous rotation
+                twou1_cache_[checkpoint_names_rotated[i]] = std::move(mps[i]);
+            }
         }
 
         // Constructor that takes project names and states to get the multiplicities
@@ -271,6 +438,13 @@ namespace maquis
             // Number of electrons, for now only one number of electrons supported for all projects. (i.e. no Dyson orbitals)
             int nel_;
 
+            // 2U1 and SU2U1 MPSs kept in memory, indexed by checkpoint name
+            std::map<std::string, twou1_mps_type> twou1_cache_;
+            std::map<std::string, su2u1_mps_type> su2u1_cache_;
+
+            // 1-RDM and 1-TDM measurements for each project
+            std::map<std::string, tdm_setup> tdm_measurements_;
+
     };
 
     template <class V>
@@ -294,7 +468,13 @@ namespace maquis
     template <class V>
     void MPSSIInterface<V>::rotate(const std::string& pname, int state, const std::vector<V> & t, V scale_inactive, int Ms)
     {
-        impl_->rotate(pname, state, t, scale_inactive, Ms);
+        impl_->rotate(pname, std::vector<int>{state}, t, scale_inactive, Ms);
+    }
+
+    template <class V>
+    void MPSSIInterface<V>::rotate(const std::string& pname, const std::vector<int>& states, const std::vector<V> & t, V scale_inactive, int Ms)
+    {
+        impl_->rotate(pname, states, t, scale_inactive, Ms);
     }
 
     // Calculate 1-TDMs
@@ -354,105 +534,96 @@ namespace maquis
     template <class V>
     std::vector<meas_with_results_type<V> > MPSSIInterface<V>::onetdm_spin(const std::string& bra_pname, int bra_state, const std::string& ket_pname, int ket_state)
     {
+        return onetdm_spin(std::vector<state_pair>{state_pair(bra_pname, bra_state, ket_pname, ket_state)})[0];
+    }
 
-        typedef alps::numeric::matrix<V> Matrix;
-        DmrgParameters parms;
-        std::string ket_name, bra_name;
+    template <class V>
+    std::vector<std::vector<meas_with_results_type<V> > > MPSSIInterface<V>::onetdm_spin(const std::vector<state_pair>& pairs)
+    {
+        std::vector<std::pair<std::string, std::string> > checkpoints;
+        std::vector<bool> bra_eq_ket;
+        std::vector<std::string> ket_pnames;
+        checkpoints.reserve(pairs.size());
+        bra_eq_ket.reserve(pairs.size());
+        ket_pnames.reserve(pairs.size());
+
+        for (auto&& pair: pairs)
+        {
+            const std::string& bra_pname = std::get<0>(pair);
+            const std::string& ket_pname = std::get<2>(pair);
+            int bra_state = std::get<1>(pair), ket_state = std::get<3>(pair);
 
-        // Calculate Ms according to OpenMOLCAS logic: Ms=min(S_bra, S_ket)
-        int S_bra = impl_->get_multiplicity(bra_pname);
-        int S_ket = impl_->get_multiplicity(ket_pname);
-        int Ms = std::min(S_bra, S_ket);
+            // Calculate Ms according to OpenMOLCAS logic: Ms=min(S_bra, S_ket)
+            int S_bra = impl_->get_multiplicity(bra_pname);
+            int S_ket = impl_->get_multiplicity(ket_pname);
+            int Ms = std::min(S_bra, S_ket);
 
-        bool bra_eq_ket = (bra_pname == ket_pname) && (bra_state == ket_state);
-        bool rotated = (bra_pname != ket_pname);
+            // 1-RDM if bra == ket
+            bra_eq_ket.push_back((bra_pname == ket_pname) && (bra_state == ket_state));
+            bool rotated = (bra_pname != ket_pname);
 
-        ket_name = twou1_name(ket_pname, ket_state, Ms, rotated);
-        bra_name = twou1_name(bra_pname, bra_state, Ms, rotated);
+            checkpoints.emplace_back(twou1_name(bra_pname, bra_state, Ms, rotated), twou1_name(ket_pname, ket_state, Ms, rotated));
+            ket_pnames.push_back(ket_pname);
+        }
 
-        storage::archive ar_in(ket_name + "/props.h5");
-        ar_in["/parameters"] >> parms;
+        // the results contain the aa and bb components, in this order.
+        // ab and ba are not needed in MOLCAS
+        return impl_->onetdms_2u1(checkpoints, bra_eq_ket, ket_pnames);
+    }
 
+    template <class V>
+    V MPSSIInterface<V>::overlap(const std::string& bra_pname, int bra_state, const std::string& ket_pname, int ket_state, bool su2u1)
+    {
+        return overlap(std::vector<state_pair>{state_pair(bra_pname, bra_state, ket_pname, ket_state)}, su2u1)[0];
+    }
 
-        parms.erase_measurements();
+    template <class V>
+    std::vector<V> MPSSIInterface<V>::overlap(const std::vector<state_pair>& pairs, bool su2u1)
+    {
+        std::vector<V> ret(pairs.size(), (V)1.0);
 
-#if defined(HAVE_SU2U1PG)
-        parms.set("symmetry", "2u1pg");
-#elif defined(HAVE_SU2U1)
-        parms.set("symmetry", "2u1");
-#endif
+        // Pairs which require a calculation, and their position in [ret]
+        std::vector<std::pair<std::string, std::string> > su2u1_checkpoints, twou1_checkpoints;
+        std::vector<int> su2u1_idx, twou1_idx;
 
-        parms.set("chkpfile", ket_name);
-        if (bra_eq_ket) // run 1-RDM measurement if bra == ket
-        {
-            parms.set("MEASURE[1rdm_aa]", "1");
-            // ab and ba are not needed in MOLCAS
-            // parms.set("MEASURE[1rdm_ab]", "1");
-            // parms.set("MEASURE[1rdm_ba]", "1");
-            parms.set("MEASURE[1rdm_bb]", "1");
-        }
-        else
+        for (int i = 0; i < pairs.size(); i++)
         {
-            parms.set("MEASURE[trans1rdm_aa]", bra_name);
-            // parms.set("MEASURE[trans1rdm_ab]", bra_name);
-            // parms.set("MEASURE[trans1rdm_ba]", bra_name);
-            parms.set("MEASURE[trans1rdm_bb]", bra_name);
-        }
-
-        // run measurement
-        maquis::DMRGInterface<double> interface(parms);
-        interface.measure();
+            const std::string& bra_pname = std::get<0>(pairs[i]);
+            const std::string& ket_pname = std::get<2>(pairs[i]);
+            int bra_state = std::get<1>(pairs[i]), ket_state = std::get<3>(pairs[i]);
 
-        std::vector<meas_with_results_type> ret;
-        ret.reserve(2);
+            if ((bra_state == ket_state) && (bra_pname == ket_pname)) continue;
 
-        const results_map_type<V>& meas = interface.measurements();
+            if ((bra_pname == ket_pname) && su2u1)
+            {
+                su2u1_checkpoints.emplace_back(maquis::interface_detail::su2u1_name(bra_pname, bra_state),
+                                               maquis::interface_detail::su2u1_name(ket_pname, ket_state));
+                su2u1_idx.push_back(i);
+            }
+            else
+            {
+                bool rotated = (bra_pname != ket_pname);
 
-        if (bra_eq_ket)
-        {
-            ret.push_back(meas.at("oneptdm_aa"));
-            // ret.push_back(meas.at("oneptdm_ab"));
-            // ret.push_back(meas.at("oneptdm_ba"));
-            ret.push_back(meas.at("oneptdm_bb"));
+                // Actually this does not matter, but we need to provide some Ms
+                const auto& multiplicities = impl_->multiplicities();
+                int bra_idx = impl_->allowed_names_states(bra_pname, bra_state);
+                int ket_idx = impl_->allowed_names_states(ket_pname, ket_state);
+                int Ms = std::min(multiplicities[bra_idx], multiplicities[ket_idx]);
 
-        }
-        else
-        {
-            ret.push_back(meas.at("transition_oneptdm_aa"));
-            // ret.push_back(meas.at("transition_oneptdm_ab"));
-            // ret.push_back(meas.at("transition_oneptdm_ba"));
-            ret.push_back(meas.at("transition_oneptdm_bb"));
+                twou1_checkpoints.emplace_back(twou1_name(bra_pname, bra_state, Ms, rotated), twou1_name(ket_pname, ket_state, Ms, rotated));
+                twou1_idx.push_back(i);
+            }
         }
 
-        return ret;
-    }
-
-
-    template <class V>
-    V MPSSIInterface<V>::overlap(const std::string& bra_pname, int bra_state, const std::string& ket_pname, int ket_state, bool su2u1)
-    {
-        if ((bra_pname == ket_pname) && su2u1)
-        {
-            if (bra_state == ket_state) return (V)1.0;
-            std::string ket_name = maquis::interface_detail::su2u1_name(ket_pname, ket_state);
-            std::string bra_name = maquis::interface_detail::su2u1_name(bra_pname, bra_state);
-            return impl_->overlap_su2u1(ket_name, bra_name);
-        }
-        else
-        {
-            if ((bra_state == ket_state) && (bra_pname == ket_pname)) return (V)1.0;
-            bool rotated = (bra_pname != ket_pname);
+        std::vector<V> su2u1_overlaps = impl_->overlaps_su2u1(su2u1_checkpoints);
+        for (int i = 0; i < su2u1_idx.size(); i++)
+            ret[su2u1_idx[i]] = su2u1_overlaps[i];
 
-            // Actually this does not matter, but we need to provide some Ms
-            const auto& multiplicities = impl_->multiplicities();
-            int bra_idx = impl_->allowed_names_states(bra_pname, bra_state);
-            int ket_idx = impl_->allowed_names_states(ket_pname, ket_state);
-            int Ms = std::min(multiplicities[bra_idx], multiplicities[ket_idx]);
+        std::vector<V> twou1_overlaps = impl_->overlaps_2u1(twou1_checkpoints);
+        for (int i = 0; i < twou1_idx.size(); i++)
+            ret[twou1_idx[i]] = twou1_overlaps[i];
 
-            std::string ket_name = twou1_name(ket_pname, ket_state, Ms, rotated);
-            std::string bra_name = twou1_name(bra_pname, bra_state, Ms, rotated);
-            return impl_->overlap_2u1(ket_name, bra_name);
-        }
+        return ret;
     }
 
 
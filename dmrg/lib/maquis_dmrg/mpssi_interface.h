@@ -29,6 +29,7 @@
 #ifndef MPSSI_INTERFACE_H
 #define MPSSI_INTERFACE_H
 
+#include <tuple>
 #include "maquis_dmrg.h"
 
 namespace maquis
@@ -40,6 +41,9 @@ namespace maquis
             // typedef for measurements
             // Intel compiler seems not to like it
             typedef maquis::meas_with_results_type<V> meas_with_results_type;
+
+            // Pair of states for the batch functions: bra project name, bra state, ket project name, ket state
+            typedef std::tuple<std::string, int, std::string, int> state_pair;
             MPSSIInterface(const std::vector<std::string>& project_names,
                            const std::vector<std::vector<int> >& states);
 
@@ -48,6 +52,10 @@ namespace maquis
             // Overlap
             V overlap(const std::string& bra_pname, int bra_state, const std::string& ket_pname, int ket_state, bool su2u1);
 
+            // Overlaps for all the pairs of states. The MPSs are loaded once and kept in memory,
+            // and the pairs are evaluated concurrently.
+            std::vector<V> overlap(const std::vector<state_pair>& pairs, bool su2u1);
+
             // Disabled since the interface does not need it
             // // 1-TDM
             // meas_with_results_type onetdm(const std::string& bra_pname, int bra_state, const std::string& ket_pname, int ket_state);
@@ -56,6 +64,11 @@ namespace maquis
             std::vector<maquis::meas_with_results_type<V> >
                 onetdm_spin(const std::string& bra_pname, int bra_state, const std::string& ket_pname, int ket_state);
 
+            // 1-TDMs, split in spin components, for all the pairs of states.
+            // As for the overlaps, the MPSs are kept in memory and the pairs are evaluated concurrently.
+            std::vector<std::vector<maquis::meas_with_results_type<V> > >
+                onetdm_spin(const std::vector<state_pair>& pairs);
+
 
             // MPS counterrotation.
             // Parameters:
@@ -65,6 +78,9 @@ namespace maquis
             // scale_inactive: inactive scaling factor
             // This function appends .rotated. to pname when saving rotated MPS
             void rotate(const std::string& pname, int state, const std::vector<V> & t, V scale_inactive, int Ms);
+
+            // MPS counterrotation of several states of the same project, which are rotated concurrently.
+            void rotate(const std::string& pname, const std::vector<int>& states, const std::vector<V> & t, V scale_inactive, int Ms);
         private:
 
             // Generate 2U1 checkpoint name. rotated == true will append .rotated. to prefix
@@ -141,6 +141,52 @@ BOOST_FIXTURE_TEST_CASE_TEMPLATE(TestEnergyConservationSiteproblem, S, symmetrie
     BOOST_CHECK_CLOSE(initialEnergy, finalEnergy, 1e-10);
 }
 
+/** Checks that the two-pass Lanczos propagator gives the same result as the one storing the Krylov space */
+BOOST_FIXTURE_TEST_CASE_TEMPLATE(TestTwoPassPropagation, S, symmetries, TestTimeEvolverFixture) {
+    // Types declaration
+    using BoundaryType = Boundary<typename storage::constrained<cmatrix>::type, S>;
+    using contr = contraction::Engine<cmatrix, typename storage::constrained<cmatrix>::type, S>;
+    DmrgParameters p;
+    p.set("integrals_binary", maquis::serialize(integrals));
+    p.set("site_types", "0,0,0,0");
+    p.set("L", 4);
+    p.set("irrep", 0);
+    p.set("nsweeps",2);
+    p.set("max_bond_dimension", 100);
+    p.set("hamiltonian_units", "Hartree");
+    p.set("time_units", "as");
+    p.set("propagator_accuracy", 1.0E-20);
+    p.set("propagator_maxiter", 10);
+    p.set("time_step", 1.);
+    p.set("imaginary_time", "no");
+    p.set("COMPLEX", 1);
+    // For SU2U1
+    p.set("nelec", 2);
+    p.set("spin", 0);
+    // For 2U1
+    p.set("u1_total_charge1", 1);
+    p.set("u1_total_charge2", 1);
+    auto lat = Lattice(p);
+    auto model = Model<cmatrix, S>(lat, p);
+    auto mpo = make_mpo(lat, model);
+    auto mps = MPS<cmatrix, S>(lat.size(), *(model.initializer(lat, p)));
+    auto latticeSize = mpo.length();
+    std::vector<BoundaryType> left(latticeSize+1), right(latticeSize+1);
+    left[0] = mps.left_boundary();
+    for (int iSite = 0; iSite < latticeSize; iSite++)
+        left[iSite+1] = contr::overlap_mpo_left_step(mps[iSite], mps[iSite], left[iSite], mpo[iSite]);
+    right[latticeSize] = mps.right_boundary();
+    for (int iSite = latticeSize-1; iSite >= 0; iSite--)
+        right[iSite] = contr::overlap_mpo_right_step(mps[iSite], mps[iSite], right[iSite+1], mpo[iSite]);
+    SiteProblem<cmatrix, S> sp0(left[0], right[1], mpo[0]);
+    auto singlePass = mps[0], twoPass = mps[0];
+    TimeEvolver<cmatrix, S, DmrgParameters>(p).evolve(sp0, singlePass, true);
+    p.set("propagator_two_pass", "yes");
+    TimeEvolver<cmatrix, S, DmrgParameters>(p).evolve(sp0, twoPass, true);
+    BOOST_CHECK_SMALL((singlePass - twoPass).scalar_norm(), 1.0E-10);
+    BOOST_CHECK_CLOSE(twoPass.scalar_norm(), mps[0].scalar_norm(), 1e-10);
+}
+
 /** Checks that the energy of an MPS is conserved after the propagation of a ZeroSiteProblem */
 BOOST_FIXTURE_TEST_CASE_TEMPLATE(TestEnergyConservationZeroSiteproblem, S, symmetries, TestTimeEvolverFixture) {
     // Types declaration
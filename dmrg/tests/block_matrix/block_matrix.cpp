@@ -32,10 +32,12 @@
 #include "dmrg/block_matrix/detail/alps.hpp"
 #include "dmrg/block_matrix/symmetry.h"
 #include "dmrg/block_matrix/block_matrix.h"
+#include "dmrg/block_matrix/block_matrix_algorithms.h"
+#include "dmrg/block_matrix/density_matrix.h"
 
 #include "dmrg/sim/matrix_types.h"
 
-//typedef alps::numeric::associated_real_diagonal_matrix<matrix>::type DiagMatrix;
+typedef alps::numeric::associated_real_diagonal_matrix<matrix>::type DiagMatrix;
 
 #if defined(HAVE_TwoU1) || defined(HAVE_TwoU1PG)
 
@@ -583,5 +585,66 @@ BOOST_AUTO_TEST_CASE(BlockMatrixResizeBlock){
     BOOST_CHECK_EQUAL(ba[0](9, 19), 1.);
     BOOST_CHECK_EQUAL(ba[0](19, 29), 0.);
 }
+
+/* Checks that the randomized SVD gives the same truncation as the full one */
+BOOST_AUTO_TEST_CASE(BlockMatrixRandomizedSVDTruncate){
+    Index<TwoU1> rows, cols, inner;
+    auto charge0 = typename TwoU1::charge(0);
+    auto charge1 = typename TwoU1::charge(1);
+    rows.insert(std::make_pair(charge0, 200));
+    rows.insert(std::make_pair(charge1, 5));
+    cols.insert(std::make_pair(charge0, 150));
+    cols.insert(std::make_pair(charge1, 3));
+    inner.insert(std::make_pair(charge0, 25));
+    inner.insert(std::make_pair(charge1, 3));
+    // Low-rank matrix, such that the spectrum above the truncation is well separated
+    boost::mt19937 engine(42);
+    boost::uniform_real<double> dist(-1., 1.);
+    block_matrix<matrix, TwoU1> A(rows, inner), B(inner, cols), M;
+    for (std::size_t k = 0; k < A.n_blocks(); ++k) {
+        std::generate(elements(A[k]).first, elements(A[k]).second, [&]() { return dist(engine); });
+        std::generate(elements(B[k]).first, elements(B[k]).second, [&]() { return dist(engine); });
+    }
+    gemm(A, B, M);
+    block_matrix<matrix, TwoU1> Uf, Vf, Ur, Vr;
+    block_matrix<DiagMatrix, TwoU1> Sf, Sr;
+    auto full = svd_truncate(M, Uf, Vf, Sf, 1e-10, 20, false);
+    SVDSettings::set("randomized", 10, 2);
+    auto randomized = svd_truncate(M, Ur, Vr, Sr, 1e-10, 20, false);
+    SVDSettings::set("full", 10, 2);
+    BOOST_CHECK_EQUAL(randomized.bond_dimension, full.bond_dimension);
+    BOOST_CHECK_CLOSE(randomized.truncated_weight, full.truncated_weight, 1e-6);
+    BOOST_CHECK(Sr.basis() == Sf.basis());
+    for (std::size_t k = 0; k < Sf.n_blocks(); ++k)
+        for (std::size_t i = 0; i < num_rows(Sf[k]); ++i)
+            BOOST_CHECK_CLOSE(Sr[k](i,i), Sf[k](i,i), 1e-8);
+}
+
+/* Checks that the density matrices built with HERK match the ones built with GEMM */
+BOOST_AUTO_TEST_CASE(BlockMatrixDensityMatrixHerk){
+    Index<TwoU1> rows, cols;
+    auto charge0 = typename TwoU1::charge(0);
+    auto charge1 = typename TwoU1::charge(1);
+    rows.insert(std::make_pair(charge0, 7));
+    rows.insert(std::make_pair(charge1, 4));
+    cols.insert(std::make_pair(charge0, 5));
+    cols.insert(std::make_pair(charge1, 9));
+    boost::mt19937 engine(7);
+    boost::uniform_real<double> dist(-1., 1.);
+    block_matrix<matrix, TwoU1> M(rows, cols);
+    for (std::size_t k = 0; k < M.n_blocks(); ++k)
+        std::generate(elements(M[k]).first, elements(M[k]).second, [&]() { return dist(engine); });
+    block_matrix<matrix, TwoU1> left_gemm, right_gemm, left_herk, right_herk;
+    gram_left(M, left_gemm);
+    gram_right(M, right_gemm);
+    DensityMatrixSettings::set_product("herk");
+    gram_left(M, left_herk);
+    gram_right(M, right_herk);
+    DensityMatrixSettings::set_product("gemm");
+    BOOST_CHECK(left_herk.basis() == left_gemm.basis());
+    BOOST_CHECK(right_herk.basis() == right_gemm.basis());
+    BOOST_CHECK_SMALL((left_herk - left_gemm).norm(), 1e-12);
+    BOOST_CHECK_SMALL((right_herk - right_gemm).norm(), 1e-12);
+}
 #endif
 
@@ -0,0 +1,128 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+/**
+ * Benchmark of the MPO construction for quantum-chemistry Hamiltonians.
+ * For L = [mpo_benchmark_step], 2*[mpo_benchmark_step], ... up to [L] orbitals,
+ * generates a synthetic FCIDUMP with all the symmetry-unique integrals set to
+ * random values, and times the model construction, the insertion of the terms
+ * in the TaggedMPOMaker and [create_mpo]. The maximum resident set size after
+ * each construction is reported as well.
+ */
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <sys/resource.h>
+
+#include "matrix_selector.hpp" /// define matrix
+#include "symm_selector.hpp"   /// define grp
+
+#include "dmrg/models/lattice.h"
+#include "dmrg/models/model.h"
+#include "dmrg/models/generate_mpo.hpp"
+
+#include "dmrg/utils/DmrgOptions.h"
+#include "dmrg/utils/DmrgParameters.h"
+
+/** @brief FCIDUMP (without header) with random one- and two-electron integrals for L orbitals */
+std::string synthetic_fcidump(int L, std::size_t & n_integrals)
+{
+    std::mt19937 generator(L);
+    std::uniform_real_distribution<double> distribution(-0.1, 0.1);
+    std::ostringstream fcidump;
+    fcidump.precision(12);
+    n_integrals = 0;
+    for (int i = 1; i <= L; ++i)
+        for (int j = 1; j <= i; ++j)
+            for (int k = 1; k <= i; ++k)
+                for (int l = 1; l <= ((k == i) ? j : k); ++l, ++n_integrals)
+                    fcidump << distribution(generator) << " " << i << " " << j << " " << k << " " << l << "\n";
+    for (int i = 1; i <= L; ++i)
+        for (int j = 1; j <= i; ++j, ++n_integrals)
+            fcidump << distribution(generator) << " " << i << " " << j << " 0 0\n";
+    fcidump << "1.0 0 0 0 0\n";
+    return fcidump.str();
+}
+
+/** @brief Maximum resident set size of the process in MB */
+double max_rss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.;
+}
+
+int main(int argc, char ** argv)
+{
+    try {
+        DmrgOptions opt(argc, argv);
+        if (!opt.valid) return 0;
+        DmrgParameters parms = opt.parms;
+
+        typedef std::chrono::steady_clock clock;
+        int L_max = parms["L"];
+        int step = parms.is_set("mpo_benchmark_step") ? int(parms["mpo_benchmark_step"]) : 4;
+
+        maquis::cout << "L   integrals   model [s]   terms [s]   create_mpo [s]   max bond dim   max RSS [MB]" << std::endl;
+        for (int L = step; L <= L_max; L += step) {
+            std::size_t n_integrals;
+            parms.set("lattice_library", "coded");
+            parms.set("LATTICE", "orbitals");
+            parms.set("model_library", "coded");
+            parms.set("MODEL", "quantum_chemistry");
+            parms.set("L", L);
+            std::string site_types = "0";
+            for (int p = 1; p < L; ++p)
+                site_types += ",0";
+            parms.set("site_types", site_types);
+            parms.set("u1_total_charge1", L/2);
+            parms.set("u1_total_charge2", L/2);
+            parms.set("integrals", synthetic_fcidump(L, n_integrals));
+
+            auto start = clock::now();
+            Lattice lattice(parms);
+            Model<matrix, grp> model(lattice, parms);
+            auto model_end = clock::now();
+            generate_mpo::TaggedMPOMaker<matrix, grp> mpom(lattice, model);
+            auto terms_end = clock::now();
+            MPO<matrix, grp> mpo = mpom.create_mpo();
+            auto mpo_end = clock::now();
+
+            std::size_t max_bond_dim = 0;
+            for (std::size_t p = 0; p < mpo.size(); ++p)
+                max_bond_dim = std::max(max_bond_dim, mpo[p].col_dim());
+            std::chrono::duration<double> t_model = model_end - start, t_terms = terms_end - model_end, t_mpo = mpo_end - terms_end;
+            maquis::cout << L << "   " << n_integrals << "   " << t_model.count() << "   " << t_terms.count() << "   "
+                         << t_mpo.count() << "   " << max_bond_dim << "   " << max_rss() << std::endl;
+        }
+
+    } catch (std::exception & e) {
+        maquis::cerr << "Exception caught:" << std::endl << e.what() << std::endl;
+        exit(1);
+    }
+}
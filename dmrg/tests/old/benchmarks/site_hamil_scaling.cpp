@@ -0,0 +1,135 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+/**
+ * Thread-scaling benchmark of the site Hamiltonian application.
+ * Loads the MPS from [chkpfile], builds the boundaries for the site stored in
+ * the checkpoint and times [site_hamil2] for 1, 2, 4, ... OpenMP threads with
+ * both the [critical] and the [threadlocal] reduction of the output blocks.
+ * The number of applications per measurement is set by [site_hamil_repetitions].
+ */
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <fstream>
+
+#ifdef MAQUIS_OPENMP
+#include <omp.h>
+#endif
+
+#include <alps/hdf5.hpp>
+
+#include "matrix_selector.hpp" /// define matrix
+#include "symm_selector.hpp"   /// define grp
+
+#include "dmrg/models/lattice.h"
+#include "dmrg/models/model.h"
+#include "dmrg/models/generate_mpo.hpp"
+
+#include "dmrg/mp_tensors/mps.h"
+#include "dmrg/mp_tensors/contractions.h"
+
+#include "dmrg/utils/DmrgOptions.h"
+#include "dmrg/utils/DmrgParameters.h"
+
+
+int main(int argc, char ** argv)
+{
+    try {
+        DmrgOptions opt(argc, argv);
+        if (!opt.valid) return 0;
+        DmrgParameters parms = opt.parms;
+
+        typedef contraction::Engine<matrix, matrix, grp> contr;
+        typedef contraction::common::SiteHamilReduction reduction;
+
+        /// Parsing model
+        Lattice lattice(parms);
+        Model<matrix, grp> model(lattice, parms);
+        MPO<matrix, grp> mpo = make_mpo(lattice, model);
+
+        /// Load MPS
+        int L = lattice.size();
+        MPS<matrix, grp> mps;
+        load(parms["chkpfile"].str(), mps);
+        int site;
+        {
+            alps::hdf5::archive ar(parms["chkpfile"].str()+"/props.h5");
+            ar["/status/site"] >> site;
+        }
+        if (site >= L)
+            site = 2*L-site-1;
+        mps.canonize(site);
+
+        /// Boundaries
+        Boundary<matrix, grp> left = mps.left_boundary();
+        for (int i = 0; i < site; ++i)
+            left = contr::overlap_mpo_left_step(mps[i], mps[i], left, mpo[i]);
+        Boundary<matrix, grp> right = mps.right_boundary();
+        for (int i = L-1; i > site; --i)
+            right = contr::overlap_mpo_right_step(mps[i], mps[i], right, mpo[i]);
+
+        int repetitions = parms.is_set("site_hamil_repetitions") ? int(parms["site_hamil_repetitions"]) : 10;
+#ifdef MAQUIS_OPENMP
+        int max_threads = omp_get_max_threads();
+#else
+        int max_threads = 1;
+#endif
+        maquis::cout << "Site " << site << ", left aux dim " << left.aux_dim() << ", right aux dim "
+                     << right.aux_dim() << ", " << repetitions << " applications per run" << std::endl;
+        maquis::cout << "threads   critical [s]   threadlocal [s]   deviation norm" << std::endl;
+
+        /// Thread scaling
+        for (int n_threads = 1; ; n_threads = std::min(2*n_threads, max_threads)) {
+#ifdef MAQUIS_OPENMP
+            omp_set_num_threads(n_threads);
+#endif
+            std::vector<double> times;
+            std::vector<MPSTensor<matrix, grp> > results;
+            for (reduction::Mode mode : {reduction::Critical, reduction::ThreadLocal}) {
+                reduction::mode() = mode;
+                MPSTensor<matrix, grp> res;
+                auto start = std::chrono::steady_clock::now();
+                for (int i = 0; i < repetitions; ++i)
+                    res = contr::site_hamil2(mps[site], left, right, mpo[site]);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                times.push_back(elapsed.count());
+                results.push_back(res);
+            }
+            MPSTensor<matrix, grp> diff = results[0] - results[1];
+            maquis::cout << n_threads << "   " << times[0] << "   " << times[1] << "   "
+                         << diff.scalar_norm() << std::endl;
+            if (n_threads == max_threads)
+                break;
+        }
+        reduction::mode() = reduction::Critical;
+
+    } catch (std::exception & e) {
+        maquis::cerr << "Exception caught:" << std::endl << e.what() << std::endl;
+        exit(1);
+    }
+}
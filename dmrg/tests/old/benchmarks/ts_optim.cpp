@@ -44,6 +44,7 @@
 #include "dmrg/mp_tensors/mps.h"
 #include "dmrg/mp_tensors/twositetensor.h"
 #include "dmrg/mp_tensors/contractions.h"
+#include "dmrg/mp_tensors/siteproblem.h"
 
 #include "dmrg/optimize/ietl_lanczos_solver.h"
 #include "dmrg/optimize/ietl_jacobi_davidson.h"
@@ -55,24 +56,6 @@
 #include "utils/timings.h"
 
 
-template<class Matrix, class SymmGroup>
-struct SiteProblem
-{
-    SiteProblem(Boundary<Matrix, SymmGroup> const & left_,
-                Boundary<Matrix, SymmGroup> const & right_,
-                MPOTensor<Matrix, SymmGroup> const & mpo_)
-    : left(left_)
-    , right(right_)
-    , mpo(mpo_)
-    {
-    }
-    
-    Boundary<Matrix, SymmGroup> const & left;
-    Boundary<Matrix, SymmGroup> const & right;
-    MPOTensor<Matrix, SymmGroup> const & mpo;
-    double ortho_shift;
-};
-
 bool can_clean(int k, int site, int L, int lr){
     if(k == site || k == site+1) return false;
     if(lr == -1 && site > 0   && k == site-1) return false;
@@ -0,0 +1,158 @@
+/*****************************************************************************
+ *
+ * ALPS MPS DMRG Project
+ *
+ * Copyright (C) 2021 Institute for Theoretical Physics, ETH Zurich
+ *                    Laboratory for Physical Chemistry, ETH Zurich
+ *
+ * This software is part of the ALPS Applications, published under the ALPS
+ * Application License; you can use, redistribute it and/or modify it under
+ * the terms of the license, either version 1 or (at your option) any later
+ * version.
+ *
+ * You should have received a copy of the ALPS Application License along with
+ * the ALPS Applications; see the file LICENSE.txt. If not, the license is also
+ * available from http://alps.comp-phys.org/.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ * SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ * FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ *****************************************************************************/
+
+
+#define BOOST_TEST_MODULE storage
+
+#include <boost/test/included/unit_test.hpp>
+#include <boost/filesystem.hpp>
+#include "dmrg/block_matrix/detail/alps.hpp"
+#include "dmrg/block_matrix/symmetry.h"
+#include "dmrg/block_matrix/block_matrix.h"
+#include "dmrg/mp_tensors/boundary.h"
+#include "dmrg/utils/storage.h"
+
+#include "dmrg/sim/matrix_types.h"
+
+#if defined(HAVE_TwoU1) || defined(HAVE_TwoU1PG)
+
+/** @brief Creates a boundary with [auxDim] block matrices, each having 3 blocks of different size */
+Boundary<matrix, TwoU1> createBoundary(std::size_t auxDim)
+{
+    Boundary<matrix, TwoU1> ret;
+    ret.resize(auxDim);
+    for (std::size_t b = 0; b < auxDim; ++b) {
+        for (int iBlock = 0; iBlock < 3; ++iBlock) {
+            matrix m(iBlock+1, iBlock+2);
+            for (std::size_t i = 0; i < num_rows(m); ++i)
+                for (std::size_t j = 0; j < num_cols(m); ++j)
+                    m(i, j) = 1. + b + 0.1*iBlock + 0.01*i + 0.001*j;
+            ret[b].insert_block(m, TwoU1::charge(iBlock), TwoU1::charge(iBlock+1));
+        }
+    }
+    return ret;
+}
+
+/** @brief Checks that two boundaries are identical */
+void checkBoundaries(Boundary<matrix, TwoU1> const& lhs, Boundary<matrix, TwoU1> const& rhs)
+{
+    BOOST_CHECK_EQUAL(lhs.aux_dim(), rhs.aux_dim());
+    for (std::size_t b = 0; b < lhs.aux_dim(); ++b) {
+        BOOST_CHECK_EQUAL(lhs[b].n_blocks(), rhs[b].n_blocks());
+        for (std::size_t k = 0; k < lhs[b].n_blocks(); ++k)
+            for (std::size_t i = 0; i < num_rows(lhs[b][k]); ++i)
+                for (std::size_t j = 0; j < num_cols(lhs[b][k]); ++j)
+                    BOOST_CHECK_EQUAL(lhs[b][k](i, j), rhs[b][k](i, j));
+    }
+}
+
+/** @brief Evicts a boundary and loads it back */
+void roundTrip(Boundary<matrix, TwoU1>& boundary)
+{
+    storage::disk::evict(boundary);
+    storage::disk::prefetch(boundary);
+    storage::disk::fetch(boundary);
+}
+
+struct StorageFixture {
+    StorageFixture() : path(boost::filesystem::unique_path(boost::filesystem::temp_directory_path() / "storage_test_%%%%%%%%/"))
+    {
+        boost::filesystem::create_directories(path);
+    }
+    ~StorageFixture() { boost::filesystem::remove_all(path); }
+    boost::filesystem::path path;
+};
+
+/** Checks that a boundary is recovered exactly after being written to disk */
+BOOST_FIXTURE_TEST_CASE(StorageRoundTrip, StorageFixture) {
+    storage::disk::init(path.string() + "/", 2, 4);
+    auto reference = createBoundary(5);
+    auto boundary = reference;
+    roundTrip(boundary);
+    checkBoundaries(boundary, reference);
+    storage::disk::sync();
+}
+
+/** Same as above, but with compression */
+BOOST_FIXTURE_TEST_CASE(StorageRoundTripCompressed, StorageFixture) {
+    storage::disk::init(path.string() + "/", 1, 1, true);
+    auto reference = createBoundary(5);
+    std::vector<Boundary<matrix, TwoU1> > boundaries;
+    for (int i = 0; i < 4; ++i)
+        boundaries.push_back(createBoundary(5));
+    for (auto& b: boundaries)
+        storage::disk::evict(b);
+    for (auto& b: boundaries) {
+        storage::disk::prefetch(b);
+        storage::disk::fetch(b);
+        checkBoundaries(b, reference);
+    }
+    storage::disk::sync();
+}
+
+/** Checks that, with a memory budget, only the boundaries exceeding the budget are written to disk */
+BOOST_FIXTURE_TEST_CASE(StorageMemoryBudget, StorageFixture) {
+    auto reference = createBoundary(5);
+    // The budget fits two boundaries
+    storage::disk::init(path.string() + "/", 1, 8, false, 2*size_of(reference)+1);
+    std::vector<Boundary<matrix, TwoU1> > boundaries;
+    for (int i = 0; i < 3; ++i)
+        boundaries.push_back(createBoundary(5));
+    for (auto& b: boundaries)
+        storage::disk::evict(b);
+    storage::disk::sync();
+    // The first boundary is the oldest one, and is therefore the first one to be written
+    BOOST_CHECK(boundaries[0].state == storage::disk::descriptor::storing);
+    BOOST_CHECK(boundaries[1].state == storage::disk::descriptor::core);
+    BOOST_CHECK(boundaries[2].state == storage::disk::descriptor::core);
+    for (auto& b: boundaries) {
+        storage::disk::prefetch(b);
+        storage::disk::fetch(b);
+        checkBoundaries(b, reference);
+    }
+}
+
+/** Checks that a boundary is recovered exactly from the memory-mapped storage */
+BOOST_FIXTURE_TEST_CASE(StorageMemoryMapped, StorageFixture) {
+    storage::mmap::init(path.string() + "/");
+    auto reference = createBoundary(5);
+    std::vector<Boundary<matrix, TwoU1> > boundaries;
+    for (int i = 0; i < 3; ++i)
+        boundaries.push_back(createBoundary(5));
+    for (auto& b: boundaries) {
+        storage::mmap::evict(b);
+        BOOST_CHECK_EQUAL(size_of(b), 0);
+    }
+    storage::mmap::prefetch(boundaries[0]);
+    for (auto& b: boundaries) {
+        storage::mmap::fetch(b);
+        checkBoundaries(b, reference);
+    }
+    // Files are removed once the data is back in memory
+    BOOST_CHECK(boost::filesystem::is_empty(path));
+}
+
+#endif
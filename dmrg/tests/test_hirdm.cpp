@@ -34,6 +34,7 @@
 #include <iostream>
 
 #include "maquis_dmrg.h"
+#include "dmrg/utils/archive.h"
 #include "test_detail.h"
 // Test 1: H2 with d=3 Angstrom,singlet,cc-pVDZ basis set,CAS(2,2),integrals generated by MOLCAS
 BOOST_AUTO_TEST_CASE( Test_HiRDM )
@@ -310,3 +311,117 @@ BOOST_AUTO_TEST_CASE( Test_HiRDM )
 
 }
 
+// Test 2: the 4-RDM evaluated in independent slices and merged must match the complete 4-RDM
+BOOST_AUTO_TEST_CASE( Test_HiRDM_Slices )
+{
+    typedef maquis::DMRGInterface<double>::meas_with_results_type rdm_measurement;
+
+    DmrgParameters p;
+    const std::string integrals(
+     "    1.63719990472             1     1     1     1\n"
+     "  -0.144746632369             1     1     2     1\n"
+     "   0.266282775636E-01         2     1     2     1\n"
+     "   0.167531821030E-01         2     2     2     1\n"
+     "   0.459207160088             1     1     2     2\n"
+     "   0.533052674812             2     2     2     2\n"
+     "   -0.230673683229E-01        1     1     3     1\n"
+     "   0.873924303638E-02         2     1     3     1\n"
+     "   0.212121998644E-01         2     2     3     1\n"
+     "   0.517422983458E-02         3     1     3     1\n"
+     "   0.166602690956E-01         3     2     3     1\n"
+     "   0.201358122600E-01         3     3     3     1\n"
+     "   0.113600263329             1     1     3     2\n"
+     "   0.130338872974E-01         2     1     3     2\n"
+     "   0.170776682916             2     2     3     2\n"
+     "   0.130799970176             3     2     3     2\n"
+     "   0.156301172407             3     3     3     2\n"
+     "   0.386363318135             1     1     3     3\n"
+     "   0.177101856628E-01         2     1     3     3\n"
+     "   0.469384865605             2     2     3     3\n"
+     "   0.439202823493             3     3     3     3\n"
+     "   -4.96687194130             1     1     0     0\n"
+     "   0.128261636279             2     1     0     0\n"
+     "   -1.74403215804             2     2     0     0\n"
+     "   -0.589618128664E-02        3     1     0     0\n"
+     "   -0.377341184513            3     2     0     0\n"
+     "   -1.09420984374             3     3     0     0\n"
+     "   1.58753163271              0     0     0     0\n");
+
+    p.set("integrals",integrals);
+    p.set("site_types","0,0,0");
+    p.set("L",3);
+    p.set("irrep",0);
+    p.set("nsweeps",2);
+    p.set("max_bond_dimension",100);
+    p.set("nelec",4);
+    p.set("spin",0);
+    p.set("u1_total_charge1",2);
+    p.set("u1_total_charge2",2);
+    p.set("MEASURE[4rdm]",1);
+
+    std::vector<std::string> symmetries;
+    #ifdef HAVE_SU2U1PG
+    symmetries.push_back("su2u1pg");
+    #endif
+
+    test_detail::TestTmpPath tmp_path;
+    const int n_slices = 3;
+
+    for (auto&& s: symmetries)
+    {
+        maquis::cout << "Running test for symmetry " << s << std::endl;
+        p.set("symmetry",s);
+        boost::filesystem::path checkpoint_path(tmp_path.path() / ("checkpoint_slices_" + s));
+        p.set("chkpfile", checkpoint_path.c_str());
+
+        // reference: complete 4-RDM
+        rdm_measurement reference;
+        {
+            maquis::DMRGInterface<double> interface(p);
+            interface.optimize();
+            reference = interface.fourrdm();
+        }
+
+        // each slice is evaluated by a separate interface and saved in its own shard
+        std::vector<std::string> shards;
+        std::size_t n_elements = 0;
+        for (int slice = 0; slice < n_slices; slice++)
+        {
+            boost::filesystem::path shard_path(tmp_path.path() / ("shard_" + s + "_" + std::to_string(slice) + ".h5"));
+            shards.push_back(shard_path.string());
+            p.set("rdm_slice", slice);
+            p.set("rdm_slices", n_slices);
+            p.set("resultfile", shards.back());
+
+            maquis::DMRGInterface<double> interface(p);
+            interface.measure_and_save_4rdm();
+
+            storage::archive ar(shards.back());
+            if (ar.is_data("/spectrum/results/fourptdm/labels_num"))
+            {
+                std::vector<std::vector<int> > labels;
+                ar["/spectrum/results/fourptdm/labels_num"] >> labels;
+                BOOST_CHECK(labels.size() < reference.first.size());
+                n_elements += labels.size();
+            }
+        }
+        p.set("rdm_slice", 0);
+        p.set("rdm_slices", 1);
+        p.erase("resultfile");
+
+        // the slices are disjoint and cover all the elements
+        BOOST_CHECK_EQUAL(n_elements, reference.first.size());
+
+        // merge and compare with the complete 4-RDM
+        std::string merged = (tmp_path.path() / ("merged_" + s + ".h5")).string();
+        maquis::DMRGInterface<double>::merge_rdm_slices(4, shards, merged);
+
+        rdm_measurement meas;
+        std::vector<std::vector<double> > values;
+        storage::archive ar(merged);
+        ar["/spectrum/results/fourptdm/labels_num"] >> meas.first;
+        ar["/spectrum/results/fourptdm/mean/value"] >> values;
+        meas.second = values[0];
+        test_detail::check_measurement_mat(meas, reference);
+    }
+}
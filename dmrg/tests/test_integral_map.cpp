@@ -30,6 +30,12 @@
 #include <boost/test/included/unit_test.hpp>
 #include "utils/fpcomparison.h"
 #include <integral_interface.h>
+#include <boost/filesystem.hpp>
+#include "dmrg/sim/matrix_types.h"
+#include "dmrg/models/lattice.h"
+#include "dmrg/models/chem/util.h"
+#include "dmrg/models/chem/parse_integrals.h"
+#include "dmrg/utils/DmrgParameters.h"
 
 BOOST_AUTO_TEST_CASE( Test_Integral_Map )
 {
@@ -57,4 +63,46 @@ BOOST_AUTO_TEST_CASE( Test_Integral_Map )
     BOOST_CHECK_CLOSE(std::real(ints_complex[{1,1,1,2}]), 2.0, 1.0e-15);
     BOOST_CHECK_CLOSE(std::imag(ints_complex[{1,1,1,2}]), -1.0, 1.0e-15);
 
-}
\ No newline at end of file
+}
+BOOST_AUTO_TEST_CASE( Test_Binary_Integrals )
+{
+#ifdef HAVE_TwoU1PG
+    boost::filesystem::path tmp = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(tmp);
+    std::string fcidump = (tmp / "FCIDUMP").string(), binary = (tmp / "FCIDUMP.bin").string();
+    {
+        std::ofstream ofs(fcidump.c_str());
+        ofs << " &FCI NORB=  4,NELEC= 2,MS2= 0,\n  ORBSYM=1,1,1,1,\n  ISYM=1,\n /\n"
+            << "  0.5 1 1 1 1\n  0.25 2 1 2 1\n  1.0e-12 2 2 1 1\n  -0.125 3 4 0 0\n  -1.5 4 4 0 0\n  0.75 0 0 0 0\n";
+    }
+    BOOST_CHECK_EQUAL(chem::detail::convert_fcidump<double>(fcidump, binary), 6);
+    BOOST_CHECK(chem::detail::is_binary_integral_file(binary));
+    BOOST_CHECK(!chem::detail::is_binary_integral_file(fcidump));
+
+    chem::detail::mapped_integrals<double> ints(binary);
+    BOOST_CHECK_EQUAL(ints.size(), 6);
+    BOOST_CHECK_EQUAL(ints.index(3)[0], 3);
+    BOOST_CHECK_EQUAL(ints.index(3)[1], 4);
+    BOOST_CHECK_CLOSE(ints.value(3), -0.125, 1.0e-15);
+
+    // The binary file must give the same integrals as the FCIDUMP file, in the same order
+    DmrgParameters p;
+    p.set("L", 4);
+    p.set("site_types", "1,1,1,1");
+    p.set("orbital_order", "2,1,4,3");
+    p.set("integral_cutoff", 1.0e-10);
+    Lattice lat(p);
+    p.set("integral_file", fcidump);
+    auto reference = chem::detail::parse_integrals<double, TwoU1PG>(p, lat);
+    p.set("integral_file", binary);
+    auto result = chem::detail::parse_integrals<double, TwoU1PG>(p, lat);
+    BOOST_CHECK_EQUAL(reference.second.size(), 5);
+    BOOST_CHECK_EQUAL(result.second.size(), reference.second.size());
+    for (std::size_t i = 0; i < reference.second.size(); ++i) {
+        BOOST_CHECK_CLOSE(result.second[i], reference.second[i], 1.0e-15);
+        for (int j = 0; j < 4; ++j)
+            BOOST_CHECK_EQUAL(result.first(i, j), reference.first(i, j));
+    }
+    boost::filesystem::remove_all(tmp);
+#endif
+}
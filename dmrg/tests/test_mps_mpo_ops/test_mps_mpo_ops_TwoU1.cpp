@@ -115,3 +115,26 @@ BOOST_AUTO_TEST_CASE_TEMPLATE( Test_MPS_Rotate, S, symmetries )
     BOOST_CHECK_CLOSE(std::abs(f.mps[4].data()[2](1,0)), 0.083918122130324874, 1e-4); // TODO: check if sign is correct
     BOOST_CHECK_CLOSE(std::abs(f.mps[4].data()[2](3,0)), 1.0322307057313466e-06, 1e-2);
 }
+
+BOOST_AUTO_TEST_CASE_TEMPLATE( Test_MPS_Rotate_Fit, S, symmetries )
+{
+    Fixture<S> f;
+    // Checks that the variational rotation gives the same state as the rotation with joined MPSs
+    f.mps.canonize(0);
+    int L = f.mps.length();
+    matrix t(L, L);
+    for (int i = 0; i < L; i++)
+        for (int j = 0; j < L; j++)
+            t(i,j) = (i == j) ? 1.0 : 0.02*(i-j);
+
+    MPS<matrix, S> mps_joined = f.mps, mps_fitted = f.mps;
+    mps_rotate::rotate_mps(mps_joined, t, 1.);
+    mps_rotate::rotate_mps(mps_fitted, t, 1., 100, 1e-14);
+
+    double norm_joined = norm(mps_joined), norm_fitted = norm(mps_fitted);
+    BOOST_CHECK_CLOSE(norm_fitted, norm_joined, 1e-5);
+    // Squared norm of the difference, the MPSs have different block structures
+    MPS<matrix, S> mps_difference = mps_fitted;
+    mps_difference[0].multiply_by_scalar(-1.);
+    BOOST_CHECK_SMALL(norm(join(mps_joined, mps_difference))/norm_joined, 1e-8);
+}
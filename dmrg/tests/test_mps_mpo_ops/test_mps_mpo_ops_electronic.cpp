@@ -39,6 +39,9 @@
 #include "dmrg/mp_tensors/mps.h"
 #include "dmrg/mp_tensors/mps_rotate.h"
 #include "dmrg/sim/matrix_types.h"
+#include "dmrg/models/generate_mpo.hpp"
+#include "dmrg/models/measurements/measurements_details.h"
+#include "dmrg/models/measurements/rdm_engine.h"
 #include "Fixtures/BenzeneFixture.h"
 #include "test_mps.h"
 
@@ -51,6 +54,12 @@ TwoU1PG
 #endif
 > symmetries;
 
+typedef boost::mpl::list<
+#ifdef HAVE_TwoU1PG
+TwoU1PG
+#endif
+> abelian_symmetries;
+
 /**
  * @brief Checks that the MPO-MPS contraction fulfill the Hermitianity of the Hamiltonian 
  * Note that this test uses the "standard" implementation of the expval function, which uses the left boundary.
@@ -116,4 +125,130 @@ BOOST_FIXTURE_TEST_CASE_TEMPLATE( Test_MPS_MPO_Hermitian_Right_Electronic, S, sy
     expVal1 = expvalFromRight(mpsDefault, mpsHF, mpo);
     expVal2 = expvalFromRight(mpsHF, mpsDefault, mpo);
     BOOST_CHECK_CLOSE(expVal1, expVal2, 1.E-10);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Checks that the RDM engine reproduces the matrix elements obtained by
+ * contracting the full MPS/MPO network.
+ */
+BOOST_FIXTURE_TEST_CASE_TEMPLATE( Test_RDMEngine_Electronic, S, abelian_symmetries, BenzeneFixture )
+{
+    using tag_type = typename Model<matrix, S>::tag_type;
+    auto lattice = Lattice(parametersBenzene);
+    auto modelHF = Model<matrix, S>(lattice, parametersBenzene);
+    auto mpsHF = MPS<matrix, S>(lattice.size(), *(modelHF.initializer(lattice, parametersBenzene)));
+    parametersBenzene.set("init_state", "default");
+    auto model = Model<matrix, S>(lattice, parametersBenzene);
+    auto mpsDefault = MPS<matrix, S>(lattice.size(), *(model.initializer(lattice, parametersBenzene)));
+    auto tag_handler = model.operators_table();
+    std::vector<tag_type> identities, fillings;
+    for (int type = 0; type <= lattice.maximum_vertex_type(); ++type) {
+        identities.push_back(model.identity_matrix_tag(type));
+        fillings.push_back(model.filling_matrix_tag(type));
+    }
+    auto type = [&](int p) { return lattice.get_prop<typename S::subcharge>("type", p); };
+    measurements::RDMEngine<matrix, S> engineDiagonal(mpsDefault, mpsDefault, identities, tag_handler, lattice);
+    measurements::RDMEngine<matrix, S> engineTransition(mpsHF, mpsDefault, identities, tag_handler, lattice);
+    std::vector<std::vector<int> > indices = {{0, 0, 0, 0}, {0, 1, 1, 0}, {1, 3, 2, 5}, {5, 4, 0, 2}, {2, 5, 5, 2}};
+    for (auto const & positions : indices) {
+        std::vector<tag_type> operators = {model.get_operator_tag("create_up", type(positions[0])),
+                                           model.get_operator_tag("create_down", type(positions[1])),
+                                           model.get_operator_tag("destroy_down", type(positions[2])),
+                                           model.get_operator_tag("destroy_up", type(positions[3]))};
+        auto term = generate_mpo::arrange_operators(positions, operators, tag_handler);
+        auto mpo = generate_mpo::sign_and_fill(term, identities, fillings, tag_handler, lattice);
+        BOOST_CHECK_SMALL(engineDiagonal.expval(mpsDefault, mpsDefault, mpo, term) - expval(mpsDefault, mpsDefault, mpo), 1.E-12);
+        BOOST_CHECK_SMALL(engineTransition.expval(mpsHF, mpsDefault, mpo, term) - expval(mpsHF, mpsDefault, mpo), 1.E-12);
+    }
+}
+
+/** @brief Checks that the RDM elements are unchanged when the contraction restarts from cached prefixes */
+BOOST_FIXTURE_TEST_CASE_TEMPLATE( Test_RDMEngine_PrefixCache_Electronic, S, abelian_symmetries, BenzeneFixture )
+{
+    using tag_type = typename Model<matrix, S>::tag_type;
+    auto lattice = Lattice(parametersBenzene);
+    parametersBenzene.set("init_state", "default");
+    auto model = Model<matrix, S>(lattice, parametersBenzene);
+    auto mps = MPS<matrix, S>(lattice.size(), *(model.initializer(lattice, parametersBenzene)));
+    auto tag_handler = model.operators_table();
+    std::vector<tag_type> identities, fillings;
+    for (int type = 0; type <= lattice.maximum_vertex_type(); ++type) {
+        identities.push_back(model.identity_matrix_tag(type));
+        fillings.push_back(model.filling_matrix_tag(type));
+    }
+    auto type = [&](int p) { return lattice.get_prop<typename S::subcharge>("type", p); };
+    measurements::RDMEngine<matrix, S> engine(mps, mps, identities, tag_handler, lattice);
+    measurements::BoundaryPrefixCache<matrix, S> cache(64*1024*1024), smallCache(1);
+    auto indices = measurements_details::iterate_nrdm<2>(lattice.size());
+    for (auto i : measurements::PrefixCacheSettings::evaluation_order(indices)) {
+        auto const & positions = indices[i];
+        std::vector<tag_type> operators = {model.get_operator_tag("create_up", type(positions[0])),
+                                           model.get_operator_tag("create_down", type(positions[1])),
+                                           model.get_operator_tag("destroy_down", type(positions[2])),
+                                           model.get_operator_tag("destroy_up", type(positions[3]))};
+        auto term = generate_mpo::arrange_operators(positions, operators, tag_handler);
+        auto mpo = generate_mpo::sign_and_fill(term, identities, fillings, tag_handler, lattice);
+        auto reference = engine.expval(mps, mps, mpo, term);
+        BOOST_CHECK_SMALL(engine.expval(mps, mps, mpo, term, &cache) - reference, 1.E-12);
+        BOOST_CHECK_SMALL(engine.expval(mps, mps, mpo, term, &smallCache) - reference, 1.E-12);
+    }
+    BOOST_CHECK(cache.hits() > cache.misses());
+    BOOST_CHECK(cache.memory() <= 64*1024*1024);
+    BOOST_CHECK_EQUAL(smallCache.hits(), 0);
+    BOOST_CHECK_EQUAL(smallCache.memory(), 0);
+}
+
+/** @brief Checks the prefix cache on a generic MPO, including the non-Abelian case */
+BOOST_FIXTURE_TEST_CASE_TEMPLATE( Test_PrefixCache_Electronic, S, symmetries, BenzeneFixture )
+{
+    auto lattice = Lattice(parametersBenzene);
+    parametersBenzene.set("init_state", "default");
+    auto model = Model<matrix, S>(lattice, parametersBenzene);
+    auto mps = MPS<matrix, S>(lattice.size(), *(model.initializer(lattice, parametersBenzene)));
+    auto mpo = make_mpo(lattice, model);
+    auto left = mps_mpo_detail::mixed_left_boundary(mps, mps);
+    measurements::BoundaryPrefixCache<matrix, S> cache(64*1024*1024);
+    double reference = expval(mps, mpo);
+    for (int i = 0; i < 2; ++i) {
+        double scale;
+        auto result = cache.contract(mps, mps, mpo, 0, lattice.size()-1, left, scale);
+        BOOST_CHECK_CLOSE(scale*result.traces()[0] + mpo.getCoreEnergy(), reference, 1.E-10);
+    }
+    BOOST_CHECK_EQUAL(cache.misses(), 1);
+    BOOST_CHECK_EQUAL(cache.hits(), 1);
+}
+
+/**
+ * @brief Checks that rewriting the coefficients of an MPO with new integrals gives the same
+ * energy as the MPO built from scratch, and that new operator strings are rejected.
+ */
+BOOST_FIXTURE_TEST_CASE_TEMPLATE( Test_MPO_Update_Coefficients_Electronic, S, symmetries, BenzeneFixture )
+{
+    auto lattice = Lattice(parametersBenzene);
+    parametersBenzene.set("init_state", "default");
+    auto model = Model<matrix, S>(lattice, parametersBenzene);
+    auto mps = MPS<matrix, S>(lattice.size(), *(model.initializer(lattice, parametersBenzene)));
+    generate_mpo::CoefficientMap<matrix, S> coefficients;
+    auto mpo = make_mpo(lattice, model, coefficients);
+    BOOST_CHECK(coefficients.valid);
+    double energy = expval(mps, mpo);
+    // Same operator strings, different values
+    auto integrals = integralsReal;
+    int counter = 0;
+    for (auto& integral : integrals)
+        integral.second *= 1. + 0.05*(counter++ % 7);
+    parametersBenzene.set("integrals_binary", maquis::serialize(integrals));
+    auto newModel = Model<matrix, S>(lattice, parametersBenzene);
+    auto reference = make_mpo(lattice, newModel);
+    BOOST_CHECK(generate_mpo::update_coefficients(mpo, coefficients, model.hamiltonian_terms(), newModel.hamiltonian_terms()));
+    double updatedEnergy = expval(mps, mpo);
+    BOOST_CHECK_CLOSE(updatedEnergy, expval(mps, reference), 1.E-10);
+    BOOST_CHECK(std::abs(updatedEnergy - energy) > 1.E-6);
+    // An integral below the cutoff changes the operator strings
+    integrals[{1, 1, 0, 0}] = 0.;
+    parametersBenzene.set("integrals_binary", maquis::serialize(integrals));
+    auto otherModel = Model<matrix, S>(lattice, parametersBenzene);
+    otherModel.create_terms();
+    BOOST_CHECK(!generate_mpo::update_coefficients(mpo, coefficients, newModel.hamiltonian_terms(), otherModel.hamiltonian_terms()));
+    BOOST_CHECK_CLOSE(expval(mps, mpo), updatedEnergy, 1.E-10);
+}
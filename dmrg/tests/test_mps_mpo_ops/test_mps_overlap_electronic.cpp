@@ -75,6 +75,29 @@ BOOST_FIXTURE_TEST_CASE_TEMPLATE( Test_MPS_Overlap_Hermitian_Electronic, S, symm
     BOOST_CHECK_CLOSE(overlapOriginal, overlapHerm, 1.E-10);
 }
 
+/** @brief Checks that the overlap matrix of a set of MPSs matches the pairwise overlaps */
+BOOST_FIXTURE_TEST_CASE_TEMPLATE( Test_MPS_Overlap_Matrix_Electronic, S, symmetries, BenzeneFixture )
+{
+    auto lattice = Lattice(parametersBenzene);
+    auto model = Model<matrix, S>(lattice, parametersBenzene);
+    std::vector<MPS<matrix, S> > states;
+    states.push_back(MPS<matrix, S>(lattice.size(), *(model.initializer(lattice, parametersBenzene))));
+    parametersBenzene.set("init_state", "const");
+    states.push_back(MPS<matrix, S>(lattice.size(), *(model.initializer(lattice, parametersBenzene))));
+    parametersBenzene.set("init_state", "default");
+    states.push_back(MPS<matrix, S>(lattice.size(), *(model.initializer(lattice, parametersBenzene))));
+    // Hermitian case, where only the upper triangle is contracted, and general case
+    std::vector<MPS<matrix, S> > kets(states.begin()+1, states.end());
+    matrix overlaps = overlap_matrix(states, states);
+    matrix overlapsRectangular = overlap_matrix(states, kets);
+    for (int i = 0; i < states.size(); i++) {
+        for (int j = 0; j < states.size(); j++)
+            BOOST_CHECK_CLOSE(overlaps(i, j), overlap(states[i], states[j]), 1.E-10);
+        for (int j = 0; j < kets.size(); j++)
+            BOOST_CHECK_CLOSE(overlapsRectangular(i, j), overlap(states[i], kets[j]), 1.E-10);
+    }
+}
+
 #ifdef HAVE_U1DG
 
 /** @brief Checks Hermitianity of the overlap calculation for the relativistic (complex-valued) electronic case */
@@ -39,6 +39,8 @@
 #include "dmrg/mp_tensors/zerositeproblem.h"
 #include "dmrg/mp_tensors/contractions/engine.h"
 #include "dmrg/optimize/ietl_lanczos_solver.h"
+#include "dmrg/optimize/ietl_jacobi_davidson.h"
+#include "dmrg/optimize/ietl_davidson.h"
 #include "dmrg/models/model.h"
 #include "dmrg/models/generate_mpo.hpp"
 #include "dmrg/sim/matrix_types.h"
@@ -113,6 +115,323 @@ BOOST_AUTO_TEST_CASE_TEMPLATE( Test_SiteProblem, S, symmetries)
     BOOST_CHECK_CLOSE(energy, energy2, 1e-10);
 }
 
+BOOST_AUTO_TEST_CASE_TEMPLATE( Test_SiteProblem_ContractionPlan, S, symmetries)
+{
+    // Types definition
+    using BoundaryType = Boundary<typename storage::constrained<matrix>::type, S>;
+    using contr = contraction::Engine<matrix, typename storage::constrained<matrix>::type, S>;
+    DmrgParameters p;
+    const auto& integrals = TestSiteproblemFixture::integrals;
+    p.set("integrals_binary", maquis::serialize(integrals));
+    p.set("site_types", "0,0,0,0");
+    p.set("L", 4);
+    p.set("irrep", 0);
+    p.set("max_bond_dimension",100);
+    p.set("nelec", 2);
+    p.set("spin", 0);
+    p.set("u1_total_charge1", 1);
+    p.set("u1_total_charge2", 1);
+    auto lat = Lattice(p);
+    auto model = Model<matrix, S>(lat, p);
+    auto mpo = make_mpo(lat, model);
+    auto mps = MPS<matrix, S>(lat.size(), *(model.initializer(lat, p)));
+    mps.normalize_right();
+    auto latticeSize = mpo.length();
+    std::vector<BoundaryType> left(latticeSize+1), right(latticeSize+1);
+    left[0] = mps.left_boundary();
+    for (int iSite = 0; iSite < latticeSize; iSite++)
+        left[iSite+1] = contr::overlap_mpo_left_step(mps[iSite], mps[iSite], left[iSite], mpo[iSite]);
+    right[latticeSize] = mps.right_boundary();
+    for (int iSite = latticeSize-1; iSite >= 0; iSite--)
+        right[iSite] = contr::overlap_mpo_right_step(mps[iSite], mps[iSite], right[iSite+1], mpo[iSite]);
+    // The plan is built at the first call and reused at the second one, with a
+    // vector having the same block structure but different values.
+    SiteProblem<matrix, S> sp(left[0], right[1], mpo[0]);
+    auto secondVector = mps[0];
+    secondVector.multiply_by_scalar(2.);
+    auto sigmaReference1 = contr::site_hamil2(mps[0], left[0], right[1], mpo[0]);
+    auto sigmaReference2 = contr::site_hamil2(secondVector, left[0], right[1], mpo[0]);
+    auto sigmaPlan1 = sp.apply(mps[0]);
+    auto sigmaPlan2 = sp.apply(secondVector);
+    sigmaReference1 -= sigmaPlan1;
+    sigmaReference2 -= sigmaPlan2;
+    BOOST_CHECK_SMALL(sigmaReference1.scalar_norm(), 1.0E-12);
+    BOOST_CHECK_SMALL(sigmaReference2.scalar_norm(), 1.0E-12);
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE( Test_SiteProblem_ThreadLocalReduction, S, symmetries)
+{
+    // Types definition
+    using BoundaryType = Boundary<typename storage::constrained<matrix>::type, S>;
+    using contr = contraction::Engine<matrix, typename storage::constrained<matrix>::type, S>;
+    using reduction = contraction::common::SiteHamilReduction;
+    DmrgParameters p;
+    const auto& integrals = TestSiteproblemFixture::integrals;
+    p.set("integrals_binary", maquis::serialize(integrals));
+    p.set("site_types", "0,0,0,0");
+    p.set("L", 4);
+    p.set("irrep", 0);
+    p.set("max_bond_dimension",100);
+    p.set("nelec", 2);
+    p.set("spin", 0);
+    p.set("u1_total_charge1", 1);
+    p.set("u1_total_charge2", 1);
+    auto lat = Lattice(p);
+    auto model = Model<matrix, S>(lat, p);
+    auto mpo = make_mpo(lat, model);
+    auto mps = MPS<matrix, S>(lat.size(), *(model.initializer(lat, p)));
+    mps.normalize_right();
+    auto latticeSize = mpo.length();
+    std::vector<BoundaryType> left(latticeSize+1), right(latticeSize+1);
+    left[0] = mps.left_boundary();
+    for (int iSite = 0; iSite < latticeSize; iSite++)
+        left[iSite+1] = contr::overlap_mpo_left_step(mps[iSite], mps[iSite], left[iSite], mpo[iSite]);
+    right[latticeSize] = mps.right_boundary();
+    for (int iSite = latticeSize-1; iSite >= 0; iSite--)
+        right[iSite] = contr::overlap_mpo_right_step(mps[iSite], mps[iSite], right[iSite+1], mpo[iSite]);
+    // Thread-local reduction must reproduce the critical-section one, with and without contraction plan
+    for (int iSite = 0; iSite < latticeSize; iSite++) {
+        SiteProblem<matrix, S> sp(left[iSite], right[iSite+1], mpo[iSite]);
+        reduction::mode() = reduction::Critical;
+        auto sigmaCritical = contr::site_hamil2(mps[iSite], left[iSite], right[iSite+1], mpo[iSite]);
+        reduction::mode() = reduction::ThreadLocal;
+        auto sigmaThreadLocal = contr::site_hamil2(mps[iSite], left[iSite], right[iSite+1], mpo[iSite]);
+        auto sigmaThreadLocalPlan = sp.apply(mps[iSite]);
+        reduction::mode() = reduction::Critical;
+        sigmaThreadLocal -= sigmaCritical;
+        sigmaThreadLocalPlan -= sigmaCritical;
+        BOOST_CHECK_SMALL(sigmaThreadLocal.scalar_norm(), 1.0E-12);
+        BOOST_CHECK_SMALL(sigmaThreadLocalPlan.scalar_norm(), 1.0E-12);
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE( Test_SiteProblem_Diagonal, S, symmetries)
+{
+    // Types definition
+    using BoundaryType = Boundary<typename storage::constrained<matrix>::type, S>;
+    using contr = contraction::Engine<matrix, typename storage::constrained<matrix>::type, S>;
+    DmrgParameters p;
+    const auto& integrals = TestSiteproblemFixture::integrals;
+    p.set("integrals_binary", maquis::serialize(integrals));
+    p.set("site_types", "0,0,0,0");
+    p.set("L", 4);
+    p.set("irrep", 0);
+    p.set("max_bond_dimension",100);
+    p.set("nelec", 2);
+    p.set("spin", 0);
+    p.set("u1_total_charge1", 1);
+    p.set("u1_total_charge2", 1);
+    auto lat = Lattice(p);
+    auto model = Model<matrix, S>(lat, p);
+    auto mpo = make_mpo(lat, model);
+    auto mps = MPS<matrix, S>(lat.size(), *(model.initializer(lat, p)));
+    mps.normalize_right();
+    auto latticeSize = mpo.length();
+    std::vector<BoundaryType> left(latticeSize+1), right(latticeSize+1);
+    left[0] = mps.left_boundary();
+    for (int iSite = 0; iSite < latticeSize; iSite++)
+        left[iSite+1] = contr::overlap_mpo_left_step(mps[iSite], mps[iSite], left[iSite], mpo[iSite]);
+    right[latticeSize] = mps.right_boundary();
+    for (int iSite = latticeSize-1; iSite >= 0; iSite--)
+        right[iSite] = contr::overlap_mpo_right_step(mps[iSite], mps[iSite], right[iSite+1], mpo[iSite]);
+    // The diagonal used by the Davidson preconditioner must match the diagonal
+    // elements of the site Hamiltonian, obtained by applying it to unit vectors.
+    for (int iSite = 0; iSite < latticeSize; iSite++) {
+        SiteProblem<matrix, S> sp(left[iSite], right[iSite+1], mpo[iSite]);
+        auto unitVector = mps[iSite];
+        unitVector.make_left_paired();
+        unitVector.multiply_by_scalar(0.);
+        auto diagonal = davidson_detail::diagonal_hamiltonian<matrix, S>::apply(sp, unitVector);
+        block_matrix<matrix, S> & data = unitVector.data();
+        BOOST_CHECK_EQUAL(diagonal.n_blocks(), data.n_blocks());
+        for (std::size_t b = 0; b < data.n_blocks(); ++b) {
+            std::size_t bDiag = diagonal.find_block(data.basis().left_charge(b), data.basis().right_charge(b));
+            for (std::size_t i = 0; i < num_rows(data[b]); ++i) {
+                for (std::size_t j = 0; j < num_cols(data[b]); ++j) {
+                    data[b](i, j) = 1.;
+                    auto sigmaVector = sp.apply(unitVector);
+                    sigmaVector.make_left_paired();
+                    std::size_t bSigma = sigmaVector.data().find_block(data.basis().left_charge(b), data.basis().right_charge(b));
+                    double reference = (bSigma == sigmaVector.data().n_blocks()) ? 0. : sigmaVector.data()[bSigma](i, j);
+                    double computed = (bDiag == diagonal.n_blocks()) ? 0. : diagonal[bDiag](i, j);
+                    BOOST_CHECK_SMALL(reference - computed, 1.0E-12);
+                    data[b](i, j) = 0.;
+                }
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE( Test_SiteProblem_Davidson, S, symmetries)
+{
+    // Types definition
+    using BoundaryType = Boundary<typename storage::constrained<matrix>::type, S>;
+    using contr = contraction::Engine<matrix, typename storage::constrained<matrix>::type, S>;
+    DmrgParameters p;
+    const auto& integrals = TestSiteproblemFixture::integrals;
+    p.set("integrals_binary", maquis::serialize(integrals));
+    p.set("site_types", "0,0,0,0");
+    p.set("L", 4);
+    p.set("irrep", 0);
+    p.set("max_bond_dimension",100);
+    p.set("nelec", 2);
+    p.set("spin", 0);
+    p.set("u1_total_charge1", 1);
+    p.set("u1_total_charge2", 1);
+    p.set("ietl_jcd_tol", 1.0E-10);
+    p.set("ietl_jcd_maxiter", 100);
+    auto lat = Lattice(p);
+    auto model = Model<matrix, S>(lat, p);
+    auto mpo = make_mpo(lat, model);
+    auto mps = MPS<matrix, S>(lat.size(), *(model.initializer(lat, p)));
+    mps.normalize_right();
+    auto latticeSize = mpo.length();
+    std::vector<BoundaryType> left(latticeSize+1), right(latticeSize+1);
+    left[0] = mps.left_boundary();
+    for (int iSite = 0; iSite < latticeSize; iSite++)
+        left[iSite+1] = contr::overlap_mpo_left_step(mps[iSite], mps[iSite], left[iSite], mpo[iSite]);
+    right[latticeSize] = mps.right_boundary();
+    for (int iSite = latticeSize-1; iSite >= 0; iSite--)
+        right[iSite] = contr::overlap_mpo_right_step(mps[iSite], mps[iSite], right[iSite+1], mpo[iSite]);
+    // The preconditioned Davidson solver must converge to the same eigenvalue as Jacobi-Davidson
+    for (int iSite = 0; iSite < latticeSize; iSite++) {
+        SiteProblem<matrix, S> sp(left[iSite], right[iSite+1], mpo[iSite]);
+        // The Jacobi-Davidson solver releases the memory of its initial guess
+        auto guess = mps[iSite];
+        auto resultJCD = solve_ietl_jcd(sp, guess, p);
+        auto resultDavidson = solve_ietl_davidson(sp, mps[iSite], p);
+        BOOST_CHECK_CLOSE(resultJCD.first, resultDavidson.first, 1.0E-8);
+        BOOST_CHECK_CLOSE(resultDavidson.second.scalar_norm(), 1., 1.0E-8);
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE( Test_SiteProblem_BlockDavidson, S, symmetries)
+{
+    // Types definition
+    using BoundaryType = Boundary<typename storage::constrained<matrix>::type, S>;
+    using contr = contraction::Engine<matrix, typename storage::constrained<matrix>::type, S>;
+    DmrgParameters p;
+    const auto& integrals = TestSiteproblemFixture::integrals;
+    p.set("integrals_binary", maquis::serialize(integrals));
+    p.set("site_types", "0,0,0,0");
+    p.set("L", 4);
+    p.set("irrep", 0);
+    p.set("max_bond_dimension",100);
+    p.set("nelec", 2);
+    p.set("spin", 0);
+    p.set("u1_total_charge1", 1);
+    p.set("u1_total_charge2", 1);
+    p.set("ietl_jcd_tol", 1.0E-10);
+    p.set("ietl_jcd_maxiter", 100);
+    auto lat = Lattice(p);
+    auto model = Model<matrix, S>(lat, p);
+    auto mpo = make_mpo(lat, model);
+    auto mps = MPS<matrix, S>(lat.size(), *(model.initializer(lat, p)));
+    mps.normalize_right();
+    auto latticeSize = mpo.length();
+    std::vector<BoundaryType> left(latticeSize+1), right(latticeSize+1);
+    left[0] = mps.left_boundary();
+    for (int iSite = 0; iSite < latticeSize; iSite++)
+        left[iSite+1] = contr::overlap_mpo_left_step(mps[iSite], mps[iSite], left[iSite], mpo[iSite]);
+    right[latticeSize] = mps.right_boundary();
+    for (int iSite = latticeSize-1; iSite >= 0; iSite--)
+        right[iSite] = contr::overlap_mpo_right_step(mps[iSite], mps[iSite], right[iSite+1], mpo[iSite]);
+    // The lowest roots of the block Davidson solver must match the exact diagonalization
+    // of the site Hamiltonian, built by applying it to unit vectors.
+    for (int iSite = 0; iSite < latticeSize; iSite++) {
+        SiteProblem<matrix, S> sp(left[iSite], right[iSite+1], mpo[iSite]);
+        auto unitVector = mps[iSite];
+        unitVector.make_left_paired();
+        unitVector.multiply_by_scalar(0.);
+        block_matrix<matrix, S> & data = unitVector.data();
+        std::size_t dimension = data.num_elements();
+        std::size_t nRoots = std::min<std::size_t>(3, dimension);
+        if (nRoots < 2)
+            continue;
+        matrix hamiltonian(dimension, dimension);
+        std::vector<MPSTensor<matrix, S> > guesses(nRoots, unitVector);
+        guesses[0] = mps[iSite];
+        std::size_t column = 0;
+        for (std::size_t b = 0; b < data.n_blocks(); ++b) {
+            for (std::size_t j = 0; j < num_cols(data[b]); ++j) {
+                for (std::size_t i = 0; i < num_rows(data[b]); ++i, ++column) {
+                    data[b](i, j) = 1.;
+                    if (column > 0 && column < nRoots)
+                        guesses[column] = unitVector;
+                    auto sigmaVector = sp.apply(unitVector);
+                    for (std::size_t row = 0; row < dimension; ++row)
+                        hamiltonian(row, column) = 0.;
+                    sigmaVector.make_left_paired();
+                    std::size_t row = 0;
+                    for (std::size_t bRow = 0; bRow < data.n_blocks(); ++bRow) {
+                        std::size_t bSigma = sigmaVector.data().find_block(data.basis().left_charge(bRow), data.basis().right_charge(bRow));
+                        for (std::size_t jRow = 0; jRow < num_cols(data[bRow]); ++jRow)
+                            for (std::size_t iRow = 0; iRow < num_rows(data[bRow]); ++iRow, ++row)
+                                if (bSigma != sigmaVector.data().n_blocks())
+                                    hamiltonian(row, column) = sigmaVector.data()[bSigma](iRow, jRow);
+                    }
+                    data[b](i, j) = 0.;
+                }
+            }
+        }
+        std::vector<double> eigenvalues(dimension);
+        boost::numeric::bindings::lapack::heevd('N', hamiltonian, eigenvalues);
+        auto results = solve_ietl_block_davidson(sp, guesses, p);
+        BOOST_CHECK_EQUAL(results.size(), nRoots);
+        for (std::size_t k = 0; k < nRoots; ++k) {
+            BOOST_CHECK_SMALL(results[k].first - eigenvalues[k], 1.0E-8);
+            BOOST_CHECK_CLOSE(results[k].second.scalar_norm(), 1., 1.0E-8);
+            for (std::size_t l = 0; l < k; ++l)
+                BOOST_CHECK_SMALL(ietl::dot(results[l].second, results[k].second), 1.0E-8);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE( Test_SiteProblem_Batched, S, symmetries)
+{
+    // Types definition
+    using BoundaryType = Boundary<typename storage::constrained<matrix>::type, S>;
+    using contr = contraction::Engine<matrix, typename storage::constrained<matrix>::type, S>;
+    DmrgParameters p;
+    const auto& integrals = TestSiteproblemFixture::integrals;
+    p.set("integrals_binary", maquis::serialize(integrals));
+    p.set("site_types", "0,0,0,0");
+    p.set("L", 4);
+    p.set("irrep", 0);
+    p.set("max_bond_dimension",100);
+    p.set("nelec", 2);
+    p.set("spin", 0);
+    p.set("u1_total_charge1", 1);
+    p.set("u1_total_charge2", 1);
+    auto lat = Lattice(p);
+    auto model = Model<matrix, S>(lat, p);
+    auto mpo = make_mpo(lat, model);
+    auto mps = MPS<matrix, S>(lat.size(), *(model.initializer(lat, p)));
+    mps.normalize_right();
+    auto latticeSize = mpo.length();
+    std::vector<BoundaryType> left(latticeSize+1), right(latticeSize+1);
+    left[0] = mps.left_boundary();
+    for (int iSite = 0; iSite < latticeSize; iSite++)
+        left[iSite+1] = contr::overlap_mpo_left_step(mps[iSite], mps[iSite], left[iSite], mpo[iSite]);
+    right[latticeSize] = mps.right_boundary();
+    for (int iSite = latticeSize-1; iSite >= 0; iSite--)
+        right[iSite] = contr::overlap_mpo_right_step(mps[iSite], mps[iSite], right[iSite+1], mpo[iSite]);
+    // The batched application of the site Hamiltonian must match the application to each vector
+    for (int iSite = 0; iSite < latticeSize; iSite++) {
+        std::vector<MPSTensor<matrix, S> > vectors(3, mps[iSite]);
+        for (std::size_t k = 1; k < vectors.size(); ++k) {
+            vectors[k].make_left_paired();
+            vectors[k].data().generate(static_cast<dmrg_random::value_type(*)()>(&dmrg_random::uniform));
+        }
+        auto batched = contr::site_hamil2(vectors, left[iSite], right[iSite+1], mpo[iSite]);
+        BOOST_CHECK_EQUAL(batched.size(), vectors.size());
+        for (std::size_t k = 0; k < vectors.size(); ++k) {
+            auto reference = contr::site_hamil2(vectors[k], left[iSite], right[iSite+1], mpo[iSite]);
+            BOOST_CHECK_SMALL((reference - batched[k]).scalar_norm(), 1.0E-12);
+        }
+    }
+}
+
 BOOST_AUTO_TEST_CASE_TEMPLATE( Test_ZeroSiteProblem, S, symmetries)
 {
     // Types definition